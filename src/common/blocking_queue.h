@@ -0,0 +1,70 @@
+#ifndef MSF_LOAM_VELODYNE_BLOCKING_QUEUE_H
+#define MSF_LOAM_VELODYNE_BLOCKING_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// A bounded queue for any number of producers and consumers. Push() blocks
+// while the queue is full and Pop() while it is empty, so a fast producer is
+// throttled to the pace of the consumer. After Close(), Push() fails and
+// Pop() returns the remaining items.
+template <typename T>
+class BlockingQueue {
+ public:
+  explicit BlockingQueue(const size_t capacity) : capacity_(capacity) {}
+
+  BlockingQueue(const BlockingQueue&) = delete;
+  BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+  // Returns false without adding 'value' if the queue was closed.
+  bool Push(T value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock,
+                   [this] { return closed_ || queue_.size() < capacity_; });
+    if (closed_) return false;
+    queue_.push_back(std::move(value));
+    lock.unlock();
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Returns false if the queue is closed and empty.
+  bool Pop(T* const value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) return false;
+    *value = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Wakes up all waiting threads.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
+ private:
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  bool closed_ = false;
+  std::deque<T> queue_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_BLOCKING_QUEUE_H
@@ -39,8 +39,6 @@
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 
-#define DISTORTION 0
-
 using PointType = pcl::PointXYZI;
 using PointCloud = pcl::PointCloud<pcl::PointXYZI>;
 using PointCloudPtr = PointCloud::Ptr;
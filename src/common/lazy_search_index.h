@@ -0,0 +1,63 @@
+#ifndef MSF_LOAM_VELODYNE_LAZY_SEARCH_INDEX_H
+#define MSF_LOAM_VELODYNE_LAZY_SEARCH_INDEX_H
+
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include "common/common.h"
+#include "common/thread_pool.h"
+
+/**
+ * @brief 延迟构建的点云搜索索引
+ *
+ * Holds a search index, e.g. pcl::KdTreeFLANN<PointType>, over a point cloud
+ * and builds it on first use or in the background. 'Index' needs a default
+ * constructor and setInputCloud(const PointCloudConstPtr&). The cloud is kept
+ * alive by the index and must not be modified.
+ *
+ * Get() and BuildAsync() may be called concurrently, the index is built once.
+ * The destructor waits for a pending background build.
+ */
+template <typename Index>
+class LazySearchIndex {
+ public:
+  explicit LazySearchIndex(PointCloudConstPtr cloud)
+      : cloud_(std::move(cloud)) {}
+
+  ~LazySearchIndex() {
+    if (build_.valid()) build_.wait();
+  }
+
+  LazySearchIndex(const LazySearchIndex&) = delete;
+  LazySearchIndex& operator=(const LazySearchIndex&) = delete;
+
+  const PointCloudConstPtr& cloud() const { return cloud_; }
+
+  // Returns the index, building it or waiting for the background build if
+  // necessary.
+  const Index& Get() const {
+    std::call_once(once_flag_, [this] {
+      index_.reset(new Index);
+      index_->setInputCloud(cloud_);
+    });
+    return *index_;
+  }
+
+  // Schedules building the index on 'thread_pool', which must outlive the
+  // instance. Must be called at most once.
+  void BuildAsync(ThreadPool* const thread_pool) {
+    const auto build =
+        std::make_shared<std::packaged_task<void()>>([this] { Get(); });
+    build_ = build->get_future();
+    thread_pool->Schedule([build] { (*build)(); });
+  }
+
+ private:
+  const PointCloudConstPtr cloud_;
+  mutable std::once_flag once_flag_;
+  mutable std::unique_ptr<Index> index_;
+  std::future<void> build_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_LAZY_SEARCH_INDEX_H
@@ -0,0 +1,25 @@
+#include "common/mapped_file.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& filename) : filename_(filename) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  PCHECK(fd >= 0) << "Cannot open " << filename;
+  struct stat file_stat;
+  PCHECK(fstat(fd, &file_stat) == 0) << "Cannot stat " << filename;
+  size_ = file_stat.st_size;
+  if (size_ > 0) {
+    void* const data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    PCHECK(data != MAP_FAILED) << "Cannot map " << filename;
+    data_ = static_cast<const char*>(data);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) munmap(const_cast<char*>(data_), size_);
+}
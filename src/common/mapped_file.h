@@ -0,0 +1,26 @@
+#ifndef MSF_LOAM_VELODYNE_MAPPED_FILE_H
+#define MSF_LOAM_VELODYNE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// A file mapped read-only into memory for the lifetime of the object.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& filename);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  const std::string& filename() const { return filename_; }
+
+ private:
+  const std::string filename_;
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif  // MSF_LOAM_VELODYNE_MAPPED_FILE_H
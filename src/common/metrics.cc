@@ -0,0 +1,128 @@
+#include "common/metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double kMinValue = 1e-3;
+constexpr int kBucketsPerOctave = 4;
+
+// Bucket 0 holds the values up to kMinValue, bucket i > 0 those up to
+// kMinValue * 2^(i / kBucketsPerOctave).
+int BucketIndex(const double value) {
+  if (!(value > kMinValue)) return 0;
+  const int index = static_cast<int>(
+      std::ceil(std::log2(value / kMinValue) * kBucketsPerOctave));
+  return std::min(index, Histogram::kNumBuckets - 1);
+}
+
+double BucketUpperBound(const int index) {
+  return kMinValue *
+         std::exp2(static_cast<double>(index) / kBucketsPerOctave);
+}
+
+int ShardIndex(const int num_shards) {
+  static std::atomic<int> next_thread_index{0};
+  thread_local const int thread_index = next_thread_index++;
+  return thread_index % num_shards;
+}
+
+}  // namespace
+
+double Histogram::Snapshot::Percentile(const double q) const {
+  if (count == 0) return 0.;
+  const uint64_t rank = std::max<uint64_t>(1, std::ceil(q * count));
+  uint64_t cumulative = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    cumulative += buckets[i];
+    if (cumulative >= rank) {
+      // 取桶上下界的几何平均
+      return i == 0 ? kMinValue
+                    : std::sqrt(BucketUpperBound(i - 1) * BucketUpperBound(i));
+    }
+  }
+  return BucketUpperBound(kNumBuckets - 1);
+}
+
+void Histogram::Record(const double value) {
+  Shard& shard = shards_[ShardIndex(kNumShards)];
+  shard.buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(static_cast<uint64_t>(std::max(value, 0.) / kMinValue),
+                      std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::GetSnapshot() const {
+  Snapshot snapshot;
+  uint64_t sum = 0;
+  for (const Shard& shard : shards_) {
+    for (int i = 0; i < kNumBuckets; ++i) {
+      const uint64_t n = shard.buckets[i].load(std::memory_order_relaxed);
+      snapshot.buckets[i] += n;
+      snapshot.count += n;
+    }
+    sum += shard.sum.load(std::memory_order_relaxed);
+  }
+  snapshot.sum = sum * kMinValue;
+  return snapshot;
+}
+
+MetricsRegistry& MetricsRegistry::Get() {
+  static MetricsRegistry* const registry = new MetricsRegistry;
+  return *registry;
+}
+
+Histogram* MetricsRegistry::GetHistogram(const std::string& name) {
+  std::lock_guard<std::mutex> lg(mutex_);
+  HistogramEntry& entry = histograms_[name];
+  if (entry.histogram == nullptr) entry.histogram.reset(new Histogram);
+  return entry.histogram.get();
+}
+
+Counter* MetricsRegistry::GetCounter(const std::string& name) {
+  std::lock_guard<std::mutex> lg(mutex_);
+  CounterEntry& entry = counters_[name];
+  if (entry.counter == nullptr) entry.counter.reset(new Counter);
+  return entry.counter.get();
+}
+
+std::vector<MetricSummary> MetricsRegistry::Collect() {
+  std::lock_guard<std::mutex> lg(mutex_);
+  std::vector<MetricSummary> summaries;
+  for (auto& name_and_entry : histograms_) {
+    HistogramEntry& entry = name_and_entry.second;
+    const Histogram::Snapshot snapshot = entry.histogram->GetSnapshot();
+    Histogram::Snapshot interval;
+    for (int i = 0; i < Histogram::kNumBuckets; ++i) {
+      interval.buckets[i] =
+          snapshot.buckets[i] - entry.last_snapshot.buckets[i];
+      interval.count += interval.buckets[i];
+    }
+    interval.sum = snapshot.sum - entry.last_snapshot.sum;
+    entry.last_snapshot = snapshot;
+
+    MetricSummary summary;
+    summary.name = name_and_entry.first;
+    summary.count = interval.count;
+    summary.mean = interval.count > 0 ? interval.sum / interval.count : 0.;
+    summary.p50 = interval.Percentile(0.5);
+    summary.p95 = interval.Percentile(0.95);
+    summary.p99 = interval.Percentile(0.99);
+    summaries.push_back(summary);
+  }
+  for (auto& name_and_entry : counters_) {
+    CounterEntry& entry = name_and_entry.second;
+    const int64_t value = entry.counter->value();
+    MetricSummary summary;
+    summary.name = name_and_entry.first;
+    summary.is_counter = true;
+    summary.count = value - entry.last_value;
+    entry.last_value = value;
+    summaries.push_back(summary);
+  }
+  std::sort(summaries.begin(), summaries.end(),
+            [](const MetricSummary& lhs, const MetricSummary& rhs) {
+              return lhs.name < rhs.name;
+            });
+  return summaries;
+}
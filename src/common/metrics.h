@@ -0,0 +1,151 @@
+#ifndef MSF_LOAM_VELODYNE_METRICS_H
+#define MSF_LOAM_VELODYNE_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A histogram of non-negative values with logarithmic buckets, four per
+// octave from 1e-3 up, i.e. percentiles are accurate to about 9%. Record() is
+// lock-free: every thread adds to one of a few shards of atomic counters, so
+// threads recording the same histogram rarely share a cache line.
+class Histogram {
+ public:
+  static constexpr int kNumBuckets = 128;
+
+  struct Snapshot {
+    std::array<uint64_t, kNumBuckets> buckets{};
+    uint64_t count = 0;
+    double sum = 0.;
+
+    // Value below which the fraction 'q' of the values fall, 0 if empty.
+    double Percentile(double q) const;
+  };
+
+  Histogram() = default;
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void Record(double value);
+
+  // Sums up the shards, may be called concurrently with Record().
+  Snapshot GetSnapshot() const;
+
+ private:
+  static constexpr int kNumShards = 8;
+
+  // Padded so that no cache line holds counters of two shards. C++14 does not
+  // align heap allocations beyond 16 bytes, so alignas would not help here.
+  struct Shard {
+    std::array<std::atomic<uint64_t>, kNumBuckets> buckets{};
+    // 以 1e-3 为单位的累加值
+    std::atomic<uint64_t> sum{0};
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+  };
+
+  std::array<Shard, kNumShards> shards_;
+};
+
+class Counter {
+ public:
+  void Add(const int64_t value) {
+    value_.fetch_add(value, std::memory_order_relaxed);
+  }
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+// Summary of a metric over the interval since the previous Collect().
+struct MetricSummary {
+  std::string name;
+  bool is_counter = false;
+  // Number of recorded values, or the increase of a counter.
+  uint64_t count = 0;
+  double mean = 0.;
+  double p50 = 0.;
+  double p95 = 0.;
+  double p99 = 0.;
+};
+
+/**
+ * @brief 全局的性能统计
+ *
+ * Named histograms and counters, created on first use and never destroyed.
+ * Looking a metric up takes a lock, so call sites keep the returned pointer,
+ * see METRICS_RECORD() and METRICS_COUNT().
+ */
+class MetricsRegistry {
+ public:
+  static MetricsRegistry& Get();
+
+  Histogram* GetHistogram(const std::string& name);
+  Counter* GetCounter(const std::string& name);
+
+  // Summaries of all metrics sorted by name, covering the values recorded
+  // since the previous call.
+  std::vector<MetricSummary> Collect();
+
+ private:
+  MetricsRegistry() = default;
+
+  struct HistogramEntry {
+    std::unique_ptr<Histogram> histogram;
+    Histogram::Snapshot last_snapshot;
+  };
+
+  struct CounterEntry {
+    std::unique_ptr<Counter> counter;
+    int64_t last_value = 0;
+  };
+
+  std::mutex mutex_;
+  std::map<std::string, HistogramEntry> histograms_;
+  std::map<std::string, CounterEntry> counters_;
+};
+
+// Define MSF_LOAM_NO_METRICS to compile the metrics out of the call sites.
+#ifndef MSF_LOAM_NO_METRICS
+
+#define METRICS_RECORD(name, value)                                  \
+  do {                                                               \
+    static Histogram* const metrics_histogram =                      \
+        MetricsRegistry::Get().GetHistogram(name);                   \
+    metrics_histogram->Record(value);                                \
+  } while (0)
+
+#define METRICS_COUNT(name, value)                                          \
+  do {                                                                      \
+    static Counter* const metrics_counter =                                 \
+        MetricsRegistry::Get().GetCounter(name);                            \
+    metrics_counter->Add(value);                                            \
+  } while (0)
+
+// For counters named at run time, e.g. one per instance: the call site keeps
+// the counter returned by METRICS_GET_COUNTER() and updates it with
+// METRICS_COUNTER_ADD().
+#define METRICS_GET_COUNTER(name) MetricsRegistry::Get().GetCounter(name)
+#define METRICS_COUNTER_ADD(counter, value) (counter)->Add(value)
+
+#else
+
+#define METRICS_RECORD(name, value) \
+  do {                              \
+  } while (0)
+#define METRICS_COUNT(name, value) \
+  do {                             \
+  } while (0)
+#define METRICS_GET_COUNTER(name) static_cast<Counter*>(nullptr)
+#define METRICS_COUNTER_ADD(counter, value) \
+  do {                                      \
+  } while (0)
+
+#endif  // MSF_LOAM_NO_METRICS
+
+#endif  // MSF_LOAM_VELODYNE_METRICS_H
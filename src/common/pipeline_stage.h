@@ -0,0 +1,198 @@
+#ifndef MSF_LOAM_VELODYNE_PIPELINE_STAGE_H
+#define MSF_LOAM_VELODYNE_PIPELINE_STAGE_H
+
+#include <glog/logging.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "common/metrics.h"
+#include "common/spsc_queue.h"
+
+// Pins the calling thread to 'cpu' and names it 'name'. A negative 'cpu'
+// leaves the affinity to the scheduler.
+inline void SetCurrentThreadAffinity(const std::string& name, const int cpu) {
+#ifdef __linux__
+  // Thread names are limited to 15 characters.
+  pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+  if (cpu < 0) return;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  LOG_IF(WARNING,
+         pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set))
+      << "Failed to pin " << name << " to cpu " << cpu;
+#else
+  LOG_IF(WARNING, cpu >= 0) << "Thread affinity is not supported, " << name
+                            << " is not pinned to cpu " << cpu;
+#endif
+}
+
+struct PipelineStageOptions {
+  // Used for the thread name and log messages.
+  std::string name;
+  // Maximum number of items waiting in front of the stage.
+  size_t queue_size = 16;
+  // CPU the worker thread is pinned to, or -1 for no pinning.
+  int cpu = -1;
+  // If true, Push() drops the item when the queue is full, otherwise it waits
+  // for the worker to make room. Real-time processing drops, offline
+  // processing waits.
+  bool drop_when_full = true;
+  // If true, the worker skips all but the newest queued item so that it
+  // always works on the latest data.
+  bool keep_latest_only = false;
+  // If true, an idle worker and a producer waiting for room sleep on a
+  // condition variable instead of polling. Offline processing blocks, which
+  // leaves the cores of waiting stages to the others. Real-time processing
+  // polls, which reacts within microseconds.
+  bool blocking = false;
+};
+
+// A stage of a processing pipeline: a worker thread consuming items from a
+// bounded lock-free queue. Exactly one thread may call Push().
+template <typename T>
+class PipelineStage {
+ public:
+  using Handler = std::function<void(T)>;
+
+  PipelineStage(const PipelineStageOptions& options, Handler handler)
+      : options_(options),
+        handler_(std::move(handler)),
+        queue_(options.queue_size),
+        should_exit_(false),
+        num_dropped_(0),
+        dropped_counter_(
+            METRICS_GET_COUNTER(options.name + "/dropped frames")) {
+    thread_ = std::thread([this] { this->Run(); });
+  }
+
+  // Processes all items still in the queue before returning.
+  ~PipelineStage() {
+    should_exit_.store(true, std::memory_order_release);
+    Notify();
+    thread_.join();
+  }
+
+  PipelineStage(const PipelineStage&) = delete;
+  PipelineStage& operator=(const PipelineStage&) = delete;
+
+  // Returns false if the item was dropped because the queue was full.
+  bool Push(T value) {
+    if (queue_.TryPush(std::move(value))) {
+      Notify();
+      return true;
+    }
+    if (options_.drop_when_full) {
+      ++num_dropped_;
+      METRICS_COUNTER_ADD(dropped_counter_, 1);
+      LOG(WARNING) << "[" << options_.name
+                   << "] queue full, drop frame for real time performance";
+      return false;
+    }
+    if (options_.blocking) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock,
+               [this, &value] { return queue_.TryPush(std::move(value)); });
+      lock.unlock();
+      cv_.notify_all();
+      return true;
+    }
+    Backoff backoff;
+    while (!queue_.TryPush(std::move(value))) backoff.Wait();
+    return true;
+  }
+
+  size_t num_dropped() const { return num_dropped_.load(); }
+
+  // Approximate number of items waiting, may be called from any thread.
+  size_t num_queued() const { return queue_.size(); }
+
+ private:
+  // Spins briefly, then yields, then sleeps so that an idle stage does not
+  // burn a core while a busy one reacts within microseconds.
+  class Backoff {
+   public:
+    void Wait() {
+      if (count_ < 64) {
+        ++count_;
+      } else if (count_ < 128) {
+        ++count_;
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+    }
+
+    void Reset() { count_ = 0; }
+
+   private:
+    int count_ = 0;
+  };
+
+  // Wakes up the other side in blocking mode. The queue is changed without
+  // the mutex, taking it before notifying makes sure that a thread which
+  // found the queue full or empty under the mutex is already waiting.
+  void Notify() {
+    if (!options_.blocking) return;
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    cv_.notify_all();
+  }
+
+  void Run() {
+    SetCurrentThreadAffinity(options_.name, options_.cpu);
+    Backoff backoff;
+    T value;
+    while (true) {
+      if (!queue_.TryPop(&value)) {
+        if (should_exit_.load(std::memory_order_acquire) && queue_.empty())
+          break;
+        if (options_.blocking) {
+          std::unique_lock<std::mutex> lock(mutex_);
+          cv_.wait(lock, [this] {
+            return !queue_.empty() ||
+                   should_exit_.load(std::memory_order_acquire);
+          });
+        } else {
+          backoff.Wait();
+        }
+        continue;
+      }
+      Notify();
+      backoff.Reset();
+      if (options_.keep_latest_only) {
+        while (queue_.TryPop(&value)) {
+          ++num_dropped_;
+          METRICS_COUNTER_ADD(dropped_counter_, 1);
+          LOG(WARNING) << "[" << options_.name
+                       << "] drop lidar frame for real time performance";
+        }
+      }
+      handler_(std::move(value));
+    }
+  }
+
+  const PipelineStageOptions options_;
+  const Handler handler_;
+  SpscQueue<T> queue_;
+  std::atomic<bool> should_exit_;
+  // Only used in blocking mode.
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::atomic<size_t> num_dropped_;
+  // Null without metrics.
+  Counter* const dropped_counter_;
+  std::thread thread_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_PIPELINE_STAGE_H
@@ -0,0 +1,94 @@
+#include "common/point_cloud_pool.h"
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+#include "common/metrics.h"
+
+namespace {
+
+// 容纳 'capacity' 个点的最小一级
+int AcquireClass(const size_t capacity) {
+  int size_class = 0;
+  while (size_class < PointCloudPool::kNumClasses &&
+         (PointCloudPool::kMinCapacity << size_class) < capacity) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+// The largest class a buffer of 'capacity' points can serve, -1 if none.
+int ReleaseClass(const size_t capacity) {
+  // 超过最大一级的缓冲区不保留
+  if (capacity < PointCloudPool::kMinCapacity ||
+      capacity >= (PointCloudPool::kMinCapacity
+                   << PointCloudPool::kNumClasses)) {
+    return -1;
+  }
+  int size_class = 0;
+  while ((PointCloudPool::kMinCapacity << (size_class + 1)) <= capacity) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+}  // namespace
+
+struct PointCloudPool::Shelves {
+  std::mutex mutex;
+  std::array<std::vector<std::unique_ptr<PointCloud>>, kNumClasses> clouds;
+};
+
+struct PointCloudPool::Recycler {
+  std::weak_ptr<Shelves> weak_shelves;
+
+  void operator()(PointCloud* const cloud) const {
+    std::unique_ptr<PointCloud> owned_cloud(cloud);
+    const int size_class = ReleaseClass(cloud->points.capacity());
+    const std::shared_ptr<Shelves> shelves = weak_shelves.lock();
+    if (size_class < 0 || shelves == nullptr) return;
+    cloud->clear();
+    cloud->header = pcl::PCLHeader();
+    cloud->is_dense = true;
+    std::lock_guard<std::mutex> lock(shelves->mutex);
+    auto& shelf = shelves->clouds[size_class];
+    if (static_cast<int>(shelf.size()) < kMaxCloudsPerClass) {
+      shelf.push_back(std::move(owned_cloud));
+    }
+  }
+};
+
+PointCloudPool::PointCloudPool() : shelves_(std::make_shared<Shelves>()) {}
+
+PointCloudPool& PointCloudPool::Get() {
+  static PointCloudPool* const pool = new PointCloudPool;
+  return *pool;
+}
+
+PointCloudPtr PointCloudPool::Acquire(const size_t capacity) {
+  const int size_class = AcquireClass(capacity);
+  std::unique_ptr<PointCloud> cloud;
+  if (size_class < kNumClasses) {
+    std::lock_guard<std::mutex> lock(shelves_->mutex);
+    auto& shelf = shelves_->clouds[size_class];
+    if (!shelf.empty()) {
+      cloud = std::move(shelf.back());
+      shelf.pop_back();
+    }
+  }
+  if (cloud == nullptr) {
+    METRICS_COUNT("MEM/cloud allocations", 1);
+    cloud.reset(new PointCloud);
+    cloud->reserve(size_class < kNumClasses ? kMinCapacity << size_class
+                                            : capacity);
+  }
+  return PointCloudPtr(cloud.release(), Recycler{shelves_});
+}
+
+int PointCloudPool::num_cached_clouds() const {
+  std::lock_guard<std::mutex> lock(shelves_->mutex);
+  int num_clouds = 0;
+  for (const auto& shelf : shelves_->clouds) num_clouds += shelf.size();
+  return num_clouds;
+}
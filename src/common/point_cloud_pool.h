@@ -0,0 +1,55 @@
+#ifndef MSF_LOAM_VELODYNE_POINT_CLOUD_POOL_H
+#define MSF_LOAM_VELODYNE_POINT_CLOUD_POOL_H
+
+#include <cstddef>
+#include <memory>
+
+#include "common/common.h"
+
+/**
+ * @brief 点云对象池
+ *
+ * Recycles the clouds every frame allocates and frees: a cloud handed out by
+ * Acquire() goes back to the pool when its last reference drops, on whichever
+ * thread that happens, and its buffer is reused by a later Acquire() of the
+ * same capacity class. The classes are powers of two from kMinCapacity
+ * points, so a steady stream of frames stops allocating and page faulting
+ * after the first few frames.
+ *
+ * Clouds may outlive the pool, they are freed when released then. At most
+ * kMaxCloudsPerClass clouds are kept per class, clouds beyond the largest
+ * class are not kept.
+ */
+class PointCloudPool {
+ public:
+  static constexpr size_t kMinCapacity = 1024;
+  // 最大一级 2M 个点
+  static constexpr int kNumClasses = 12;
+  static constexpr int kMaxCloudsPerClass = 32;
+
+  PointCloudPool();
+
+  PointCloudPool(const PointCloudPool&) = delete;
+  PointCloudPool& operator=(const PointCloudPool&) = delete;
+
+  // The pool of AcquirePointCloud(), never destroyed.
+  static PointCloudPool& Get();
+
+  // An empty cloud with room for at least 'capacity' points.
+  PointCloudPtr Acquire(size_t capacity);
+
+  // Clouds waiting to be reused.
+  int num_cached_clouds() const;
+
+ private:
+  struct Shelves;
+  struct Recycler;
+
+  const std::shared_ptr<Shelves> shelves_;
+};
+
+inline PointCloudPtr AcquirePointCloud(const size_t capacity = 0) {
+  return PointCloudPool::Get().Acquire(capacity);
+}
+
+#endif  // MSF_LOAM_VELODYNE_POINT_CLOUD_POOL_H
@@ -0,0 +1,484 @@
+#include "common/point_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if !defined(MSF_LOAM_NO_SIMD) && defined(__AVX2__)
+#define MSF_LOAM_AVX2 1
+#include <immintrin.h>
+#endif
+#if !defined(MSF_LOAM_NO_SIMD) && defined(__SSE2__)
+#define MSF_LOAM_SSE2 1
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+#if !defined(MSF_LOAM_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define MSF_LOAM_NEON 1
+#include <arm_neon.h>
+#endif
+#if defined(MSF_LOAM_SSE2) || defined(MSF_LOAM_NEON)
+#define MSF_LOAM_SIMD 1
+#endif
+
+namespace {
+
+inline void TransformPoint(const AffineTransform3f& transform, const float x,
+                           const float y, const float z, float* out_x,
+                           float* out_y, float* out_z) {
+  const float* r = transform.r;
+  const float* t = transform.t;
+  *out_x = r[0] * x + r[1] * y + r[2] * z + t[0];
+  *out_y = r[3] * x + r[4] * y + r[5] * z + t[1];
+  *out_z = r[6] * x + r[7] * y + r[8] * z + t[2];
+}
+
+#if defined(MSF_LOAM_NEON)
+// Transposes 4 points (x, y, z, w) into the vectors x, y, z and w and back.
+inline void Transpose4(float32x4_t* r0, float32x4_t* r1, float32x4_t* r2,
+                       float32x4_t* r3) {
+  const float32x4x2_t t01 = vtrnq_f32(*r0, *r1);
+  const float32x4x2_t t23 = vtrnq_f32(*r2, *r3);
+  *r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+  *r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+  *r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+  *r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+#endif
+
+}  // namespace
+
+void ComputeCurvatures(const float* x, const float* y, const float* z,
+                       const int num_points, float* curvatures) {
+  std::fill(curvatures, curvatures + std::max(num_points, 0), 0.f);
+  int i = 5;
+  const int end = num_points - 5;
+  // The stencil is summed in float in the same order as the scalar code, only
+  // the squares are accumulated in double.
+#if defined(MSF_LOAM_AVX2)
+  const __m256 k10 = _mm256_set1_ps(10.f);
+  const auto stencil = [&k10](const float* p) {
+    __m256 sum = _mm256_loadu_ps(p - 5);
+    sum = _mm256_add_ps(sum, _mm256_loadu_ps(p - 4));
+    sum = _mm256_add_ps(sum, _mm256_loadu_ps(p - 3));
+    sum = _mm256_add_ps(sum, _mm256_loadu_ps(p - 2));
+    sum = _mm256_add_ps(sum, _mm256_loadu_ps(p - 1));
+    sum = _mm256_sub_ps(sum, _mm256_mul_ps(k10, _mm256_loadu_ps(p)));
+    sum = _mm256_add_ps(sum, _mm256_loadu_ps(p + 1));
+    sum = _mm256_add_ps(sum, _mm256_loadu_ps(p + 2));
+    sum = _mm256_add_ps(sum, _mm256_loadu_ps(p + 3));
+    sum = _mm256_add_ps(sum, _mm256_loadu_ps(p + 4));
+    return _mm256_add_ps(sum, _mm256_loadu_ps(p + 5));
+  };
+  const auto square = [](const __m128 v) {
+    const __m256d d = _mm256_cvtps_pd(v);
+    return _mm256_mul_pd(d, d);
+  };
+  for (; i + 8 <= end; i += 8) {
+    const __m256 dx = stencil(x + i);
+    const __m256 dy = stencil(y + i);
+    const __m256 dz = stencil(z + i);
+    for (int half = 0; half < 2; ++half) {
+      const __m256d c = _mm256_add_pd(
+          _mm256_add_pd(square(half ? _mm256_extractf128_ps(dx, 1)
+                                    : _mm256_castps256_ps128(dx)),
+                        square(half ? _mm256_extractf128_ps(dy, 1)
+                                    : _mm256_castps256_ps128(dy))),
+          square(half ? _mm256_extractf128_ps(dz, 1)
+                      : _mm256_castps256_ps128(dz)));
+      _mm_storeu_ps(curvatures + i + 4 * half, _mm256_cvtpd_ps(c));
+    }
+  }
+#elif defined(MSF_LOAM_SSE2)
+  const __m128 k10 = _mm_set1_ps(10.f);
+  const auto stencil = [&k10](const float* p) {
+    __m128 sum = _mm_loadu_ps(p - 5);
+    sum = _mm_add_ps(sum, _mm_loadu_ps(p - 4));
+    sum = _mm_add_ps(sum, _mm_loadu_ps(p - 3));
+    sum = _mm_add_ps(sum, _mm_loadu_ps(p - 2));
+    sum = _mm_add_ps(sum, _mm_loadu_ps(p - 1));
+    sum = _mm_sub_ps(sum, _mm_mul_ps(k10, _mm_loadu_ps(p)));
+    sum = _mm_add_ps(sum, _mm_loadu_ps(p + 1));
+    sum = _mm_add_ps(sum, _mm_loadu_ps(p + 2));
+    sum = _mm_add_ps(sum, _mm_loadu_ps(p + 3));
+    sum = _mm_add_ps(sum, _mm_loadu_ps(p + 4));
+    return _mm_add_ps(sum, _mm_loadu_ps(p + 5));
+  };
+  const auto square = [](const __m128 v) {
+    const __m128d d = _mm_cvtps_pd(v);
+    return _mm_mul_pd(d, d);
+  };
+  for (; i + 4 <= end; i += 4) {
+    const __m128 dx = stencil(x + i);
+    const __m128 dy = stencil(y + i);
+    const __m128 dz = stencil(z + i);
+    const __m128d lo = _mm_add_pd(_mm_add_pd(square(dx), square(dy)),
+                                  square(dz));
+    const __m128d hi =
+        _mm_add_pd(_mm_add_pd(square(_mm_movehl_ps(dx, dx)),
+                              square(_mm_movehl_ps(dy, dy))),
+                   square(_mm_movehl_ps(dz, dz)));
+    _mm_storeu_ps(curvatures + i,
+                  _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+  }
+#elif defined(MSF_LOAM_NEON)
+  const auto stencil = [](const float* p) {
+    float32x4_t sum = vld1q_f32(p - 5);
+    sum = vaddq_f32(sum, vld1q_f32(p - 4));
+    sum = vaddq_f32(sum, vld1q_f32(p - 3));
+    sum = vaddq_f32(sum, vld1q_f32(p - 2));
+    sum = vaddq_f32(sum, vld1q_f32(p - 1));
+    sum = vsubq_f32(sum, vmulq_n_f32(vld1q_f32(p), 10.f));
+    sum = vaddq_f32(sum, vld1q_f32(p + 1));
+    sum = vaddq_f32(sum, vld1q_f32(p + 2));
+    sum = vaddq_f32(sum, vld1q_f32(p + 3));
+    sum = vaddq_f32(sum, vld1q_f32(p + 4));
+    return vaddq_f32(sum, vld1q_f32(p + 5));
+  };
+  for (; i + 4 <= end; i += 4) {
+    const float32x4_t dx = stencil(x + i);
+    const float32x4_t dy = stencil(y + i);
+    const float32x4_t dz = stencil(z + i);
+#if defined(__aarch64__)
+    const auto square = [](const float32x2_t v) {
+      const float64x2_t d = vcvt_f64_f32(v);
+      return vmulq_f64(d, d);
+    };
+    const float64x2_t lo = vaddq_f64(
+        vaddq_f64(square(vget_low_f32(dx)), square(vget_low_f32(dy))),
+        square(vget_low_f32(dz)));
+    const float64x2_t hi = vaddq_f64(
+        vaddq_f64(square(vget_high_f32(dx)), square(vget_high_f32(dy))),
+        square(vget_high_f32(dz)));
+    vst1q_f32(curvatures + i,
+              vcombine_f32(vcvt_f32_f64(lo), vcvt_f32_f64(hi)));
+#else
+    // ARMv7 has no double precision vectors, the squares are summed in float.
+    vst1q_f32(curvatures + i,
+              vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz));
+#endif
+  }
+#endif
+  for (; i < end; ++i) {
+    const double dx = x[i - 5] + x[i - 4] + x[i - 3] + x[i - 2] + x[i - 1] -
+                      10 * x[i] + x[i + 1] + x[i + 2] + x[i + 3] + x[i + 4] +
+                      x[i + 5];
+    const double dy = y[i - 5] + y[i - 4] + y[i - 3] + y[i - 2] + y[i - 1] -
+                      10 * y[i] + y[i + 1] + y[i + 2] + y[i + 3] + y[i + 4] +
+                      y[i + 5];
+    const double dz = z[i - 5] + z[i - 4] + z[i - 3] + z[i - 2] + z[i - 1] -
+                      10 * z[i] + z[i + 1] + z[i + 2] + z[i + 3] + z[i + 4] +
+                      z[i + 5];
+    curvatures[i] = dx * dx + dy * dy + dz * dz;
+  }
+}
+
+void TransformPointsSoA(const AffineTransform3f& transform, const float* x,
+                        const float* y, const float* z, const int num_points,
+                        float* out_x, float* out_y, float* out_z) {
+  int i = 0;
+#if defined(MSF_LOAM_SIMD)
+  const float* r = transform.r;
+  const float* t = transform.t;
+#endif
+#if defined(MSF_LOAM_AVX2)
+  const __m256 r0 = _mm256_set1_ps(r[0]), r1 = _mm256_set1_ps(r[1]),
+               r2 = _mm256_set1_ps(r[2]), r3 = _mm256_set1_ps(r[3]),
+               r4 = _mm256_set1_ps(r[4]), r5 = _mm256_set1_ps(r[5]),
+               r6 = _mm256_set1_ps(r[6]), r7 = _mm256_set1_ps(r[7]),
+               r8 = _mm256_set1_ps(r[8]);
+  const __m256 t0 = _mm256_set1_ps(t[0]), t1 = _mm256_set1_ps(t[1]),
+               t2 = _mm256_set1_ps(t[2]);
+  for (; i + 8 <= num_points; i += 8) {
+    const __m256 vx = _mm256_loadu_ps(x + i);
+    const __m256 vy = _mm256_loadu_ps(y + i);
+    const __m256 vz = _mm256_loadu_ps(z + i);
+    _mm256_storeu_ps(out_x + i,
+                     _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r0, vx),
+                                                 _mm256_mul_ps(r1, vy)),
+                                   _mm256_add_ps(_mm256_mul_ps(r2, vz), t0)));
+    _mm256_storeu_ps(out_y + i,
+                     _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r3, vx),
+                                                 _mm256_mul_ps(r4, vy)),
+                                   _mm256_add_ps(_mm256_mul_ps(r5, vz), t1)));
+    _mm256_storeu_ps(out_z + i,
+                     _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r6, vx),
+                                                 _mm256_mul_ps(r7, vy)),
+                                   _mm256_add_ps(_mm256_mul_ps(r8, vz), t2)));
+  }
+#elif defined(MSF_LOAM_SSE2)
+  const __m128 r0 = _mm_set1_ps(r[0]), r1 = _mm_set1_ps(r[1]),
+               r2 = _mm_set1_ps(r[2]), r3 = _mm_set1_ps(r[3]),
+               r4 = _mm_set1_ps(r[4]), r5 = _mm_set1_ps(r[5]),
+               r6 = _mm_set1_ps(r[6]), r7 = _mm_set1_ps(r[7]),
+               r8 = _mm_set1_ps(r[8]);
+  const __m128 t0 = _mm_set1_ps(t[0]), t1 = _mm_set1_ps(t[1]),
+               t2 = _mm_set1_ps(t[2]);
+  for (; i + 4 <= num_points; i += 4) {
+    const __m128 vx = _mm_loadu_ps(x + i);
+    const __m128 vy = _mm_loadu_ps(y + i);
+    const __m128 vz = _mm_loadu_ps(z + i);
+    _mm_storeu_ps(out_x + i,
+                  _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, vx), _mm_mul_ps(r1, vy)),
+                             _mm_add_ps(_mm_mul_ps(r2, vz), t0)));
+    _mm_storeu_ps(out_y + i,
+                  _mm_add_ps(_mm_add_ps(_mm_mul_ps(r3, vx), _mm_mul_ps(r4, vy)),
+                             _mm_add_ps(_mm_mul_ps(r5, vz), t1)));
+    _mm_storeu_ps(out_z + i,
+                  _mm_add_ps(_mm_add_ps(_mm_mul_ps(r6, vx), _mm_mul_ps(r7, vy)),
+                             _mm_add_ps(_mm_mul_ps(r8, vz), t2)));
+  }
+#elif defined(MSF_LOAM_NEON)
+  for (; i + 4 <= num_points; i += 4) {
+    const float32x4_t vx = vld1q_f32(x + i);
+    const float32x4_t vy = vld1q_f32(y + i);
+    const float32x4_t vz = vld1q_f32(z + i);
+    vst1q_f32(out_x + i,
+              vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[0]), vx, r[0]),
+                                      vy, r[1]),
+                          vz, r[2]));
+    vst1q_f32(out_y + i,
+              vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[1]), vx, r[3]),
+                                      vy, r[4]),
+                          vz, r[5]));
+    vst1q_f32(out_z + i,
+              vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[2]), vx, r[6]),
+                                      vy, r[7]),
+                          vz, r[8]));
+  }
+#endif
+  for (; i < num_points; ++i) {
+    TransformPoint(transform, x[i], y[i], z[i], out_x + i, out_y + i,
+                   out_z + i);
+  }
+}
+
+void TransformPointsAoS(const AffineTransform3f& transform, const float* in,
+                        const int stride, const int num_points, float* out) {
+  int i = 0;
+#if defined(MSF_LOAM_SIMD)
+  const float* r = transform.r;
+  const float* t = transform.t;
+#endif
+#if defined(MSF_LOAM_SSE2)
+  // Four points are transposed into registers holding x, y, z and the padding
+  // of all four, transformed like SoA data, and transposed back.
+  const __m128 r0 = _mm_set1_ps(r[0]), r1 = _mm_set1_ps(r[1]),
+               r2 = _mm_set1_ps(r[2]), r3 = _mm_set1_ps(r[3]),
+               r4 = _mm_set1_ps(r[4]), r5 = _mm_set1_ps(r[5]),
+               r6 = _mm_set1_ps(r[6]), r7 = _mm_set1_ps(r[7]),
+               r8 = _mm_set1_ps(r[8]);
+  const __m128 t0 = _mm_set1_ps(t[0]), t1 = _mm_set1_ps(t[1]),
+               t2 = _mm_set1_ps(t[2]);
+  for (; stride >= 4 && i + 4 <= num_points; i += 4) {
+    const float* p = in + i * stride;
+    float* q = out + i * stride;
+    __m128 vx = _mm_loadu_ps(p);
+    __m128 vy = _mm_loadu_ps(p + stride);
+    __m128 vz = _mm_loadu_ps(p + 2 * stride);
+    __m128 vw = _mm_loadu_ps(p + 3 * stride);
+    _MM_TRANSPOSE4_PS(vx, vy, vz, vw);
+    __m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, vx), _mm_mul_ps(r1, vy)),
+                           _mm_add_ps(_mm_mul_ps(r2, vz), t0));
+    __m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r3, vx), _mm_mul_ps(r4, vy)),
+                           _mm_add_ps(_mm_mul_ps(r5, vz), t1));
+    __m128 oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r6, vx), _mm_mul_ps(r7, vy)),
+                           _mm_add_ps(_mm_mul_ps(r8, vz), t2));
+    _MM_TRANSPOSE4_PS(ox, oy, oz, vw);
+    if (in != out && stride > 4) {
+      for (int k = 0; k < 4; ++k) {
+        std::memcpy(q + k * stride + 4, p + k * stride + 4,
+                    (stride - 4) * sizeof(float));
+      }
+    }
+    _mm_storeu_ps(q, ox);
+    _mm_storeu_ps(q + stride, oy);
+    _mm_storeu_ps(q + 2 * stride, oz);
+    _mm_storeu_ps(q + 3 * stride, vw);
+  }
+#elif defined(MSF_LOAM_NEON)
+  for (; stride >= 4 && i + 4 <= num_points; i += 4) {
+    const float* p = in + i * stride;
+    float* q = out + i * stride;
+    float32x4_t vx = vld1q_f32(p);
+    float32x4_t vy = vld1q_f32(p + stride);
+    float32x4_t vz = vld1q_f32(p + 2 * stride);
+    float32x4_t vw = vld1q_f32(p + 3 * stride);
+    Transpose4(&vx, &vy, &vz, &vw);
+    float32x4_t ox =
+        vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[0]), vx, r[0]), vy,
+                                r[1]),
+                    vz, r[2]);
+    float32x4_t oy =
+        vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[1]), vx, r[3]), vy,
+                                r[4]),
+                    vz, r[5]);
+    float32x4_t oz =
+        vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[2]), vx, r[6]), vy,
+                                r[7]),
+                    vz, r[8]);
+    Transpose4(&ox, &oy, &oz, &vw);
+    if (in != out && stride > 4) {
+      for (int k = 0; k < 4; ++k) {
+        std::memcpy(q + k * stride + 4, p + k * stride + 4,
+                    (stride - 4) * sizeof(float));
+      }
+    }
+    vst1q_f32(q, ox);
+    vst1q_f32(q + stride, oy);
+    vst1q_f32(q + 2 * stride, oz);
+    vst1q_f32(q + 3 * stride, vw);
+  }
+#endif
+  for (; i < num_points; ++i) {
+    const float* p = in + i * stride;
+    float* q = out + i * stride;
+    float ox, oy, oz;
+    TransformPoint(transform, p[0], p[1], p[2], &ox, &oy, &oz);
+    if (in != out) std::memcpy(q + 3, p + 3, (stride - 3) * sizeof(float));
+    q[0] = ox;
+    q[1] = oy;
+    q[2] = oz;
+  }
+}
+
+void DeskewPointsAoS(const AffineTransform3f* table, const int num_segments,
+                     const int time_index, const float time_scale,
+                     const float* in, const int stride, const int num_points,
+                     float* out) {
+  // Segment and weight of the point starting at 'p'.
+  const auto segment_of = [&](const float* p, float* weight) {
+    const float value = p[time_index];
+    float time = (value - std::floor(value)) * time_scale;
+    time = std::min(std::max(time, 0.f), 1.f) * num_segments;
+    const int segment = std::min(static_cast<int>(time), num_segments - 1);
+    *weight = time - segment;
+    return segment;
+  };
+  const auto deskew_point = [&](const float* p, float* q) {
+    float weight;
+    const int segment = segment_of(p, &weight);
+    const AffineTransform3f& a = table[segment];
+    const AffineTransform3f& b = table[segment + 1];
+    AffineTransform3f transform;
+    for (int j = 0; j < 9; ++j) {
+      transform.r[j] = a.r[j] + weight * (b.r[j] - a.r[j]);
+    }
+    for (int j = 0; j < 3; ++j) {
+      transform.t[j] = a.t[j] + weight * (b.t[j] - a.t[j]);
+    }
+    float ox, oy, oz;
+    TransformPoint(transform, p[0], p[1], p[2], &ox, &oy, &oz);
+    if (in != out) std::memcpy(q + 3, p + 3, (stride - 3) * sizeof(float));
+    q[0] = ox;
+    q[1] = oy;
+    q[2] = oz;
+  };
+  int i = 0;
+#if defined(MSF_LOAM_SSE2)
+  // Points are stored in time order within a ring, so usually four
+  // consecutive points share a segment. Those are transformed together by
+  // the segment start and the difference to its end,
+  //   q = a * p + w * ((b - a) * p).
+  // The first four floats of a point are loaded together, shorter points
+  // take the scalar path.
+  float weights[4];
+  for (; stride >= 4 && i + 4 <= num_points; i += 4) {
+    const float* p = in + i * stride;
+    float* q = out + i * stride;
+    const int segment = segment_of(p, &weights[0]);
+    bool same_segment = true;
+    for (int k = 1; k < 4; ++k) {
+      same_segment &= segment_of(p + k * stride, &weights[k]) == segment;
+    }
+    if (!same_segment) {
+      for (int k = 0; k < 4; ++k) deskew_point(p + k * stride, q + k * stride);
+      continue;
+    }
+    const AffineTransform3f& a = table[segment];
+    const AffineTransform3f& b = table[segment + 1];
+    __m128 vx = _mm_loadu_ps(p);
+    __m128 vy = _mm_loadu_ps(p + stride);
+    __m128 vz = _mm_loadu_ps(p + 2 * stride);
+    __m128 vw = _mm_loadu_ps(p + 3 * stride);
+    _MM_TRANSPOSE4_PS(vx, vy, vz, vw);
+    const __m128 w = _mm_loadu_ps(weights);
+    __m128 o[3];
+    for (int row = 0; row < 3; ++row) {
+      const float* ra = a.r + 3 * row;
+      const float* rb = b.r + 3 * row;
+      const __m128 pa = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ra[0]), vx),
+                     _mm_mul_ps(_mm_set1_ps(ra[1]), vy)),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ra[2]), vz),
+                     _mm_set1_ps(a.t[row])));
+      const __m128 pd = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(rb[0] - ra[0]), vx),
+                     _mm_mul_ps(_mm_set1_ps(rb[1] - ra[1]), vy)),
+          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(rb[2] - ra[2]), vz),
+                     _mm_set1_ps(b.t[row] - a.t[row])));
+      o[row] = _mm_add_ps(pa, _mm_mul_ps(w, pd));
+    }
+    _MM_TRANSPOSE4_PS(o[0], o[1], o[2], vw);
+    if (in != out && stride > 4) {
+      for (int k = 0; k < 4; ++k) {
+        std::memcpy(q + k * stride + 4, p + k * stride + 4,
+                    (stride - 4) * sizeof(float));
+      }
+    }
+    _mm_storeu_ps(q, o[0]);
+    _mm_storeu_ps(q + stride, o[1]);
+    _mm_storeu_ps(q + 2 * stride, o[2]);
+    _mm_storeu_ps(q + 3 * stride, vw);
+  }
+#endif
+  for (; i < num_points; ++i) {
+    deskew_point(in + i * stride, out + i * stride);
+  }
+}
+
+void ComputeRangeMaskAoS(const float* in, const int stride,
+                         const int num_points, const float min_squared_range,
+                         const float max_squared_range, bool* keep) {
+  int i = 0;
+#if defined(MSF_LOAM_SSE2)
+  const __m128 min = _mm_set1_ps(min_squared_range);
+  const __m128 max = _mm_set1_ps(max_squared_range);
+  for (; stride >= 4 && i + 4 <= num_points; i += 4) {
+    const float* p = in + i * stride;
+    __m128 vx = _mm_loadu_ps(p);
+    __m128 vy = _mm_loadu_ps(p + stride);
+    __m128 vz = _mm_loadu_ps(p + 2 * stride);
+    __m128 vw = _mm_loadu_ps(p + 3 * stride);
+    _MM_TRANSPOSE4_PS(vx, vy, vz, vw);
+    const __m128 v =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+                   _mm_mul_ps(vz, vz));
+    const int mask =
+        _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(v, min), _mm_cmple_ps(v, max)));
+    for (int k = 0; k < 4; ++k) keep[i + k] = (mask >> k) & 1;
+  }
+#elif defined(MSF_LOAM_NEON)
+  for (; stride >= 4 && i + 4 <= num_points; i += 4) {
+    const float* p = in + i * stride;
+    float32x4_t vx = vld1q_f32(p);
+    float32x4_t vy = vld1q_f32(p + stride);
+    float32x4_t vz = vld1q_f32(p + 2 * stride);
+    float32x4_t vw = vld1q_f32(p + 3 * stride);
+    Transpose4(&vx, &vy, &vz, &vw);
+    const float32x4_t v =
+        vmlaq_f32(vmlaq_f32(vmulq_f32(vx, vx), vy, vy), vz, vz);
+    uint32_t mask[4];
+    vst1q_u32(mask,
+              vandq_u32(vcgeq_f32(v, vdupq_n_f32(min_squared_range)),
+                        vcleq_f32(v, vdupq_n_f32(max_squared_range))));
+    for (int k = 0; k < 4; ++k) keep[i + k] = mask[k] != 0;
+  }
+#endif
+  for (; i < num_points; ++i) {
+    const float* p = in + i * stride;
+    const float squared_range = p[0] * p[0] + p[1] * p[1] + p[2] * p[2];
+    keep[i] = squared_range >= min_squared_range &&
+              squared_range <= max_squared_range;
+  }
+}
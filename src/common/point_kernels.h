@@ -0,0 +1,61 @@
+#ifndef MSF_LOAM_VELODYNE_POINT_KERNELS_H
+#define MSF_LOAM_VELODYNE_POINT_KERNELS_H
+
+/**
+ * @brief Vectorized kernels for the per-point hot loops
+ *
+ * The kernels use AVX2 (if the translation unit is built with it), SSE2 or
+ * NEON and fall back to scalar code otherwise, or if MSF_LOAM_NO_SIMD is
+ * defined. They work on raw float arrays so that this header does not pull in
+ * Eigen or PCL: the kernels may be built with different instruction set flags
+ * than the rest of the code, which must not change the alignment of any type
+ * shared between translation units.
+ *
+ * SoA kernels take one array per coordinate. AoS kernels take the address of
+ * the first 'x' of points of 'stride' floats starting with x, y and z, e.g.
+ * pcl::PointXYZ (stride 4) or pcl::PointXYZI (stride 8). Each kernel states
+ * its minimum stride, at least 3; strides less than 4 use the scalar code.
+ */
+
+// out = r * p + t, 'r' being row-major.
+struct AffineTransform3f {
+  float r[9];
+  float t[3];
+};
+
+// Computes the LOAM curvature of every point of a scan line,
+//   curvature[i] = |p[i-5] + ... + p[i-1] - 10 * p[i] + p[i+1] + ... p[i+5]|^2
+// for 'i' in [5, num_points - 5). The sums are computed in float in the order
+// written, so the result is bit-identical to the scalar formula. The first
+// and last 5 values are set to 0.
+void ComputeCurvatures(const float* x, const float* y, const float* z,
+                       int num_points, float* curvatures);
+
+void TransformPointsSoA(const AffineTransform3f& transform, const float* x,
+                        const float* y, const float* z, int num_points,
+                        float* out_x, float* out_y, float* out_z);
+
+// Transforms x, y and z of every point of 'stride' floats, at least 3. The
+// remaining floats of every point are copied. 'in' and 'out' may be equal.
+void TransformPointsAoS(const AffineTransform3f& transform, const float* in,
+                        int stride, int num_points, float* out);
+
+// Moves every point by the transform at its time, interpolated linearly in
+// the 'num_segments' + 1 entries of 'table' which sample the time range [0, 1]
+// evenly. The time of a point is the fractional part of its float at
+// 'time_index' (the intensity of pcl::PointXYZI holds ring + time) times
+// 'time_scale', clamped to [0, 1]. Floats other than x, y and z are copied,
+// 'stride' is the number of floats per point, at least 3 and greater than
+// 'time_index'. 'in' and 'out' may be equal.
+void DeskewPointsAoS(const AffineTransform3f* table, int num_segments,
+                     int time_index, float time_scale, const float* in,
+                     int stride, int num_points, float* out);
+
+// Sets 'keep[i]' to whether the squared range of point 'i' is in
+// [min_squared_range, max_squared_range], the points being left in place.
+// NaN points are never kept. A point has 'stride' floats, at least 3.
+void ComputeRangeMaskAoS(const float* in, int stride, int num_points,
+                         float min_squared_range, float max_squared_range,
+                         bool* keep);
+
+#endif  // MSF_LOAM_VELODYNE_POINT_KERNELS_H
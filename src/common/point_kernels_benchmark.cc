@@ -0,0 +1,208 @@
+#include <benchmark/benchmark.h>
+#include <Eigen/Geometry>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "common/point_kernels.h"
+
+/**
+ * @brief Micro benchmarks of the point kernels against the scalar code they
+ * replace
+ *
+ * The sizes are those of a single VLP-16 scan line (1800 points) and of a
+ * full VLP-16 / HDL-64 scan.
+ */
+
+namespace {
+
+constexpr int kStride = 8;  // pcl::PointXYZI
+
+struct Points {
+  explicit Points(const int num_points)
+      : x(num_points), y(num_points), z(num_points), aos(num_points * kStride) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-50.f, 50.f);
+    for (int i = 0; i < num_points; ++i) {
+      x[i] = aos[i * kStride] = dist(rng);
+      y[i] = aos[i * kStride + 1] = dist(rng);
+      z[i] = aos[i * kStride + 2] = dist(rng) * 0.1f;
+      aos[i * kStride + 4] = i;  // intensity
+    }
+  }
+  std::vector<float> x, y, z, aos;
+};
+
+const AffineTransform3f kTransform = {
+    {0.36f, 0.48f, -0.8f, -0.8f, 0.6f, 0.f, 0.48f, 0.64f, 0.6f},
+    {1.f, 2.f, 3.f}};
+
+// 原始的曲率计算
+void ReferenceCurvatures(const float* p, const int num_points,
+                         float* curvatures) {
+  for (int i = 5; i < num_points - 5; i++) {
+    double diff[3];
+    for (int d = 0; d < 3; ++d) {
+      diff[d] = p[(i - 5) * kStride + d] + p[(i - 4) * kStride + d] +
+                p[(i - 3) * kStride + d] + p[(i - 2) * kStride + d] +
+                p[(i - 1) * kStride + d] - 10 * p[i * kStride + d] +
+                p[(i + 1) * kStride + d] + p[(i + 2) * kStride + d] +
+                p[(i + 3) * kStride + d] + p[(i + 4) * kStride + d] +
+                p[(i + 5) * kStride + d];
+    }
+    curvatures[i] = diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+  }
+}
+
+void BM_ReferenceCurvatures(benchmark::State& state) {
+  const Points points(state.range(0));
+  std::vector<float> curvatures(state.range(0));
+  for (auto _ : state) {
+    ReferenceCurvatures(points.aos.data(), state.range(0), curvatures.data());
+    benchmark::DoNotOptimize(curvatures.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReferenceCurvatures)->Arg(1800)->Arg(28800);
+
+void BM_ComputeCurvatures(benchmark::State& state) {
+  const Points points(state.range(0));
+  std::vector<float> curvatures(state.range(0));
+  for (auto _ : state) {
+    ComputeCurvatures(points.x.data(), points.y.data(), points.z.data(),
+                      state.range(0), curvatures.data());
+    benchmark::DoNotOptimize(curvatures.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ComputeCurvatures)->Arg(1800)->Arg(28800);
+
+// 原始的点云变换，每个点一次 Rigid3d 变换
+void BM_ReferenceTransform(benchmark::State& state) {
+  const Points points(state.range(0));
+  std::vector<float> out(points.aos);
+  Eigen::Matrix3d r;
+  r << 0.36, 0.48, -0.8, -0.8, 0.6, 0., 0.48, 0.64, 0.6;
+  const Eigen::Quaterniond rotation(r);
+  const Eigen::Vector3d translation(1., 2., 3.);
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); ++i) {
+      Eigen::Map<Eigen::Vector3f>(out.data() + i * kStride) =
+          (rotation * Eigen::Map<const Eigen::Vector3f>(points.aos.data() +
+                                                       i * kStride)
+                          .cast<double>() +
+           translation)
+              .cast<float>();
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReferenceTransform)->Arg(28800)->Arg(120000);
+
+void BM_TransformPointsAoS(benchmark::State& state) {
+  const Points points(state.range(0));
+  std::vector<float> out(points.aos.size());
+  for (auto _ : state) {
+    TransformPointsAoS(kTransform, points.aos.data(), kStride, state.range(0),
+                       out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformPointsAoS)->Arg(28800)->Arg(120000);
+
+void BM_TransformPointsSoA(benchmark::State& state) {
+  const Points points(state.range(0));
+  std::vector<float> x(state.range(0)), y(state.range(0)), z(state.range(0));
+  for (auto _ : state) {
+    TransformPointsSoA(kTransform, points.x.data(), points.y.data(),
+                       points.z.data(), state.range(0), x.data(), y.data(),
+                       z.data());
+    benchmark::DoNotOptimize(x.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransformPointsSoA)->Arg(28800)->Arg(120000);
+
+// Points of 16 rings in time order within the scan period of 0.1 s.
+std::vector<float> TimedPoints(const int num_points) {
+  std::vector<float> aos = Points(num_points).aos;
+  for (int i = 0; i < num_points; ++i) {
+    aos[i * kStride + 4] =
+        (i * 16 / num_points) + 0.1f * (i * 16 % num_points) / num_points;
+  }
+  return aos;
+}
+
+// 原始的逐点 slerp 去畸变
+void BM_ReferenceDeskew(benchmark::State& state) {
+  const std::vector<float> in = TimedPoints(state.range(0));
+  std::vector<float> out(in.size());
+  const Eigen::Quaterniond rotation(
+      Eigen::AngleAxisd(0.05, Eigen::Vector3d::UnitZ()));
+  const Eigen::Vector3d translation(1., 0.1, 0.);
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); ++i) {
+      const float* p = in.data() + i * kStride;
+      const double s = (p[4] - static_cast<int>(p[4])) / 0.1;
+      const Eigen::Quaterniond q =
+          Eigen::Quaterniond::Identity().slerp(s, rotation);
+      const Eigen::Vector3d point =
+          q * Eigen::Vector3d(p[0], p[1], p[2]) + s * translation;
+      out[i * kStride] = point.x();
+      out[i * kStride + 1] = point.y();
+      out[i * kStride + 2] = point.z();
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReferenceDeskew)->Arg(28800)->Arg(120000);
+
+void BM_DeskewPointsAoS(benchmark::State& state) {
+  const std::vector<float> in = TimedPoints(state.range(0));
+  std::vector<float> out(in.size());
+  constexpr int kNumSegments = 16;
+  std::vector<AffineTransform3f> table(kNumSegments + 1, kTransform);
+  for (auto _ : state) {
+    DeskewPointsAoS(table.data(), kNumSegments, 4, 10.f, in.data(), kStride,
+                    state.range(0), out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DeskewPointsAoS)->Arg(28800)->Arg(120000);
+
+// 原始的近点判断
+void BM_ReferenceRangeMask(benchmark::State& state) {
+  const Points points(state.range(0));
+  std::unique_ptr<bool[]> keep(new bool[state.range(0)]);
+  for (auto _ : state) {
+    for (int i = 0; i < state.range(0); ++i) {
+      const float* p = points.aos.data() + i * kStride;
+      keep[i] = Eigen::Map<const Eigen::Vector3f>(p).norm() >= 0.3f;
+    }
+    benchmark::DoNotOptimize(keep.get());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReferenceRangeMask)->Arg(28800)->Arg(120000);
+
+void BM_ComputeRangeMaskAoS(benchmark::State& state) {
+  const Points points(state.range(0));
+  std::unique_ptr<bool[]> keep(new bool[state.range(0)]);
+  for (auto _ : state) {
+    ComputeRangeMaskAoS(points.aos.data(), kStride, state.range(0),
+                        0.3f * 0.3f, std::numeric_limits<float>::max(),
+                        keep.get());
+    benchmark::DoNotOptimize(keep.get());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ComputeRangeMaskAoS)->Arg(28800)->Arg(120000);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -103,6 +103,17 @@ inline typename Rigid3<FloatType>::Vector_ operator*(
   return rigid.rotation() * point + rigid.translation();
 }
 
+// Scales the motion 'rigid' at constant velocity: the rotation angle and the
+// translation are multiplied by 'ratio'.
+template <typename FloatType>
+Rigid3<FloatType> ScaleMotion(const Rigid3<FloatType>& rigid,
+                              const FloatType ratio) {
+  Eigen::AngleAxis<FloatType> rotation(rigid.rotation());
+  rotation.angle() *= ratio;
+  return Rigid3<FloatType>(ratio * rigid.translation(),
+                           typename Rigid3<FloatType>::Quaternion_(rotation));
+}
+
 // This is needed for gmock.
 template <typename T>
 std::ostream& operator<<(std::ostream& os, const Rigid3<T>& rigid) {
@@ -114,6 +125,7 @@ using Rigid3d = Rigid3<double>;
 using Rigid3f = Rigid3<float>;
 
 #include "common/common.h"
+#include "common/point_kernels.h"
 
 inline PointType operator*(const Rigid3d& transform, const PointType& point) {
   PointType point_out;
@@ -123,4 +135,14 @@ inline PointType operator*(const Rigid3d& transform, const PointType& point) {
   return point_out;
 }
 
+inline AffineTransform3f ToAffineTransform3f(const Rigid3d& transform) {
+  const Eigen::Matrix3d rotation = transform.rotation().toRotationMatrix();
+  AffineTransform3f transform_out;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) transform_out.r[3 * i + j] = rotation(i, j);
+    transform_out.t[i] = transform.translation()[i];
+  }
+  return transform_out;
+}
+
 #endif  // LOAM_VELODYNE_RIGID_TRANSFORM_H
@@ -0,0 +1,69 @@
+#include "common/ring_search_index.h"
+
+#include <glog/logging.h>
+
+#include "common/point_cloud_pool.h"
+
+void RingSearchIndex::setInputCloud(const PointCloudConstPtr& cloud) {
+  CHECK(cloud != nullptr);
+  point_rings_.resize(cloud->size());
+  std::vector<PointCloudPtr> ring_clouds;
+  rings_.clear();
+  for (size_t i = 0; i < cloud->size(); ++i) {
+    const PointType& point = cloud->points[i];
+    const int ring = static_cast<int>(point.intensity);
+    CHECK_GE(ring, 0) << "Point without ring id in intensity.";
+    point_rings_[i] = ring;
+    if (ring >= static_cast<int>(rings_.size())) {
+      rings_.resize(ring + 1);
+      ring_clouds.resize(ring + 1);
+    }
+    if (!rings_[ring]) {
+      rings_[ring].reset(new Ring);
+      ring_clouds[ring] = AcquirePointCloud();
+    }
+    rings_[ring]->indices.push_back(i);
+    ring_clouds[ring]->push_back(point);
+  }
+
+  if (!cloud->empty()) kdtree_.setInputCloud(cloud);
+  for (size_t ring = 0; ring < rings_.size(); ++ring) {
+    if (rings_[ring]) rings_[ring]->kdtree.setInputCloud(ring_clouds[ring]);
+  }
+}
+
+int RingSearchIndex::Nearest(const PointType& point,
+                             float* const squared_distance) const {
+  if (point_rings_.empty()) return -1;
+  std::vector<int> indices(1);
+  std::vector<float> squared_distances(1);
+  kdtree_.nearestKSearch(point, 1, indices, squared_distances);
+  *squared_distance = squared_distances[0];
+  return indices[0];
+}
+
+void RingSearchIndex::SearchRing(const PointType& point, const int ring,
+                                 const int excluded_index,
+                                 int* const nearest_index,
+                                 float* const nearest_squared_distance) const {
+  if (ring < 0 || ring >= static_cast<int>(rings_.size()) || !rings_[ring]) {
+    return;
+  }
+  const Ring& r = *rings_[ring];
+  // The excluded point is on the ring at most once, looking at the second
+  // nearest point is enough to skip it.
+  const int k = excluded_index >= 0 ? 2 : 1;
+  std::vector<int> indices(k);
+  std::vector<float> squared_distances(k);
+  const int num_found =
+      r.kdtree.nearestKSearch(point, k, indices, squared_distances);
+  for (int i = 0; i < num_found; ++i) {
+    const int index = r.indices[indices[i]];
+    if (index == excluded_index) continue;
+    if (squared_distances[i] < *nearest_squared_distance) {
+      *nearest_squared_distance = squared_distances[i];
+      *nearest_index = index;
+    }
+    return;
+  }
+}
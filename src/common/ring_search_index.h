@@ -0,0 +1,49 @@
+#ifndef MSF_LOAM_VELODYNE_RING_SEARCH_INDEX_H
+#define MSF_LOAM_VELODYNE_RING_SEARCH_INDEX_H
+
+#include <pcl/kdtree/kdtree_flann.h>
+#include <memory>
+#include <vector>
+
+#include "common/common.h"
+
+/**
+ * @brief 按扫描线划分的特征点搜索索引
+ *
+ * A kd-tree over the whole cloud plus one kd-tree per ring, the ring of a
+ * point being the integer part of its intensity. Finding the nearest point
+ * on a given ring is a tree lookup instead of walking the cloud, which only
+ * works when the cloud is sorted by ring and costs O(points per ring).
+ *
+ * Satisfies the requirements of LazySearchIndex. All searches are const and
+ * may run concurrently once setInputCloud() has returned.
+ */
+class RingSearchIndex {
+ public:
+  void setInputCloud(const PointCloudConstPtr& cloud);
+
+  // Returns the index of the nearest point in the whole cloud, or -1 for an
+  // empty cloud.
+  int Nearest(const PointType& point, float* squared_distance) const;
+
+  // Updates 'nearest_index' and 'nearest_squared_distance' if a point on
+  // 'ring' other than 'excluded_index' is strictly closer than
+  // '*nearest_squared_distance'. Rings without points are ignored.
+  void SearchRing(const PointType& point, int ring, int excluded_index,
+                  int* nearest_index, float* nearest_squared_distance) const;
+
+  int ring(const int index) const { return point_rings_[index]; }
+
+ private:
+  struct Ring {
+    pcl::KdTreeFLANN<PointType> kdtree;
+    // Indices of the ring's points in the whole cloud.
+    std::vector<int> indices;
+  };
+
+  pcl::KdTreeFLANN<PointType> kdtree_;
+  std::vector<int> point_rings_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_RING_SEARCH_INDEX_H
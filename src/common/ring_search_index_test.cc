@@ -0,0 +1,191 @@
+#include "common/ring_search_index.h"
+
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+
+constexpr float kDistanceSqThreshold = 25.f;
+constexpr int kNearByScan = 2;
+constexpr int kNumRings = 16;
+
+float SquaredDistance(const PointType& a, const PointType& b) {
+  return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) +
+         (a.z - b.z) * (a.z - b.z);
+}
+
+int Ring(const PointCloud& cloud, const int index) {
+  return static_cast<int>(cloud.points[index].intensity);
+}
+
+// The linear searches of the odometry before RingSearchIndex, which walk the
+// cloud sorted by ring from the closest point.
+int LinearCornerSearch(const PointCloud& cloud, const PointType& point,
+                       const int closest) {
+  const int closest_ring = Ring(cloud, closest);
+  int nearest = -1;
+  float min_squared_distance = kDistanceSqThreshold;
+  for (int j = closest + 1; j < static_cast<int>(cloud.size()); ++j) {
+    if (Ring(cloud, j) <= closest_ring) continue;
+    if (Ring(cloud, j) > closest_ring + kNearByScan) break;
+    const float squared_distance = SquaredDistance(cloud.points[j], point);
+    if (squared_distance < min_squared_distance) {
+      min_squared_distance = squared_distance;
+      nearest = j;
+    }
+  }
+  for (int j = closest - 1; j >= 0; --j) {
+    if (Ring(cloud, j) >= closest_ring) continue;
+    if (Ring(cloud, j) < closest_ring - kNearByScan) break;
+    const float squared_distance = SquaredDistance(cloud.points[j], point);
+    if (squared_distance < min_squared_distance) {
+      min_squared_distance = squared_distance;
+      nearest = j;
+    }
+  }
+  return nearest;
+}
+
+// Nearest point on the closest point's ring and on the nearby rings.
+void LinearSurfSearch(const PointCloud& cloud, const PointType& point,
+                      const int closest, int* const nearest_same_ring,
+                      int* const nearest_other_ring) {
+  const int closest_ring = Ring(cloud, closest);
+  float min_squared_distance2 = kDistanceSqThreshold;
+  float min_squared_distance3 = kDistanceSqThreshold;
+  *nearest_same_ring = -1;
+  *nearest_other_ring = -1;
+  for (int j = closest + 1; j < static_cast<int>(cloud.size()); ++j) {
+    if (Ring(cloud, j) > closest_ring + kNearByScan) break;
+    const float squared_distance = SquaredDistance(cloud.points[j], point);
+    if (Ring(cloud, j) <= closest_ring &&
+        squared_distance < min_squared_distance2) {
+      min_squared_distance2 = squared_distance;
+      *nearest_same_ring = j;
+    } else if (Ring(cloud, j) > closest_ring &&
+               squared_distance < min_squared_distance3) {
+      min_squared_distance3 = squared_distance;
+      *nearest_other_ring = j;
+    }
+  }
+  for (int j = closest - 1; j >= 0; --j) {
+    if (Ring(cloud, j) < closest_ring - kNearByScan) break;
+    const float squared_distance = SquaredDistance(cloud.points[j], point);
+    if (Ring(cloud, j) >= closest_ring &&
+        squared_distance < min_squared_distance2) {
+      min_squared_distance2 = squared_distance;
+      *nearest_same_ring = j;
+    } else if (Ring(cloud, j) < closest_ring &&
+               squared_distance < min_squared_distance3) {
+      min_squared_distance3 = squared_distance;
+      *nearest_other_ring = j;
+    }
+  }
+}
+
+// Points on 'kNumRings' cones like a scan, sorted by ring, the intensity
+// being ring + time.
+PointCloudPtr MakeRingSortedCloud(std::mt19937* const rng) {
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  PointCloudPtr cloud(new PointCloud);
+  for (int ring = 0; ring < kNumRings; ++ring) {
+    const float elevation = (-15.f + 2.f * ring) * float(M_PI) / 180.f;
+    for (int i = 0; i < 200; ++i) {
+      const float azimuth = 2.f * float(M_PI) * unit(*rng);
+      const float range = 5.f + 10.f * unit(*rng);
+      PointType point;
+      point.x = range * std::cos(elevation) * std::cos(azimuth);
+      point.y = range * std::cos(elevation) * std::sin(azimuth);
+      point.z = range * std::sin(elevation);
+      point.intensity = ring + 0.1f * unit(*rng);
+      cloud->push_back(point);
+    }
+  }
+  return cloud;
+}
+
+TEST(RingSearchIndexTest, MatchesLinearSearch) {
+  std::mt19937 rng(7);
+  std::normal_distribution<float> noise(0.f, 0.5f);
+  std::uniform_int_distribution<int> pick(0, kNumRings * 200 - 1);
+  int num_compared = 0;
+  for (int c = 0; c < 10; ++c) {
+    const PointCloudPtr cloud = MakeRingSortedCloud(&rng);
+    RingSearchIndex index;
+    index.setInputCloud(cloud);
+    for (int q = 0; q < 1000; ++q) {
+      PointType query = cloud->points[pick(rng)];
+      query.x += noise(rng);
+      query.y += noise(rng);
+      query.z += noise(rng);
+
+      float squared_distance;
+      const int closest = index.Nearest(query, &squared_distance);
+      ASSERT_GE(closest, 0);
+      for (size_t j = 0; j < cloud->size(); ++j) {
+        ASSERT_LE(squared_distance, SquaredDistance(cloud->points[j], query));
+      }
+      EXPECT_EQ(Ring(*cloud, closest), index.ring(closest));
+      if (squared_distance >= kDistanceSqThreshold) continue;
+      const int closest_ring = index.ring(closest);
+
+      int corner = -1;
+      float corner_squared_distance = kDistanceSqThreshold;
+      for (int ring = closest_ring - kNearByScan;
+           ring <= closest_ring + kNearByScan; ++ring) {
+        if (ring == closest_ring) continue;
+        index.SearchRing(query, ring, -1, &corner, &corner_squared_distance);
+      }
+      EXPECT_EQ(LinearCornerSearch(*cloud, query, closest), corner);
+
+      int same_ring = -1;
+      float same_ring_squared_distance = kDistanceSqThreshold;
+      index.SearchRing(query, closest_ring, closest, &same_ring,
+                       &same_ring_squared_distance);
+      int other_ring = -1;
+      float other_ring_squared_distance = kDistanceSqThreshold;
+      for (int ring = closest_ring - kNearByScan;
+           ring <= closest_ring + kNearByScan; ++ring) {
+        if (ring == closest_ring) continue;
+        index.SearchRing(query, ring, -1, &other_ring,
+                         &other_ring_squared_distance);
+      }
+      int expected_same_ring;
+      int expected_other_ring;
+      LinearSurfSearch(*cloud, query, closest, &expected_same_ring,
+                       &expected_other_ring);
+      EXPECT_EQ(expected_same_ring, same_ring);
+      EXPECT_EQ(expected_other_ring, other_ring);
+      ++num_compared;
+    }
+  }
+  EXPECT_GT(num_compared, 9000);
+}
+
+TEST(RingSearchIndexTest, IgnoresMissingRings) {
+  PointCloudPtr cloud(new PointCloud);
+  PointType point;
+  point.x = 1.f;
+  point.y = 0.f;
+  point.z = 0.f;
+  point.intensity = 2.f;
+  cloud->push_back(point);
+  RingSearchIndex index;
+  index.setInputCloud(cloud);
+  int nearest = -1;
+  float squared_distance = kDistanceSqThreshold;
+  index.SearchRing(point, 1, -1, &nearest, &squared_distance);
+  index.SearchRing(point, 3, -1, &nearest, &squared_distance);
+  index.SearchRing(point, 2, 0, &nearest, &squared_distance);
+  EXPECT_EQ(-1, nearest);
+  index.SearchRing(point, 2, -1, &nearest, &squared_distance);
+  EXPECT_EQ(0, nearest);
+  EXPECT_EQ(2, index.ring(0));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
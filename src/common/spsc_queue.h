@@ -0,0 +1,73 @@
+#ifndef MSF_LOAM_VELODYNE_SPSC_QUEUE_H
+#define MSF_LOAM_VELODYNE_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// A bounded, lock-free queue for exactly one producer thread and exactly one
+// consumer thread. The capacity is rounded up to the next power of two.
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(size_t capacity)
+      : mask_(RoundUpToPowerOfTwo(capacity) - 1),
+        slots_(mask_ + 1),
+        head_(0),
+        tail_(0) {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // Producer side. Returns false and leaves 'value' untouched if the queue is
+  // full.
+  bool TryPush(T&& value) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) return false;
+    slots_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if the queue is empty.
+  bool TryPop(T* value) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    // Move out and reset the slot so that it does not keep shared resources
+    // alive until it is overwritten.
+    *value = std::move(slots_[head & mask_]);
+    slots_[head & mask_] = T();
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate when called concurrently with TryPush() or TryPop().
+  size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  static size_t RoundUpToPowerOfTwo(size_t n) {
+    size_t power = 1;
+    while (power < n) power <<= 1;
+    return power;
+  }
+
+  const size_t mask_;
+  std::vector<T> slots_;
+  // 'head_' is written by the consumer and 'tail_' by the producer only. They
+  // are kept on separate cache lines to avoid false sharing.
+  char padding0_[64];
+  std::atomic<size_t> head_;
+  char padding1_[64];
+  std::atomic<size_t> tail_;
+  char padding2_[64];
+};
+
+#endif  // MSF_LOAM_VELODYNE_SPSC_QUEUE_H
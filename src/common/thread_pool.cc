@@ -0,0 +1,72 @@
+#include "common/thread_pool.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(const int num_threads) : running_(true) {
+  CHECK_GT(num_threads, 0);
+  for (int i = 0; i != num_threads; ++i) {
+    pool_.emplace_back([this] { this->DoWork(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> ul(mutex_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  for (std::thread& thread : pool_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Schedule(std::function<void()> work) {
+  {
+    std::unique_lock<std::mutex> ul(mutex_);
+    CHECK(running_);
+    work_queue_.push_back(std::move(work));
+  }
+  cv_.notify_one();
+}
+
+void ThreadPool::ParallelFor(const int begin, const int end,
+                             const std::function<void(int)>& func) {
+  if (end <= begin) return;
+  std::atomic<int> next(begin);
+  const auto run = [&next, end, &func] {
+    for (int i = next++; i < end; i = next++) func(i);
+  };
+
+  // The calling thread takes part, so at most 'end - begin - 1' helpers are
+  // useful.
+  const int num_helpers = std::min(num_threads(), end - begin - 1);
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  int num_running = num_helpers;
+  for (int i = 0; i < num_helpers; ++i) {
+    Schedule([&run, &done_mutex, &done_cv, &num_running] {
+      run();
+      std::unique_lock<std::mutex> ul(done_mutex);
+      if (--num_running == 0) done_cv.notify_one();
+    });
+  }
+  run();
+  std::unique_lock<std::mutex> ul(done_mutex);
+  done_cv.wait(ul, [&num_running] { return num_running == 0; });
+}
+
+void ThreadPool::DoWork() {
+  for (;;) {
+    std::function<void()> work;
+    {
+      std::unique_lock<std::mutex> ul(mutex_);
+      cv_.wait(ul, [this] { return !running_ || !work_queue_.empty(); });
+      if (work_queue_.empty()) return;
+      work = std::move(work_queue_.front());
+      work_queue_.pop_front();
+    }
+    work();
+  }
+}
@@ -0,0 +1,41 @@
+#ifndef MSF_LOAM_VELODYNE_THREAD_POOL_H
+#define MSF_LOAM_VELODYNE_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed number of worker threads executing scheduled work in FIFO order.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+
+  // Waits for all scheduled work to finish.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void Schedule(std::function<void()> work);
+
+  // Calls 'func(i)' for every i in [begin, end) on the workers and the calling
+  // thread, and returns once all calls have finished. Must not be called from
+  // a worker of the same pool.
+  void ParallelFor(int begin, int end, const std::function<void(int)>& func);
+
+  int num_threads() const { return static_cast<int>(pool_.size()); }
+
+ private:
+  void DoWork();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_;
+  std::deque<std::function<void()>> work_queue_;
+  std::vector<std::thread> pool_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_THREAD_POOL_H
@@ -9,16 +9,19 @@
 #include <cstdlib>
 #include <ctime>
 
+#include "common/metrics.h"
+
+// Measures with the steady clock, which does not jump with the system time.
 class TicToc {
-  using TimePoint = std::chrono::time_point<std::chrono::system_clock>;
+  using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
 
  public:
   TicToc() { tic(); }
 
-  void tic() { start_ = std::chrono::system_clock::now(); }
+  void tic() { start_ = std::chrono::steady_clock::now(); }
 
   double toc() {
-    end_ = std::chrono::system_clock::now();
+    end_ = std::chrono::steady_clock::now();
     std::chrono::duration<double> elapsed_seconds = end_ - start_;
     return elapsed_seconds.count() * 1000;
   }
@@ -28,5 +31,18 @@ class TicToc {
   TimePoint end_;
 };
 
+// Records the time of a step in the histogram "<module>/<describe>" of the
+// MetricsRegistry, summarized periodically by the MetricsReporter. Without
+// metrics every step time is logged instead.
+#ifndef MSF_LOAM_NO_METRICS
+#define LOG_STEP_TIME(module, describe, msecs)                        \
+  do {                                                                \
+    const double step_msecs = (msecs);                                \
+    METRICS_RECORD(module "/" describe, step_msecs);                  \
+    VLOG(2) << "[" << module << "] " describe << ": " << step_msecs   \
+            << " ms";                                                 \
+  } while (0)
+#else
 #define LOG_STEP_TIME(module, describe, msecs) \
   LOG(INFO) << "[" << module << "] " describe << ": " << msecs << " ms"
+#endif
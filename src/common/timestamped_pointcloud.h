@@ -3,11 +3,17 @@
 
 #include <pcl/point_cloud.h>
 #include <Eigen/Eigen>
+#include <memory>
 
 #include "common/common.h"
+#include "common/lazy_search_index.h"
+#include "common/point_cloud_pool.h"
+#include "common/ring_search_index.h"
 #include "common/rigid_transform.h"
 #include "common/time_def.h"
 
+using FeatureSearchIndex = LazySearchIndex<RingSearchIndex>;
+
 struct TimestampedPointCloud {
   Time timestamp;
   std::string frame_id;
@@ -21,21 +27,28 @@ struct TimestampedPointCloud {
   PointCloudPtr cloud_surf_flat;
   PointCloudPtr cloud_surf_less_flat;
 
+  // Optional search indices over 'cloud_corner_less_sharp' and
+  // 'cloud_surf_less_flat', shared by all copies of the scan.
+  std::shared_ptr<FeatureSearchIndex> corner_less_sharp_index;
+  std::shared_ptr<FeatureSearchIndex> surf_less_flat_index;
+
   TimestampedPointCloud()
       : imu_rotation(Quaternion<double>(1, 0, 0, 0)),
-        cloud_full_res(new PointCloud),
-        cloud_corner_sharp(new PointCloud),
-        cloud_corner_less_sharp(new PointCloud),
-        cloud_surf_flat(new PointCloud),
-        cloud_surf_less_flat(new PointCloud) {}
+        cloud_full_res(AcquirePointCloud()),
+        cloud_corner_sharp(AcquirePointCloud()),
+        cloud_corner_less_sharp(AcquirePointCloud()),
+        cloud_surf_flat(AcquirePointCloud()),
+        cloud_surf_less_flat(AcquirePointCloud()) {}
 };
 
 inline PointCloudPtr TransformPointCloud(const PointCloudConstPtr &cloud_in,
                                          const Rigid3d &pose) {
-  PointCloudPtr cloud_out(new PointCloud);
+  PointCloudPtr cloud_out = AcquirePointCloud(cloud_in->size());
   cloud_out->resize(cloud_in->size());
-  for (size_t i = 0; i < cloud_in->size(); ++i)
-    (*cloud_out)[i] = pose * (*cloud_in)[i];
+  if (cloud_in->empty()) return cloud_out;
+  TransformPointsAoS(ToAffineTransform3f(pose), cloud_in->points[0].data,
+                     sizeof(PointType) / sizeof(float), cloud_in->size(),
+                     cloud_out->points[0].data);
   return cloud_out;
 }
 
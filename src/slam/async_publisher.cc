@@ -0,0 +1,89 @@
+#include "slam/async_publisher.h"
+
+#include <glog/logging.h>
+#include <boost/make_shared.hpp>
+#include <pcl_conversions/pcl_conversions.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include "common/metrics.h"
+
+AsyncPublisher::AsyncPublisher(const size_t max_queued)
+    : max_queued_(max_queued),
+      num_queued_(0),
+      num_dropped_(0),
+      output_thread_(1) {}
+
+void AsyncPublisher::PublishCloud(const ros::Publisher& publisher,
+                                  const PointCloudConstPtr& cloud,
+                                  const ros::Time& stamp,
+                                  const std::string& frame_id) {
+  if (!HasSubscribers(publisher)) return;
+  Schedule([publisher, cloud, stamp, frame_id] {
+    boost::shared_ptr<sensor_msgs::PointCloud2> message(
+        new sensor_msgs::PointCloud2);
+    pcl::toROSMsg(*cloud, *message);
+    message->header.stamp = stamp;
+    message->header.frame_id = frame_id;
+    publisher.publish(boost::shared_ptr<const sensor_msgs::PointCloud2>(
+        std::move(message)));
+  });
+}
+
+void AsyncPublisher::Schedule(std::function<void()> work) {
+  if (num_queued_.fetch_add(1) >= max_queued_) {
+    --num_queued_;
+    ++num_dropped_;
+    METRICS_COUNT("OUT/dropped messages", 1);
+    LOG_EVERY_N(WARNING, 100) << "Output thread is behind, dropped "
+                              << num_dropped_.load() << " messages";
+    return;
+  }
+  output_thread_.Schedule([this, work] {
+    work();
+    --num_queued_;
+  });
+}
+
+PathPublisher::PathPublisher(const ros::Publisher& publisher,
+                             const std::string& frame_id,
+                             AsyncPublisher* const async_publisher,
+                             const double min_distance, const int publish_every)
+    : publisher_(publisher),
+      async_publisher_(async_publisher),
+      min_distance_(min_distance),
+      publish_every_(publish_every) {
+  CHECK_GT(publish_every_, 0);
+  path_.header.frame_id = frame_id;
+}
+
+void PathPublisher::AddPose(const ros::Time& stamp,
+                            const geometry_msgs::Pose& pose) {
+  geometry_msgs::PoseStamped pose_stamped;
+  pose_stamped.header.stamp = stamp;
+  pose_stamped.header.frame_id = path_.header.frame_id;
+  pose_stamped.pose = pose;
+  path_.header.stamp = stamp;
+
+  // 最后一个位姿总是当前位姿，离上一个保留的位姿太近时直接替换
+  bool replace_last = false;
+  const size_t size = path_.poses.size();
+  if (size >= 2) {
+    const geometry_msgs::Point& kept = path_.poses[size - 2].pose.position;
+    const double dx = pose.position.x - kept.x;
+    const double dy = pose.position.y - kept.y;
+    const double dz = pose.position.z - kept.z;
+    replace_last = dx * dx + dy * dy + dz * dz < min_distance_ * min_distance_;
+  }
+  if (replace_last) {
+    path_.poses.back() = pose_stamped;
+  } else {
+    path_.poses.push_back(pose_stamped);
+  }
+
+  if (num_poses_++ % publish_every_ == 0 &&
+      AsyncPublisher::HasSubscribers(publisher_)) {
+    const boost::shared_ptr<const nav_msgs::Path> message =
+        boost::make_shared<nav_msgs::Path>(path_);
+    async_publisher_->Publish(publisher_, message);
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef MSF_LOAM_VELODYNE_ASYNC_PUBLISHER_H
+#define MSF_LOAM_VELODYNE_ASYNC_PUBLISHER_H
+
+#include <nav_msgs/Path.h>
+#include <ros/node_handle.h>
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include "common/common.h"
+#include "common/thread_pool.h"
+
+/**
+ * @brief 在独立的输出线程上发布 ROS 消息
+ *
+ * Messages are handed over as shared pointers and serialized and published on
+ * a dedicated output thread, so publishing does not block the processing
+ * threads. Nothing is converted or queued for topics without subscribers.
+ * If more than 'max_queued' messages are waiting, new ones are dropped.
+ */
+class AsyncPublisher {
+ public:
+  explicit AsyncPublisher(size_t max_queued = 64);
+
+  // Publishes the remaining queued messages.
+  ~AsyncPublisher() = default;
+
+  AsyncPublisher(const AsyncPublisher&) = delete;
+  AsyncPublisher& operator=(const AsyncPublisher&) = delete;
+
+  // Cheap check to skip building expensive messages nobody receives.
+  static bool HasSubscribers(const ros::Publisher& publisher) {
+    return publisher.getNumSubscribers() > 0;
+  }
+
+  // Converts 'cloud' to a PointCloud2 message on the output thread and
+  // publishes it. 'cloud' must not be modified afterwards.
+  void PublishCloud(const ros::Publisher& publisher,
+                    const PointCloudConstPtr& cloud, const ros::Time& stamp,
+                    const std::string& frame_id);
+
+  template <typename Message>
+  void Publish(const ros::Publisher& publisher,
+               const boost::shared_ptr<const Message>& message) {
+    if (!HasSubscribers(publisher)) return;
+    Schedule([publisher, message] { publisher.publish(message); });
+  }
+
+  size_t num_dropped() const { return num_dropped_.load(); }
+
+ private:
+  void Schedule(std::function<void()> work);
+
+  const size_t max_queued_;
+  std::atomic<size_t> num_queued_;
+  std::atomic<size_t> num_dropped_;
+  // Destroyed first, publishing the remaining messages.
+  ThreadPool output_thread_;
+};
+
+/**
+ * @brief 增量发布的轨迹
+ *
+ * A nav_msgs::Path growing by one pose per frame. Republishing the whole path
+ * every frame is quadratic over a run, so poses closer than 'min_distance' to
+ * the previous kept pose only replace the last pose, and the path is
+ * published every 'publish_every' poses and only if subscribed.
+ */
+class PathPublisher {
+ public:
+  PathPublisher(const ros::Publisher& publisher, const std::string& frame_id,
+                AsyncPublisher* async_publisher, double min_distance = 1.,
+                int publish_every = 10);
+
+  void AddPose(const ros::Time& stamp, const geometry_msgs::Pose& pose);
+
+ private:
+  const ros::Publisher publisher_;
+  AsyncPublisher* const async_publisher_;
+  const double min_distance_;
+  const int publish_every_;
+  int num_poses_ = 0;
+  nav_msgs::Path path_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_ASYNC_PUBLISHER_H
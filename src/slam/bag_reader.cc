@@ -0,0 +1,50 @@
+#include "slam/bag_reader.h"
+
+#include <glog/logging.h>
+#include <rosbag/view.h>
+
+#include "common/pipeline_stage.h"
+
+BagReader::BagReader(const std::string& bag_filename,
+                     const BagReaderOptions& options)
+    : options_(options), queue_(options.num_prefetch) {
+  CHECK_GT(options_.num_prefetch, 0);
+  bag_.open(bag_filename);
+  LOG(INFO) << "Reading bag file " << bag_filename << " ...";
+  reader_thread_ = std::thread([this] { Read(); });
+}
+
+BagReader::~BagReader() {
+  queue_.Close();
+  reader_thread_.join();
+  bag_.close();
+}
+
+void BagReader::Read() {
+  SetCurrentThreadAffinity("BAG", -1);
+  rosbag::View view;
+  if (options_.topics.empty()) {
+    view.addQuery(bag_);
+  } else {
+    view.addQuery(bag_, rosbag::TopicQuery(options_.topics));
+  }
+  for (const rosbag::MessageInstance& m : view) {
+    BagMessage message;
+    if (m.isType<sensor_msgs::PointCloud2>()) {
+      message.laser_cloud = m.instantiate<sensor_msgs::PointCloud2>();
+    } else if (m.isType<sensor_msgs::Imu>()) {
+      message.imu = m.instantiate<sensor_msgs::Imu>();
+    } else if (m.isType<nav_msgs::Odometry>()) {
+      message.odom = m.instantiate<nav_msgs::Odometry>();
+    } else {
+      continue;
+    }
+    // Fails once the reader is destroyed.
+    if (!queue_.Push(std::move(message))) return;
+  }
+  queue_.Close();
+}
+
+bool BagReader::Next(BagMessage* const message) {
+  return queue_.Pop(message);
+}
@@ -0,0 +1,62 @@
+#ifndef MSF_LOAM_VELODYNE_BAG_READER_H
+#define MSF_LOAM_VELODYNE_BAG_READER_H
+
+#include <nav_msgs/Odometry.h>
+#include <rosbag/bag.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/blocking_queue.h"
+
+struct BagReaderOptions {
+  // Only messages on these topics are read, all topics if empty. The
+  // defaults are the topics msf_loam_node subscribes to.
+  std::vector<std::string> topics = {"/velodyne_points", "/imu",
+                                     "/odometry_gt"};
+  // Messages deserialized ahead of the consumer.
+  size_t num_prefetch = 256;
+};
+
+// A message of the bag, exactly one of the pointers is set.
+struct BagMessage {
+  sensor_msgs::PointCloud2ConstPtr laser_cloud;
+  sensor_msgs::ImuConstPtr imu;
+  nav_msgs::OdometryConstPtr odom;
+};
+
+/**
+ * @brief 后台读取 bag 文件
+ *
+ * A reader thread decompresses and deserializes the point cloud, imu and
+ * odometry messages of the topics in bag order, at most 'num_prefetch'
+ * messages ahead of Next(). Messages of other types are skipped without
+ * being deserialized.
+ */
+class BagReader {
+ public:
+  BagReader(const std::string& bag_filename, const BagReaderOptions& options);
+
+  // Stops the reader thread.
+  ~BagReader();
+
+  BagReader(const BagReader&) = delete;
+  BagReader& operator=(const BagReader&) = delete;
+
+  // Returns false after the last message.
+  bool Next(BagMessage* message);
+
+ private:
+  void Read();
+
+  const BagReaderOptions options_;
+  // Only used by the reader thread after construction.
+  rosbag::Bag bag_;
+  // Closed after the last message or on destruction.
+  BlockingQueue<BagMessage> queue_;
+  std::thread reader_thread_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_BAG_READER_H
@@ -0,0 +1,269 @@
+#include <benchmark/benchmark.h>
+#include <Eigen/Geometry>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "common/timestamped_pointcloud.h"
+#include "slam/feature_extraction/feature_extractor.h"
+#include "slam/hybrid_grid.h"
+#include "slam/local/scan_matching/mapping_scan_matcher.h"
+#include "slam/local/scan_matching/odometry_scan_matcher.h"
+
+/**
+ * @brief Benchmarks of the SLAM components on fixed scans
+ *
+ * The scans are simulated deterministically: a VLP-16 driving along a street
+ * of box-shaped buildings, poles and parked cars, 1 m and 0.5 degrees per
+ * scan. The map of the mapping benchmarks holds the features of the ten
+ * scans before the matched one at their true poses.
+ */
+
+namespace {
+
+constexpr int kNumRings = 16;
+constexpr int kPointsPerRing = 1800;
+constexpr double kScanPeriod = 0.1;
+constexpr int kNumMapScans = 10;
+
+struct Box {
+  Eigen::Vector3d min;
+  Eigen::Vector3d max;
+};
+
+std::vector<Box> MakeStreet() {
+  std::vector<Box> boxes;
+  boxes.push_back({{-1000., -1000., -2.}, {1000., 1000., -1.8}});  // ground
+  for (int k = -10; k <= 10; ++k) {
+    const double x = 10. * k;
+    // 两侧进深不同的建筑
+    boxes.push_back({{x, 7. + 0.8 * (k & 3), -1.8}, {x + 8., 20., 10.}});
+    boxes.push_back({{x + 2., -20., -1.8}, {x + 9., -7. - 0.6 * (k & 1), 8.}});
+    // 路灯杆
+    boxes.push_back({{x + 9., 5.3, -1.8}, {x + 9.3, 5.6, 3.}});
+    boxes.push_back({{x + 4., -5.6, -1.8}, {x + 4.3, -5.3, 3.}});
+    // 停放的车辆
+    if (k % 2 == 0) {
+      boxes.push_back({{x + 1., 3.2, -1.8}, {x + 5.5, 5., -0.4}});
+    }
+  }
+  return boxes;
+}
+
+// Distance along the ray to the entry into 'box', infinity if missed.
+double IntersectRay(const Eigen::Vector3d& origin,
+                    const Eigen::Vector3d& direction, const Box& box) {
+  double t_min = 0.;
+  double t_max = std::numeric_limits<double>::infinity();
+  for (int d = 0; d < 3; ++d) {
+    const double inverse = 1. / direction[d];
+    double t0 = (box.min[d] - origin[d]) * inverse;
+    double t1 = (box.max[d] - origin[d]) * inverse;
+    if (t0 > t1) std::swap(t0, t1);
+    t_min = std::max(t_min, t0);
+    t_max = std::min(t_max, t1);
+    if (t_min > t_max) return std::numeric_limits<double>::infinity();
+  }
+  return t_min;
+}
+
+Rigid3d TruePose(const int index) {
+  return Rigid3d(Eigen::Vector3d(1. * index, 0.1 * index, 0.),
+                 Eigen::Quaterniond(Eigen::AngleAxisd(
+                     0.5 * M_PI / 180. * index, Eigen::Vector3d::UnitZ())));
+}
+
+// Simulates the scan at 'pose' as PointCloudIngest outputs it: one cloud per
+// ring, the intensity is the ring plus the relative time of the point.
+std::vector<PointCloud> SimulateScan(const std::vector<Box>& street,
+                                     const Rigid3d& pose, const int seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0., 0.01);
+  std::vector<PointCloud> rings(kNumRings);
+  for (int ring = 0; ring < kNumRings; ++ring) {
+    const double elevation = (-15. + 2. * ring) * M_PI / 180.;
+    for (int i = 0; i < kPointsPerRing; ++i) {
+      const double azimuth = 2. * M_PI * i / kPointsPerRing;
+      const Eigen::Vector3d direction(std::cos(elevation) * std::cos(azimuth),
+                                      std::cos(elevation) * std::sin(azimuth),
+                                      std::sin(elevation));
+      const Eigen::Vector3d world_direction = pose.rotation() * direction;
+      double range = 80.;
+      for (const Box& box : street) {
+        range = std::min(
+            range, IntersectRay(pose.translation(), world_direction, box));
+      }
+      if (range >= 80. || range < 0.5) continue;
+      const Eigen::Vector3d point = direction * (range + noise(rng));
+      PointType p;
+      p.x = point.x();
+      p.y = point.y();
+      p.z = point.z();
+      p.intensity = ring + kScanPeriod * i / kPointsPerRing;
+      rings[ring].push_back(p);
+    }
+  }
+  return rings;
+}
+
+// 仿真的扫描及其特征，所有 benchmark 共用
+struct Fixture {
+  Fixture() : feature_extractor(FeatureExtractorOptions(), nullptr) {
+    const std::vector<Box> street = MakeStreet();
+    for (int i = 0; i <= kNumMapScans; ++i) {
+      rings.push_back(SimulateScan(street, TruePose(i), i));
+      TimestampedPointCloud scan;
+      feature_extractor.Extract(rings.back(), &scan);
+      scan.corner_less_sharp_index = std::make_shared<FeatureSearchIndex>(
+          scan.cloud_corner_less_sharp);
+      scan.surf_less_flat_index =
+          std::make_shared<FeatureSearchIndex>(scan.cloud_surf_less_flat);
+      scan.corner_less_sharp_index->Get();
+      scan.surf_less_flat_index->Get();
+      scans.push_back(scan);
+    }
+  }
+
+  static const Fixture& Get() {
+    static const Fixture* const fixture = new Fixture;
+    return *fixture;
+  }
+
+  // The map of the first 'kNumMapScans' scans.
+  std::unique_ptr<HybridGrid> BuildMap(const bool corner,
+                                       const HybridGridCellType cell_type)
+      const {
+    HybridGridOptions options;
+    options.leaf_size = corner ? 0.2f : 0.4f;
+    options.cell_type = cell_type;
+    std::unique_ptr<HybridGrid> map(new HybridGrid(options));
+    for (int i = 0; i < kNumMapScans; ++i) {
+      map->InsertScan(TransformPointCloud(
+          corner ? scans[i].cloud_corner_less_sharp
+                 : scans[i].cloud_surf_less_flat,
+          TruePose(i)));
+    }
+    return map;
+  }
+
+  FeatureExtractor feature_extractor;
+  std::vector<std::vector<PointCloud>> rings;
+  std::vector<TimestampedPointCloud> scans;
+};
+
+// 0 为点云栅格，1 为增量体素栅格，2 为压缩栅格
+HybridGridCellType CellType(const benchmark::State& state) {
+  switch (state.range(0)) {
+    case 0:
+      return HybridGridCellType::kPointCloud;
+    case 1:
+      return HybridGridCellType::kVoxelCentroid;
+  }
+  return HybridGridCellType::kQuantized;
+}
+
+ScanMatcherSolverType SolverType(const benchmark::State& state) {
+  return state.range(0) == 0 ? ScanMatcherSolverType::kCeres
+                             : ScanMatcherSolverType::kGaussNewton;
+}
+
+void BM_FeatureExtraction(benchmark::State& state) {
+  const Fixture& fixture = Fixture::Get();
+  FeatureExtractor feature_extractor(FeatureExtractorOptions(), nullptr);
+  for (auto _ : state) {
+    TimestampedPointCloud scan;
+    feature_extractor.Extract(fixture.rings[0], &scan);
+    benchmark::DoNotOptimize(scan.cloud_surf_less_flat->size());
+  }
+}
+BENCHMARK(BM_FeatureExtraction)->Unit(benchmark::kMillisecond);
+
+void BM_OdometryScanMatcher(benchmark::State& state) {
+  const Fixture& fixture = Fixture::Get();
+  OdometryScanMatcherOptions options;
+  options.solver_type = SolverType(state);
+  for (auto _ : state) {
+    Rigid3d pose_curr2last;
+    OdometryScanMatcher::Match(fixture.scans[0], fixture.scans[1],
+                               &pose_curr2last, options);
+    benchmark::DoNotOptimize(pose_curr2last.translation().data());
+  }
+}
+BENCHMARK(BM_OdometryScanMatcher)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_HybridGridInsertScan(benchmark::State& state) {
+  const Fixture& fixture = Fixture::Get();
+  for (auto _ : state) {
+    const std::unique_ptr<HybridGrid> map =
+        fixture.BuildMap(false, CellType(state));
+    benchmark::DoNotOptimize(map->num_points());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumMapScans);
+  const std::unique_ptr<HybridGrid> map =
+      fixture.BuildMap(false, CellType(state));
+  state.counters["bytes_per_point"] =
+      static_cast<double>(map->memory_usage()) / map->num_points();
+}
+BENCHMARK(BM_HybridGridInsertScan)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_HybridGridNearestKSearch(benchmark::State& state) {
+  const Fixture& fixture = Fixture::Get();
+  const std::unique_ptr<HybridGrid> map =
+      fixture.BuildMap(false, CellType(state));
+  const PointCloudPtr queries = TransformPointCloud(
+      fixture.scans[kNumMapScans].cloud_surf_less_flat,
+      TruePose(kNumMapScans));
+  std::vector<PointType> neighbors;
+  std::vector<float> squared_distances;
+  for (auto _ : state) {
+    int num_found = 0;
+    for (const PointType& query : *queries) {
+      num_found += map->NearestKSearch(query, 5, 1.f, &neighbors,
+                                       &squared_distances);
+    }
+    benchmark::DoNotOptimize(num_found);
+  }
+  state.SetItemsProcessed(state.iterations() * queries->size());
+}
+BENCHMARK(BM_HybridGridNearestKSearch)->Arg(0)->Arg(1)->Arg(2);
+
+void BM_MappingScanMatcher(benchmark::State& state) {
+  const Fixture& fixture = Fixture::Get();
+  const std::unique_ptr<HybridGrid> corner_map =
+      fixture.BuildMap(true, HybridGridCellType::kPointCloud);
+  const std::unique_ptr<HybridGrid> surf_map =
+      fixture.BuildMap(false, HybridGridCellType::kPointCloud);
+  // 初值偏离真值 10cm、0.5度
+  const Rigid3d initial_pose =
+      TruePose(kNumMapScans) *
+      Rigid3d(Eigen::Vector3d(0.1, 0., 0.),
+              Eigen::Quaterniond(Eigen::AngleAxisd(0.5 * M_PI / 180.,
+                                                   Eigen::Vector3d::UnitZ())));
+  MappingScanMatcherOptions options;
+  options.solver_type = SolverType(state);
+  MappingScanMatcher scan_matcher(options, nullptr);
+  for (auto _ : state) {
+    Rigid3d pose = initial_pose;
+    scan_matcher.Match(*corner_map, *surf_map, fixture.scans[kNumMapScans],
+                       &pose);
+    benchmark::DoNotOptimize(pose.translation().data());
+  }
+}
+BENCHMARK(BM_MappingScanMatcher)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,242 @@
+#include "slam/feature_extraction/feature_extractor.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "common/point_cloud_pool.h"
+#include "common/point_kernels.h"
+#include "common/tic_toc.h"
+
+namespace {
+
+enum PointLabel { P_UNKNOWN = 0, P_LESS_SHARP = 1, P_SHARP = 2, P_FLAT = -1 };
+
+constexpr float kLessFlatLeafSize = 0.2f;
+
+// 标记临近点
+void MarkNeighborsPicked(const PointCloud& ring, const int ind,
+                         std::vector<char>* neighbor_picked) {
+  (*neighbor_picked)[ind] = true;
+  for (int l = 1; l <= 5; l++) {
+    auto vec = ring.points[ind + l].getVector3fMap() -
+               ring.points[ind + l - 1].getVector3fMap();
+    if (vec.squaredNorm() > 0.05) break;
+    (*neighbor_picked)[ind + l] = true;
+  }
+  for (int l = -1; l >= -5; l--) {
+    auto vec = ring.points[ind + l].getVector3fMap() -
+               ring.points[ind + l + 1].getVector3fMap();
+    if (vec.squaredNorm() > 0.05) break;
+    (*neighbor_picked)[ind + l] = true;
+  }
+}
+
+// 标记被遮挡的点和与激光束接近平行的面上的点（LOAM）
+void MarkOccludedPoints(const PointCloud& ring, const int start_index,
+                        const int end_index,
+                        std::vector<char>* neighbor_picked) {
+  for (int i = start_index; i < end_index; ++i) {
+    const Eigen::Vector3f point = ring.points[i].getVector3fMap();
+    const Eigen::Vector3f next = ring.points[i + 1].getVector3fMap();
+    const float squared_diff = (next - point).squaredNorm();
+    if (squared_diff > 0.1f) {
+      // 距离跳变处较远一侧的点被较近的物体遮挡
+      const float depth = point.norm();
+      const float depth_next = next.norm();
+      if (depth > depth_next) {
+        if ((next - point * (depth_next / depth)).norm() / depth_next < 0.1f) {
+          for (int l = i - 5; l <= i; ++l) (*neighbor_picked)[l] = true;
+        }
+      } else if ((next * (depth / depth_next) - point).norm() / depth < 0.1f) {
+        for (int l = i + 1; l <= i + 6; ++l) (*neighbor_picked)[l] = true;
+      }
+    }
+
+    const Eigen::Vector3f previous = ring.points[i - 1].getVector3fMap();
+    const float squared_depth = point.squaredNorm();
+    if (squared_diff > 0.0002f * squared_depth &&
+        (point - previous).squaredNorm() > 0.0002f * squared_depth) {
+      (*neighbor_picked)[i] = true;
+    }
+  }
+}
+
+}  // namespace
+
+FeatureExtractor::FeatureExtractor(const FeatureExtractorOptions& options,
+                                   ThreadPool* const thread_pool)
+    : options_(options), thread_pool_(thread_pool) {}
+
+void FeatureExtractor::Extract(const std::vector<PointCloud>& rings,
+                               TimestampedPointCloud* const scan) {
+  TicToc t_pts;
+  while (scratches_.size() < rings.size()) {
+    scratches_.emplace_back(kLessFlatLeafSize);
+  }
+
+  const auto extract_ring = [this, &rings](const int i) {
+    ExtractRing(rings[i], &scratches_[i]);
+  };
+  if (thread_pool_ != nullptr) {
+    thread_pool_->ParallelFor(0, rings.size(), extract_ring);
+  } else {
+    for (size_t i = 0; i < rings.size(); ++i) extract_ring(i);
+  }
+
+  // 按扫描线顺序合并，先统计点数，从对象池取出足够大的点云，合并时不再扩容
+  size_t num_full_res = 0, num_corner_sharp = 0, num_corner_less_sharp = 0,
+         num_surf_flat = 0, num_surf_less_flat = 0;
+  for (size_t i = 0; i < rings.size(); ++i) {
+    const RingScratch& scratch = scratches_[i];
+    num_full_res += rings[i].size();
+    num_corner_sharp += scratch.corner_sharp.size();
+    num_corner_less_sharp += scratch.corner_less_sharp.size();
+    num_surf_flat += scratch.surf_flat.size();
+    num_surf_less_flat += scratch.surf_less_flat.size();
+  }
+  PointCloudPtr cloud_full_res = AcquirePointCloud(num_full_res);
+  // sharp 点
+  PointCloudPtr cloud_corner_sharp = AcquirePointCloud(num_corner_sharp);
+  // less sharp 点
+  PointCloudPtr cloud_corner_less_sharp =
+      AcquirePointCloud(num_corner_less_sharp);
+  // flat 点
+  PointCloudPtr cloud_surf_flat = AcquirePointCloud(num_surf_flat);
+  // less flat 点
+  PointCloudPtr cloud_surf_less_flat = AcquirePointCloud(num_surf_less_flat);
+  double t_selection = 0;
+  for (size_t i = 0; i < rings.size(); ++i) {
+    const RingScratch& scratch = scratches_[i];
+    *cloud_full_res += rings[i];
+    *cloud_corner_sharp += scratch.corner_sharp;
+    *cloud_corner_less_sharp += scratch.corner_less_sharp;
+    *cloud_surf_flat += scratch.surf_flat;
+    *cloud_surf_less_flat += scratch.surf_less_flat;
+    t_selection += scratch.selection_time;
+  }
+  scan->cloud_full_res = cloud_full_res;
+  scan->cloud_corner_sharp = cloud_corner_sharp;
+  scan->cloud_corner_less_sharp = cloud_corner_less_sharp;
+  scan->cloud_surf_flat = cloud_surf_flat;
+  scan->cloud_surf_less_flat = cloud_surf_less_flat;
+  // Summed over all threads
+  LOG_STEP_TIME("REG", "Feature selection", t_selection);
+  LOG_STEP_TIME("REG", "Seperate points", t_pts.toc());
+}
+
+void FeatureExtractor::ExtractRing(const PointCloud& ring,
+                                   RingScratch* const scratch) const {
+  scratch->corner_sharp.clear();
+  scratch->corner_less_sharp.clear();
+  scratch->surf_flat.clear();
+  scratch->surf_less_flat.clear();
+  scratch->selection_time = 0.;
+
+  const int cloud_size = ring.size();
+  // 扫描线首尾各5个点无法计算曲率
+  const int start_index = 5;
+  const int end_index = cloud_size - 6;
+  if (end_index - start_index < 6) return;
+
+  std::vector<float>& curvatures = scratch->curvatures;
+  std::vector<int>& sorted_indices = scratch->sorted_indices;
+  std::vector<char>& neighbor_picked = scratch->neighbor_picked;
+  std::vector<int>& labels = scratch->labels;
+  curvatures.resize(cloud_size);
+  sorted_indices.resize(cloud_size);
+  neighbor_picked.assign(cloud_size, false);
+  labels.assign(cloud_size, P_UNKNOWN);
+
+  /**
+   * @brief 计算所有点的曲率
+   *
+   * dx(i) = x[i-5]+x[i-4]+...+x[i+5]-10*x[i]
+   * ...
+   * curv(i) = dx(i)^2 + dy(i)^2 + dz(i)^2
+   */
+  scratch->x.resize(cloud_size);
+  scratch->y.resize(cloud_size);
+  scratch->z.resize(cloud_size);
+  for (int i = 0; i < cloud_size; i++) {
+    scratch->x[i] = ring.points[i].x;
+    scratch->y[i] = ring.points[i].y;
+    scratch->z[i] = ring.points[i].z;
+  }
+  ComputeCurvatures(scratch->x.data(), scratch->y.data(), scratch->z.data(),
+                    cloud_size, curvatures.data());
+  std::iota(sorted_indices.begin(), sorted_indices.end(), 0);
+  if (options_.mark_occluded_points) {
+    MarkOccludedPoints(ring, start_index, end_index, &neighbor_picked);
+  }
+
+  PointCloud& surf_less_flat_scan = scratch->surf_less_flat_scan;
+  surf_less_flat_scan.clear();
+  const auto less_curvature = [&curvatures](const int i, const int j) {
+    return curvatures[i] < curvatures[j];
+  };
+  const auto greater_curvature = [&curvatures](const int i, const int j) {
+    return curvatures[i] > curvatures[j];
+  };
+  // 将每条扫描线分成6片，对每片提取特征点
+  for (int j = 0; j < 6; j++) {
+    int sp = start_index + (end_index - start_index) * j / 6;
+    int ep = start_index + (end_index - start_index) * (j + 1) / 6 - 1;
+    // 只需要曲率最高和最低的少数点，用堆按曲率顺序依次取出，不做全排序
+    const auto heap_begin = sorted_indices.begin() + sp;
+    auto heap_end = sorted_indices.begin() + ep + 1;
+
+    // 取曲率最高的前2个点为sharp点，前20个为less_sharp点（每次选取时标记周围的十一个点）
+    TicToc t_tmp;
+    std::make_heap(heap_begin, heap_end, less_curvature);
+    int largest_picked_num = 0;
+    while (heap_begin != heap_end && largest_picked_num < 20) {
+      std::pop_heap(heap_begin, heap_end, less_curvature);
+      const int ind = *--heap_end;
+      if (curvatures[ind] <= 0.1) break;
+      if (neighbor_picked[ind]) continue;
+
+      largest_picked_num++;
+      if (largest_picked_num <= 2) {
+        labels[ind] = P_SHARP;
+        scratch->corner_sharp.push_back(ring.points[ind]);
+        scratch->corner_less_sharp.push_back(ring.points[ind]);
+      } else {
+        labels[ind] = P_LESS_SHARP;
+        scratch->corner_less_sharp.push_back(ring.points[ind]);
+      }
+
+      MarkNeighborsPicked(ring, ind, &neighbor_picked);
+    }
+
+    // 取曲率最低的前4个点为flat点（每次选取时标记周围的十一个点）
+    heap_end = sorted_indices.begin() + ep + 1;
+    std::make_heap(heap_begin, heap_end, greater_curvature);
+    int smallest_picked_num = 0;
+    while (heap_begin != heap_end) {
+      std::pop_heap(heap_begin, heap_end, greater_curvature);
+      const int ind = *--heap_end;
+      if (curvatures[ind] >= 0.1) break;
+      if (neighbor_picked[ind]) continue;
+
+      labels[ind] = P_FLAT;
+      scratch->surf_flat.push_back(ring.points[ind]);
+
+      smallest_picked_num++;
+      if (smallest_picked_num >= 4) {
+        break;
+      }
+
+      MarkNeighborsPicked(ring, ind, &neighbor_picked);
+    }
+    scratch->selection_time += t_tmp.toc();
+
+    // 将flat点和未标记点都标记为less_flat点
+    for (int k = sp; k <= ep; k++) {
+      if (labels[k] == P_FLAT || labels[k] == P_UNKNOWN) {
+        surf_less_flat_scan.push_back(ring.points[k]);
+      }
+    }
+  }
+
+  scratch->voxel_filter.Filter(surf_less_flat_scan, &scratch->surf_less_flat);
+}
@@ -0,0 +1,66 @@
+#ifndef MSF_LOAM_VELODYNE_FEATURE_EXTRACTOR_H
+#define MSF_LOAM_VELODYNE_FEATURE_EXTRACTOR_H
+
+#include <vector>
+
+#include "common/common.h"
+#include "common/thread_pool.h"
+#include "common/timestamped_pointcloud.h"
+#include "slam/voxel_filter.h"
+
+struct FeatureExtractorOptions {
+  // 不选取被遮挡的边缘点和与激光束接近平行的面上的点，要求扫描线上相邻的点在水平角
+  // 上相邻，例如点云消息按发射顺序排列或投影为距离图像
+  bool mark_occluded_points = false;
+};
+
+/**
+ * @brief 按扫描线提取特征点（sharp, less sharp, flat, less flat）
+ *
+ * Every ring owns its scratch buffers and partial feature clouds, so rings
+ * are processed independently and in parallel. The partial clouds are merged
+ * in ring order, the result does not depend on the number of threads.
+ * Different instances may be used concurrently, a single instance must not.
+ */
+class FeatureExtractor {
+ public:
+  // 'thread_pool' is not owned and may be null, then rings are processed
+  // serially.
+  FeatureExtractor(const FeatureExtractorOptions& options,
+                   ThreadPool* thread_pool);
+
+  // 'rings' holds the points of every scan line in scan order, the integer
+  // part of the intensity is the scan id. Fills the feature clouds and the
+  // full resolution cloud of 'scan'.
+  void Extract(const std::vector<PointCloud>& rings,
+               TimestampedPointCloud* scan);
+
+ private:
+  struct RingScratch {
+    explicit RingScratch(float leaf_size) : voxel_filter(leaf_size) {}
+
+    std::vector<float> x, y, z;          // 点坐标（SoA）
+    std::vector<float> curvatures;       // 点的曲率
+    std::vector<int> sorted_indices;     // 按曲率选取点的堆
+    std::vector<char> neighbor_picked;   // 临近点是否已被选取
+    std::vector<int> labels;             // 扫描线上点的类型
+
+    PointCloud corner_sharp;
+    PointCloud corner_less_sharp;
+    PointCloud surf_flat;
+    PointCloud surf_less_flat;
+
+    PointCloud surf_less_flat_scan;  // 降采样前的 less flat 点
+    VoxelFilter voxel_filter;
+
+    double selection_time = 0.;
+  };
+
+  void ExtractRing(const PointCloud& ring, RingScratch* scratch) const;
+
+  const FeatureExtractorOptions options_;
+  ThreadPool* const thread_pool_;
+  std::vector<RingScratch> scratches_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_FEATURE_EXTRACTOR_H
@@ -0,0 +1,380 @@
+#include "slam/feature_extraction/point_cloud_ingest.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#include "common/point_kernels.h"
+
+namespace {
+
+template <typename T>
+T ReadAs(const uint8_t* const data) {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+double ReadField(const uint8_t* const data, const uint8_t datatype) {
+  switch (datatype) {
+    case sensor_msgs::PointField::INT8:
+      return ReadAs<int8_t>(data);
+    case sensor_msgs::PointField::UINT8:
+      return ReadAs<uint8_t>(data);
+    case sensor_msgs::PointField::INT16:
+      return ReadAs<int16_t>(data);
+    case sensor_msgs::PointField::UINT16:
+      return ReadAs<uint16_t>(data);
+    case sensor_msgs::PointField::INT32:
+      return ReadAs<int32_t>(data);
+    case sensor_msgs::PointField::UINT32:
+      return ReadAs<uint32_t>(data);
+    case sensor_msgs::PointField::FLOAT32:
+      return ReadAs<float>(data);
+    case sensor_msgs::PointField::FLOAT64:
+      return ReadAs<double>(data);
+  }
+  LOG(FATAL) << "Unknown PointField datatype: " << int(datatype);
+  return 0.;
+}
+
+}  // namespace
+
+PointCloudIngest::PointCloudIngest(const PointCloudIngestOptions& options)
+    : options_(options),
+      min_squared_range_(options.min_range * options.min_range),
+      rings_(options.scan_num) {
+  CHECK_GT(options_.scan_num, 0);
+  CHECK_GE(options_.num_columns, 0);
+  if (!options_.beam_altitudes.empty()) {
+    CHECK_EQ(static_cast<int>(options_.beam_altitudes.size()),
+             options_.scan_num)
+        << "beam_altitudes needs one altitude per scan line.";
+    beams_by_altitude_.resize(options_.scan_num);
+    std::iota(beams_by_altitude_.begin(), beams_by_altitude_.end(), 0);
+    std::sort(beams_by_altitude_.begin(), beams_by_altitude_.end(),
+              [this](const int i, const int j) {
+                return options_.beam_altitudes[i] < options_.beam_altitudes[j];
+              });
+  }
+  // 没有俯仰角表时只有 16、32、64 线 Velodyne 的公式
+  angle_matches_scan_lines_ = !beams_by_altitude_.empty() ||
+                              options_.scan_num == 16 ||
+                              options_.scan_num == 32 ||
+                              options_.scan_num == 64;
+  CHECK(angle_matches_scan_lines_ || options_.use_ring_field)
+      << "The scan lines of a " << options_.scan_num
+      << " line lidar without a ring field need beam_altitudes.";
+}
+
+const std::vector<PointCloud>& PointCloudIngest::Ingest(
+    const sensor_msgs::PointCloud2& msg) {
+  CHECK(!msg.is_bigendian) << "Big endian PointCloud2 is not supported.";
+  PointBuffer buffer;
+  buffer.data = msg.data.data();
+  buffer.width = msg.width;
+  buffer.height = msg.height;
+  buffer.row_step = msg.row_step;
+  buffer.point_step = msg.point_step;
+  buffer.x = FindField(msg, "x");
+  buffer.y = FindField(msg, "y");
+  buffer.z = FindField(msg, "z");
+  CHECK(buffer.x.valid() && buffer.y.valid() && buffer.z.valid())
+      << "PointCloud2 without x, y or z field.";
+  CHECK(buffer.x.datatype == sensor_msgs::PointField::FLOAT32 &&
+        buffer.y.datatype == sensor_msgs::PointField::FLOAT32 &&
+        buffer.z.datatype == sensor_msgs::PointField::FLOAT32)
+      << "Only float32 coordinates are supported.";
+  if (options_.use_ring_field) buffer.ring = FindField(msg, "ring");
+  if (options_.use_time_field) {
+    buffer.time = FindField(msg, "time");
+    if (!buffer.time.valid()) {
+      buffer.time = FindField(msg, "t");
+      buffer.time_scale = 1e-9;
+    }
+  }
+  return Ingest(buffer);
+}
+
+const std::vector<PointCloud>& PointCloudIngest::IngestXYZI(
+    const float* const points, const size_t num_points) {
+  CHECK(angle_matches_scan_lines_)
+      << "The scan lines of a " << options_.scan_num
+      << " line lidar without a ring field need beam_altitudes.";
+  PointBuffer buffer;
+  buffer.data = reinterpret_cast<const uint8_t*>(points);
+  buffer.width = num_points;
+  buffer.height = 1;
+  buffer.point_step = 4 * sizeof(float);
+  buffer.row_step = buffer.width * buffer.point_step;
+  buffer.x = {0, sensor_msgs::PointField::FLOAT32};
+  buffer.y = {4, sensor_msgs::PointField::FLOAT32};
+  buffer.z = {8, sensor_msgs::PointField::FLOAT32};
+  return Ingest(buffer);
+}
+
+bool PointCloudIngest::HasFloatPoints(const PointBuffer& buffer) {
+  return buffer.x.offset == 0 && buffer.y.offset == sizeof(float) &&
+         buffer.z.offset == 2 * sizeof(float) &&
+         buffer.point_step % sizeof(float) == 0 &&
+         buffer.row_step % sizeof(float) == 0 &&
+         reinterpret_cast<uintptr_t>(buffer.data) % alignof(float) == 0;
+}
+
+const std::vector<PointCloud>& PointCloudIngest::Ingest(
+    const PointBuffer& buffer) {
+  for (PointCloud& ring : rings_) ring.clear();
+
+  const Field& x = buffer.x;
+  const Field& y = buffer.y;
+  const Field& z = buffer.z;
+  const Field& ring = buffer.ring;
+  const Field& time = buffer.time;
+  const double time_scale = buffer.time_scale;
+
+  const auto read_xyz = [&x, &y, &z](const uint8_t* const data,
+                                     PointType* const point) {
+    point->x = ReadAs<float>(data + x.offset);
+    point->y = ReadAs<float>(data + y.offset);
+    point->z = ReadAs<float>(data + z.offset);
+    point->intensity = 0.f;
+  };
+  // 读取坐标并删除非法点和近点
+  const auto read_point = [this, &read_xyz](const uint8_t* const data,
+                                            PointType* const point) {
+    read_xyz(data, point);
+    if (!std::isfinite(point->x) || !std::isfinite(point->y) ||
+        !std::isfinite(point->z)) {
+      return false;
+    }
+    return point->x * point->x + point->y * point->y + point->z * point->z >=
+           min_squared_range_;
+  };
+  const auto point_data = [&buffer](const int index) {
+    return buffer.data + (index / buffer.width) * buffer.row_step +
+           (index % buffer.width) * buffer.point_step;
+  };
+
+  // 有序点云的每行为一条扫描线，每列为一个水平角
+  const bool organized =
+      buffer.height > 1 && static_cast<int>(buffer.height) == options_.scan_num;
+  const bool use_range_image = options_.num_columns > 0;
+  const bool use_native_columns =
+      organized && static_cast<int>(buffer.width) == options_.num_columns;
+  if (use_range_image) {
+    range_image_.Reset(options_.scan_num, options_.num_columns);
+  }
+
+  // Without a time field, the time is interpolated from the horizontal angle
+  // between the first and the last valid point. The columns of the range
+  // image start at the first point as well.
+  const int num_points = buffer.width * buffer.height;
+  double start_ori = 0.;
+  double end_ori = 0.;
+  if (!time.valid() || (use_range_image && !use_native_columns)) {
+    PointType point;
+    int first = 0;
+    while (first < num_points && !read_point(point_data(first), &point)) {
+      ++first;
+    }
+    if (first == num_points) {
+      LOG(WARNING) << "No valid point in the point cloud.";
+      return rings_;
+    }
+    start_ori = -std::atan2(point.y, point.x);
+    int last = num_points - 1;
+    while (!read_point(point_data(last), &point)) --last;
+    end_ori = -std::atan2(point.y, point.x) + 2 * M_PI;
+    if (end_ori - start_ori > 3 * M_PI) {
+      end_ori -= 2 * M_PI;
+    } else if (end_ori - start_ori < M_PI) {
+      end_ori += 2 * M_PI;
+    }
+  }
+
+  bool half_passed = false;
+  bool has_time_reference = false;
+  double time_reference = 0.;
+  int num_valid = 0;
+  int num_invalid_scan_id = 0;
+  // 按块用 SIMD 判断非法点和近点，无限远的点大于 max()，同样删除
+  constexpr int kRangeBlockSize = 64;
+  const bool use_range_mask = HasFloatPoints(buffer);
+  const int stride = buffer.point_step / sizeof(float);
+  bool keep[kRangeBlockSize];
+  for (uint32_t row = 0; row < buffer.height; ++row) {
+    const uint8_t* data = buffer.data + row * buffer.row_step;
+    for (uint32_t col = 0; col < buffer.width;
+         ++col, data += buffer.point_step) {
+      const int block_index = col % kRangeBlockSize;
+      PointType point;
+      if (use_range_mask) {
+        if (block_index == 0) {
+          ComputeRangeMaskAoS(
+              reinterpret_cast<const float*>(data), stride,
+              std::min<int>(kRangeBlockSize, buffer.width - col),
+              min_squared_range_, std::numeric_limits<float>::max(), keep);
+        }
+        if (!keep[block_index]) continue;
+        read_xyz(data, &point);
+      } else if (!read_point(data, &point)) {
+        continue;
+      }
+
+      // 计算scan_id
+      int scan_id;
+      if (ring.valid()) {
+        scan_id = static_cast<int>(ReadField(data + ring.offset, ring.datatype));
+        if (scan_id < 0 || scan_id >= options_.scan_num) {
+          ++num_invalid_scan_id;
+          continue;
+        }
+      } else if (organized) {
+        scan_id = row;
+      } else if (!ComputeScanId(point, &scan_id)) {
+        ++num_invalid_scan_id;
+        continue;
+      }
+
+      // 计算点在当前帧的时间偏移
+      double rel_time;
+      if (time.valid()) {
+        const double point_time =
+            ReadField(data + time.offset, time.datatype) * time_scale;
+        if (!has_time_reference) {
+          time_reference = point_time;
+          has_time_reference = true;
+        }
+        rel_time = std::min(std::max(point_time - time_reference, 0.),
+                            options_.scan_period);
+      } else {
+        double ori = -std::atan2(point.y, point.x);
+        if (!half_passed) {
+          if (ori < start_ori - M_PI / 2) {
+            ori += 2 * M_PI;
+          } else if (ori > start_ori + M_PI * 3 / 2) {
+            ori -= 2 * M_PI;
+          }
+
+          if (ori - start_ori > M_PI) {
+            half_passed = true;
+          }
+        } else {
+          ori += 2 * M_PI;
+          if (ori < end_ori - M_PI * 3 / 2) {
+            ori += 2 * M_PI;
+          } else if (ori > end_ori + M_PI / 2) {
+            ori -= 2 * M_PI;
+          }
+        }
+        rel_time =
+            options_.scan_period * (ori - start_ori) / (end_ori - start_ori);
+      }
+
+      // 密度的整数部分为scan_id，浮点部分为点在当前帧的时间偏移
+      point.intensity = scan_id + rel_time;
+      if (!use_range_image) {
+        rings_[scan_id].push_back(point);
+        ++num_valid;
+        continue;
+      }
+
+      int column = col;
+      if (!use_native_columns) {
+        // 第一个点位于第 0 列的中心
+        double angle = -std::atan2(point.y, point.x) - start_ori;
+        angle -= 2 * M_PI * std::floor(angle / (2 * M_PI));
+        column = static_cast<int>(std::lround(
+                     angle * options_.num_columns / (2 * M_PI))) %
+                 options_.num_columns;
+      }
+      range_image_.Insert(scan_id, column, point,
+                          point.x * point.x + point.y * point.y +
+                              point.z * point.z);
+    }
+  }
+  if (use_range_image) num_valid = range_image_.AppendRows(&rings_);
+  LOG_IF(WARNING, num_invalid_scan_id > 10)
+      << "More than 10 invalid points: no matching scan id!!";
+  LOG(INFO) << "[REG] Cloud size: " << num_valid;
+  return rings_;
+}
+
+PointCloudIngest::Field PointCloudIngest::FindField(
+    const sensor_msgs::PointCloud2& msg, const std::string& name) {
+  Field field;
+  for (const auto& point_field : msg.fields) {
+    if (point_field.name == name) {
+      field.offset = point_field.offset;
+      field.datatype = point_field.datatype;
+      break;
+    }
+  }
+  return field;
+}
+
+bool PointCloudIngest::ComputeScanId(const PointType& point,
+                                     int* const scan_id) const {
+  const double angle =
+      std::atan(point.z / std::sqrt(point.x * point.x + point.y * point.y)) *
+      180 / M_PI;
+  if (!beams_by_altitude_.empty()) {
+    return LookUpBeam(angle, scan_id);
+  }
+  if (options_.scan_num == 16) {
+    *scan_id = int((angle + 15) / 2 + 0.5);
+    return *scan_id <= options_.scan_num - 1 && *scan_id >= 0;
+  } else if (options_.scan_num == 32) {
+    *scan_id = int((angle + 92.0 / 3.0) * 3.0 / 4.0);
+    return *scan_id <= options_.scan_num - 1 && *scan_id >= 0;
+  } else if (options_.scan_num == 64) {
+    if (angle >= -8.83)
+      *scan_id = int((2 - angle) * 3.0 + 0.5);
+    else
+      *scan_id = options_.scan_num / 2 + int((-8.83 - angle) * 2.0 + 0.5);
+
+    // use [0 50]  > 50 remove outlies
+    return !(angle > 2 || angle < -24.33 || *scan_id > 50 || *scan_id < 0);
+  }
+  // 只有 ring 字段或有序点云能确定扫描线，其余的点丢弃并计数
+  return false;
+}
+
+bool PointCloudIngest::LookUpBeam(const double altitude,
+                                  int* const scan_id) const {
+  const std::vector<double>& altitudes = options_.beam_altitudes;
+  // 第一个俯仰角不小于 altitude 的扫描线
+  const auto upper = std::lower_bound(
+      beams_by_altitude_.begin(), beams_by_altitude_.end(), altitude,
+      [&altitudes](const int beam, const double value) {
+        return altitudes[beam] < value;
+      });
+  if (upper == beams_by_altitude_.end()) {
+    // 表外的点与最外的扫描线相差不超过半个扫描线间隔
+    const int top = beams_by_altitude_.back();
+    const double half_gap =
+        beams_by_altitude_.size() > 1
+            ? 0.5 * (altitudes[top] - altitudes[*(upper - 2)])
+            : 1.;
+    *scan_id = top;
+    return altitude - altitudes[top] <= half_gap;
+  }
+  if (upper == beams_by_altitude_.begin()) {
+    const int bottom = *upper;
+    const double half_gap =
+        beams_by_altitude_.size() > 1
+            ? 0.5 * (altitudes[*(upper + 1)] - altitudes[bottom])
+            : 1.;
+    *scan_id = bottom;
+    return altitudes[bottom] - altitude <= half_gap;
+  }
+  const int lower_beam = *(upper - 1);
+  *scan_id = altitude - altitudes[lower_beam] < altitudes[*upper] - altitude
+                 ? lower_beam
+                 : *upper;
+  return true;
+}
@@ -0,0 +1,108 @@
+#ifndef MSF_LOAM_VELODYNE_POINT_CLOUD_INGEST_H
+#define MSF_LOAM_VELODYNE_POINT_CLOUD_INGEST_H
+
+#include <sensor_msgs/PointCloud2.h>
+#include <vector>
+
+#include "common/common.h"
+#include "slam/feature_extraction/range_image.h"
+
+struct PointCloudIngestOptions {
+  int scan_num = 16;         // 扫描线数
+  double min_range = 0.3;    // 最小扫描距离
+  double scan_period = 0.1;  // 扫描周期
+  // Use the 'ring' and 'time' / 't' fields if the driver publishes them.
+  bool use_ring_field = true;
+  bool use_time_field = true;
+  // 各扫描线的俯仰角（度），下标为扫描线号。非空时按最近的俯仰角确定扫描线，
+  // 代替 16、32、64 线的公式，个数须为 scan_num
+  std::vector<double> beam_altitudes;
+  // Columns of the range image the points are projected into, 0 keeps the
+  // points of a ring in arrival order.
+  int num_columns = 0;
+};
+
+/**
+ * @brief 将 PointCloud2 消息按扫描线分组
+ *
+ * Reads x, y and z straight from the message buffer using the field offsets,
+ * drops NaN and too close points and buckets the others into per ring clouds
+ * in a single pass. If every point starts with the floats x, y and z, the
+ * range test runs on blocks of points with ComputeRangeMaskAoS(). The
+ * integer part of the intensity is the scan id, the fractional part the time
+ * of the point relative to the first one.
+ *
+ * The scan id is taken from the 'ring' field (velodyne_pointcloud, Ouster),
+ * else from the row of an organized cloud with 'scan_num' rows, else from the
+ * vertical angle of the point, matched to 'beam_altitudes' or, without them,
+ * to a Velodyne with 16, 32 or 64 scan lines. The time is taken from the
+ * 'time' field (seconds, velodyne_pointcloud) or the 't' field (nanoseconds,
+ * Ouster) if present, otherwise computed from the horizontal angle.
+ *
+ * With 'num_columns' the points are projected into a RangeImage first, the
+ * column is the column of an organized cloud of that width or the horizontal
+ * angle from the first point. The rings then hold the image rows, ordered by
+ * angle with the closest point per pixel.
+ *
+ * The ring clouds are reused between frames, a single instance must not be
+ * used concurrently.
+ */
+class PointCloudIngest {
+ public:
+  explicit PointCloudIngest(const PointCloudIngestOptions& options);
+
+  // Returns the rings of 'msg' in scan order. They stay valid until the next
+  // call.
+  const std::vector<PointCloud>& Ingest(const sensor_msgs::PointCloud2& msg);
+
+  // Same for 'num_points' packed x, y, z, intensity floats as stored in the
+  // KITTI .bin files. The scan id and the time are computed from the angles.
+  const std::vector<PointCloud>& IngestXYZI(const float* points,
+                                            size_t num_points);
+
+ private:
+  struct Field {
+    int offset = -1;
+    uint8_t datatype = 0;
+    bool valid() const { return offset >= 0; }
+  };
+
+  // Layout of the points in a little endian buffer.
+  struct PointBuffer {
+    const uint8_t* data = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t row_step = 0;
+    uint32_t point_step = 0;
+    Field x, y, z, ring, time;
+    double time_scale = 1.;  // of the time field to seconds
+  };
+
+  const std::vector<PointCloud>& Ingest(const PointBuffer& buffer);
+
+  // Whether every point of 'buffer' is an aligned float array starting with
+  // x, y and z, i.e. can be passed to ComputeRangeMaskAoS().
+  static bool HasFloatPoints(const PointBuffer& buffer);
+
+  static Field FindField(const sensor_msgs::PointCloud2& msg,
+                         const std::string& name);
+
+  // Returns false if the point matches no scan line, always without
+  // 'beam_altitudes' for other than 16, 32 or 64 scan lines.
+  bool ComputeScanId(const PointType& point, int* scan_id) const;
+
+  // 在俯仰角表中查找最近的扫描线
+  bool LookUpBeam(double altitude, int* scan_id) const;
+
+  const PointCloudIngestOptions options_;
+  const float min_squared_range_;
+  // 按俯仰角排序的扫描线号
+  std::vector<int> beams_by_altitude_;
+  // Whether ComputeScanId() can match points to scan lines, otherwise only
+  // the ring field or an organized cloud can.
+  bool angle_matches_scan_lines_;
+  std::vector<PointCloud> rings_;
+  RangeImage range_image_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_POINT_CLOUD_INGEST_H
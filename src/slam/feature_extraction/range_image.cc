@@ -0,0 +1,28 @@
+#include "slam/feature_extraction/range_image.h"
+
+#include <glog/logging.h>
+
+void RangeImage::Reset(const int num_rings, const int num_columns) {
+  CHECK_GT(num_rings, 0);
+  CHECK_GT(num_columns, 0);
+  num_rings_ = num_rings;
+  num_columns_ = num_columns;
+  const size_t num_pixels = static_cast<size_t>(num_rings) * num_columns;
+  pixels_.resize(num_pixels);
+  squared_ranges_.assign(num_pixels, 0.f);
+}
+
+int RangeImage::AppendRows(std::vector<PointCloud>* const rings) const {
+  CHECK_GE(static_cast<int>(rings->size()), num_rings_);
+  int num_points = 0;
+  for (int ring = 0; ring < num_rings_; ++ring) {
+    PointCloud& ring_cloud = (*rings)[ring];
+    const int row_begin = ring * num_columns_;
+    for (int index = row_begin; index < row_begin + num_columns_; ++index) {
+      if (squared_ranges_[index] == 0.f) continue;
+      ring_cloud.push_back(pixels_[index]);
+      ++num_points;
+    }
+  }
+  return num_points;
+}
@@ -0,0 +1,48 @@
+#ifndef MSF_LOAM_VELODYNE_RANGE_IMAGE_H
+#define MSF_LOAM_VELODYNE_RANGE_IMAGE_H
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "common/common.h"
+
+/**
+ * @brief 距离图像
+ *
+ * A rings x columns image of the points of a scan. A pixel keeps the closest
+ * of the points which fall into it, so the points of a row are in column
+ * order and neighbouring points are neighbours in angle, whatever order the
+ * points arrived in. The buffers are resized to the image and reused between
+ * frames.
+ */
+class RangeImage {
+ public:
+  // Clears the image and resizes it to 'num_rings' x 'num_columns'.
+  void Reset(int num_rings, int num_columns);
+
+  void Insert(const int ring, const int column, const PointType& point,
+              const float squared_range) {
+    const int index = ring * num_columns_ + column;
+    float& pixel_squared_range = squared_ranges_[index];
+    if (pixel_squared_range == 0.f || squared_range < pixel_squared_range) {
+      pixel_squared_range = squared_range;
+      pixels_[index] = point;
+    }
+  }
+
+  // Appends the points of every row in column order to the ring of the same
+  // index. Returns the number of points.
+  int AppendRows(std::vector<PointCloud>* rings) const;
+
+  int num_rings() const { return num_rings_; }
+  int num_columns() const { return num_columns_; }
+
+ private:
+  int num_rings_ = 0;
+  int num_columns_ = 0;
+  std::vector<PointType, Eigen::aligned_allocator<PointType>> pixels_;
+  // 0 为空像素，点的距离不小于 min_range
+  std::vector<float> squared_ranges_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_RANGE_IMAGE_H
@@ -0,0 +1,169 @@
+#include "slam/front_end.h"
+
+#include "slam/msg_conversion.h"
+
+namespace {
+
+const int kDefaultScanNum = 16;
+
+ImuData ToImuData(const sensor_msgs::Imu &imu_msg) {
+  ImuData imu_data;
+  imu_data.time = FromRos(imu_msg.header.stamp);
+  imu_data.linear_acceleration << imu_msg.linear_acceleration.x,
+      imu_msg.linear_acceleration.y, imu_msg.linear_acceleration.z;
+  imu_data.angular_velocity << imu_msg.angular_velocity.x,
+      imu_msg.angular_velocity.y, imu_msg.angular_velocity.z;
+  return imu_data;
+}
+
+OdometryData ToOdometryData(const nav_msgs::Odometry &odom_msg) {
+  OdometryData odom_data;
+  odom_data.timestamp = FromRos(odom_msg.header.stamp);
+  odom_data.odom = FromRos(odom_msg.pose);
+  odom_data.error = 0;
+  return odom_data;
+}
+
+// 匹配默认使用 ceres，参数为 true 时使用高斯牛顿求解器
+ScanMatcherSolverType ReadSolverType(const ros::NodeHandle &nh,
+                                     const std::string &use_gauss_newton) {
+  bool value;
+  nh.param<bool>(use_gauss_newton, value, false);
+  return value ? ScanMatcherSolverType::kGaussNewton
+               : ScanMatcherSolverType::kCeres;
+}
+
+}  // namespace
+
+SlamPipelineOptions ReadSlamPipelineOptions(ros::NodeHandle *const node_handle,
+                                            const bool is_offline_mode,
+                                            const bool pipeline_mode) {
+  ros::NodeHandle &nh = *node_handle;
+  SlamPipelineOptions options;
+  options.is_offline_mode = is_offline_mode;
+  options.pipeline_mode = pipeline_mode;
+
+  PointCloudIngestOptions &ingest_options = options.ingest_options;
+  LOG_IF(WARNING, !nh.param<int>("scan_line", ingest_options.scan_num,
+                                 kDefaultScanNum))
+      << "Use default scan_line: " << kDefaultScanNum;
+  LOG_IF(WARNING,
+         !nh.param<double>("minimum_range", ingest_options.min_range, 0.3))
+      << "Use default minimum_range: 0.3";
+  nh.param<bool>("use_ring_field", ingest_options.use_ring_field, true);
+  nh.param<bool>("use_time_field", ingest_options.use_time_field, true);
+  nh.param<std::vector<double>>("beam_altitudes",
+                                ingest_options.beam_altitudes,
+                                std::vector<double>());
+  nh.param<int>("range_image_columns", ingest_options.num_columns, 0);
+  nh.param<bool>("mark_occluded_points",
+                 options.feature_extractor_options.mark_occluded_points,
+                 false);
+  nh.param<int>("feature_extraction_threads",
+                options.num_feature_extraction_threads, 4);
+  nh.param<int>("registration_cpu", options.registration_cpu, -1);
+  nh.param<int>("odometry_cpu", options.odometry_cpu, -1);
+
+  LaserOdometryOptions &odometry_options = options.odometry_options;
+  nh.param<bool>("odometry_use_imu_rotation",
+                 odometry_options.use_imu_rotation, false);
+  nh.param<int>("odometry_max_num_rounds",
+                odometry_options.scan_matcher_options.max_num_rounds, 2);
+  odometry_options.scan_matcher_options.solver_type =
+      ReadSolverType(nh, "odometry_use_gauss_newton");
+  nh.param<bool>("deskew", odometry_options.deskew, false);
+  odometry_options.scan_period = ingest_options.scan_period;
+
+  LaserMappingOptions &mapping_options = options.mapping_options;
+  LOG_IF(WARNING, !nh.param<float>("mapping_line_resolution",
+                                   mapping_options.line_resolution, 0.2))
+      << "Use default mapping_line_resolution: 0.2";
+  LOG_IF(WARNING, !nh.param<float>("mapping_plane_resolution",
+                                   mapping_options.plane_resolution, 0.4))
+      << "Use default mapping_plane_resolution: 0.4";
+  nh.param<bool>("use_voxel_centroid_map",
+                 mapping_options.use_voxel_centroid_map, false);
+  nh.param<bool>("use_quantized_map", mapping_options.use_quantized_map,
+                 false);
+  nh.param<bool>("keep_map_intensity", mapping_options.keep_map_intensity,
+                 false);
+  nh.param<int>("mapping_submap_num_scans",
+                mapping_options.num_scans_per_submap, 0);
+  nh.param<int>("mapping_memory_budget_mb", mapping_options.memory_budget_mb,
+                0);
+  nh.param<std::string>("mapping_tile_directory",
+                        mapping_options.tile_directory, "/tmp");
+  nh.param<std::string>("localization_map_prefix",
+                        mapping_options.localization_map_prefix, "");
+  nh.param<std::string>("save_map_prefix", mapping_options.save_map_prefix,
+                        "");
+  nh.param<int>("mapping_association_threads",
+                mapping_options.num_association_threads, 4);
+  MappingScanMatcherOptions &scan_matcher_options =
+      mapping_options.scan_matcher_options;
+  scan_matcher_options.solver_type =
+      ReadSolverType(nh, "mapping_use_gauss_newton");
+  nh.param<int>("mapping_solver_threads",
+                scan_matcher_options.num_solver_threads, 1);
+  nh.param<int>("mapping_coarse_point_stride",
+                scan_matcher_options.coarse_point_stride, 4);
+  nh.param<int>("mapping_max_num_rounds", scan_matcher_options.max_num_rounds,
+                3);
+  nh.param<double>("mapping_deadline_ms",
+                   mapping_options.scheduler_options.deadline_ms, 100.);
+  nh.param<int>("mapping_cpu", mapping_options.cpu, -1);
+  GpsFusionOptions &gps_fusion_options = mapping_options.gps_fusion_options;
+  nh.param<int>("gps_window_size", gps_fusion_options.window_size, 300);
+  nh.param<double>("gps_optimization_period",
+                   gps_fusion_options.optimization_period, 1.);
+  nh.param<int>("gps_solver_threads", gps_fusion_options.num_threads, 1);
+  nh.param<bool>("use_loop_closure", mapping_options.use_loop_closure, false);
+  SparsePoseGraphOptions &loop_closure_options =
+      mapping_options.loop_closure_options;
+  nh.param<double>("loop_closure_keyframe_distance",
+                   loop_closure_options.keyframe_distance, 1.);
+  nh.param<float>("loop_closure_max_descriptor_distance",
+                  loop_closure_options.max_descriptor_distance, 0.3f);
+  nh.param<double>("loop_closure_min_inlier_ratio",
+                   loop_closure_options.min_inlier_ratio, 0.7);
+  return options;
+}
+
+int ReplayBag(const std::string &bag_filename, SlamPipeline *const pipeline,
+              const BagReaderOptions &options) {
+  BagReader bag_reader(bag_filename, options);
+  int num_laser_clouds = 0;
+  BagMessage message;
+  while (bag_reader.Next(&message)) {
+    if (message.laser_cloud != nullptr) {
+      pipeline->AddPointCloud(message.laser_cloud);
+      ++num_laser_clouds;
+    } else if (message.imu != nullptr) {
+      pipeline->AddImu(ToImuData(*message.imu));
+    } else if (message.odom != nullptr) {
+      pipeline->AddOdom(ToOdometryData(*message.odom));
+    }
+  }
+  LOG_IF(WARNING, num_laser_clouds == 0)
+      << "No point cloud read from " << bag_filename;
+  return num_laser_clouds;
+}
+
+FrontEnd::FrontEnd(const bool is_offline_mode, const bool pipeline_mode)
+    : output_(&node_handle_),
+      pipeline_(ReadSlamPipelineOptions(&node_handle_, is_offline_mode,
+                                        pipeline_mode),
+                &output_) {}
+
+void FrontEnd::AddLaserCloudMessage(
+    const sensor_msgs::PointCloud2ConstPtr &laser_cloud_msg) {
+  pipeline_.AddPointCloud(laser_cloud_msg);
+}
+
+void FrontEnd::AddImuMessage(const sensor_msgs::ImuConstPtr &imu_msg) {
+  pipeline_.AddImu(ToImuData(*imu_msg));
+}
+
+void FrontEnd::AddOdomMessage(const nav_msgs::OdometryConstPtr &odom_msg) {
+  pipeline_.AddOdom(ToOdometryData(*odom_msg));
+}
@@ -0,0 +1,54 @@
+#ifndef MSF_LOAM_VELODYNE_FRONT_END_H
+#define MSF_LOAM_VELODYNE_FRONT_END_H
+
+#include <nav_msgs/Odometry.h>
+#include <ros/node_handle.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <string>
+
+#include "slam/bag_reader.h"
+#include "slam/ros_output.h"
+#include "slam/slam_pipeline.h"
+
+// Reads the options of the SlamPipeline from the ROS parameters.
+SlamPipelineOptions ReadSlamPipelineOptions(ros::NodeHandle *node_handle,
+                                            bool is_offline_mode,
+                                            bool pipeline_mode);
+
+// Adds all messages of the bag to 'pipeline' as fast as they are accepted,
+// read ahead by a BagReader. Returns the number of point clouds read.
+int ReplayBag(const std::string &bag_filename, SlamPipeline *pipeline,
+              const BagReaderOptions &options = BagReaderOptions());
+
+/**
+ * @brief ROS 消息的入口
+ *
+ * A SlamPipeline configured from the ROS parameters which publishes its
+ * results to ROS, see RosOutput. Messages must be added from a single
+ * thread.
+ */
+class FrontEnd {
+ public:
+  FrontEnd(bool is_offline_mode, bool pipeline_mode);
+
+  // Processes all frames added so far before returning.
+  ~FrontEnd() = default;
+
+  void AddLaserCloudMessage(
+      const sensor_msgs::PointCloud2ConstPtr &laser_cloud_msg);
+
+  void AddImuMessage(const sensor_msgs::ImuConstPtr &imu_msg);
+
+  void AddOdomMessage(const nav_msgs::OdometryConstPtr &odom_msg);
+
+  SlamPipeline *pipeline() { return &pipeline_; }
+
+ private:
+  ros::NodeHandle node_handle_;
+  // Outlives 'pipeline_', which publishes until it is destroyed.
+  RosOutput output_;
+  SlamPipeline pipeline_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_FRONT_END_H
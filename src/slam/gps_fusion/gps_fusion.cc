@@ -1,98 +1,156 @@
 #include "slam/gps_fusion/gps_fusion.h"
-#include "slam/gps_fusion/gps_factor.h"
-
-namespace {
 
-bool CompareTimeLT(const FixedPoint& l, const LocalPose& r) {
-  return l.timestamp < r.timestamp;
-}
+#include <algorithm>
 
-}  // namespace
+#include "common/tic_toc.h"
+#include "slam/gps_fusion/gps_factor.h"
 
-GpsFusion::GpsFusion() { LOG(INFO) << "GpsFusion started!"; }
+GpsFusion::GpsFusion(const GpsFusionOptions& options)
+    : options_(options), optimization_thread_(1) {
+  CHECK_GE(options_.window_size, 2);
+  LOG(INFO) << "GpsFusion started!";
+}
 
 GpsFusion::~GpsFusion() { LOG(INFO) << "GpsFusion finished."; }
 
 void GpsFusion::AddFixedPoint(const Time& time,
                               const Eigen::Vector3d& translation) {
+  std::lock_guard<std::mutex> lock(mutex_);
   CHECK(fixed_points_.empty() || fixed_points_.back().timestamp < time);
+  // Older than the window, it would never be used.
+  if (!nodes_.empty() && time < nodes_.front().timestamp) return;
   fixed_points_.push_back({time, translation});
 }
 
 void GpsFusion::AddLocalPose(const Time& time, const Rigid3d& pose) {
-  CHECK(local_poses_.empty() || local_poses_.back().timestamp < time);
-  local_poses_.push_back({time, pose});
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK(nodes_.empty() || nodes_.back().timestamp < time);
+    nodes_.push_back({time, pose, local_to_gps_ * pose, false});
+    while (nodes_.size() > static_cast<size_t>(options_.window_size)) {
+      nodes_.pop_front();
+    }
+    while (!fixed_points_.empty() &&
+           fixed_points_.front().timestamp < nodes_.front().timestamp) {
+      fixed_points_.pop_front();
+    }
+    if (options_.optimization_period <= 0. || optimization_scheduled_ ||
+        time < next_optimization_time_ || fixed_points_.size() < 2) {
+      return;
+    }
+    optimization_scheduled_ = true;
+    next_optimization_time_ = time + FromSeconds(options_.optimization_period);
+  }
+  optimization_thread_.Schedule([this] {
+    OptimizeWindow();
+    std::lock_guard<std::mutex> lock(mutex_);
+    optimization_scheduled_ = false;
+  });
 }
 
 void GpsFusion::Optimize() {
-  if (fixed_points_.size() < 2) {
+  if (!OptimizeWindow()) {
     LOG(WARNING) << "Number of fixed points less than 2!";
-    return;
   }
-  CHECK_GT(local_poses_.size(), 2);
-  CHECK_LE(local_poses_.front().timestamp, fixed_points_.front().timestamp);
-  CHECK_LE(fixed_points_.back().timestamp, local_poses_.back().timestamp);
+}
 
-  for (auto& lp : local_poses_) {
-    LOG(INFO) << "local pose before gps: " << lp.timestamp << " "
-              << lp.pose.translation().transpose();
+Rigid3d GpsFusion::local_to_gps() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return local_to_gps_;
+}
+
+bool GpsFusion::OptimizeWindow() {
+  std::lock_guard<std::mutex> optimization_lock(optimization_mutex_);
+  std::vector<Node> nodes;
+  std::vector<FixedPoint> fixed_points;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (nodes_.size() < 2) return false;
+    nodes.assign(nodes_.begin(), nodes_.end());
+    for (const FixedPoint& fp : fixed_points_) {
+      if (fp.timestamp > nodes.back().timestamp) break;
+      fixed_points.push_back(fp);
+    }
   }
+  if (fixed_points.size() < 2) return false;
 
+  TicToc t_optimize;
   ceres::Problem problem;
   ceres::Solver::Options options;
   options.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
   options.minimizer_progress_to_stdout = false;
-  options.num_threads = 4;
-  options.max_num_iterations = 6;
+  options.num_threads = options_.num_threads;
+  options.max_num_iterations = options_.max_num_iterations;
   ceres::Solver::Summary summary;
   ceres::LossFunction* loss_function = new ceres::HuberLoss(1.0);
   ceres::LocalParameterization* local_parameterization =
       new ceres::EigenQuaternionParameterization();
 
-  for (auto& lp : local_poses_) {
-    problem.AddParameterBlock(lp.pose.translation().data(), 3);
-    problem.AddParameterBlock(lp.pose.rotation().coeffs().data(), 4,
-                              local_parameterization);
+  for (Node& node : nodes) {
+    problem.AddParameterBlock(node.optimized_pose.translation().data(), 3);
+    problem.AddParameterBlock(node.optimized_pose.rotation().coeffs().data(),
+                              4, local_parameterization);
+  }
+  // 窗口外的位姿已丢弃，最早的位姿固定在上一次的解上
+  if (nodes.front().optimized) {
+    problem.SetParameterBlockConstant(
+        nodes.front().optimized_pose.translation().data());
+    problem.SetParameterBlockConstant(
+        nodes.front().optimized_pose.rotation().coeffs().data());
   }
 
-  for (auto& fp : fixed_points_) {
-    auto local_pose_j = std::upper_bound(local_poses_.begin(),
-                                         local_poses_.end(), fp, CompareTimeLT);
-    auto local_pose_i = std::prev(local_pose_j);
-    if (fp.timestamp == local_poses_.end()->timestamp)
-      local_pose_j = local_pose_i;
-    double t = (fp.timestamp - local_pose_i->timestamp).count() * 1.0 /
-               (local_pose_j->timestamp - local_pose_i->timestamp).count();
+  const auto compare_time = [](const Time& time, const Node& node) {
+    return time < node.timestamp;
+  };
+  for (const FixedPoint& fp : fixed_points) {
+    auto node_j = std::upper_bound(nodes.begin(), nodes.end(), fp.timestamp,
+                                   compare_time);
+    if (node_j == nodes.end()) --node_j;
+    const auto node_i = std::prev(node_j);
+    const double t = (fp.timestamp - node_i->timestamp).count() * 1.0 /
+                     (node_j->timestamp - node_i->timestamp).count();
     CHECK(t >= 0 && t <= 1);
-    auto cost_function = GpsFactor::Create(fp.translation, t, 0.01);
+    auto cost_function = GpsFactor::Create(fp.translation, t,
+                                           options_.gps_translation_sigma);
     problem.AddResidualBlock(cost_function, loss_function,
-                             local_pose_i->pose.translation().data(),
-                             local_pose_j->pose.translation().data());
+                             node_i->optimized_pose.translation().data(),
+                             node_j->optimized_pose.translation().data());
   }
 
-  for (size_t i = 0; i < local_poses_.size() - 1; ++i) {
-    auto& local_pose_i = local_poses_[i];
-    auto& local_pose_j = local_poses_[i + 1];
+  for (size_t i = 0; i + 1 < nodes.size(); ++i) {
+    Node& node_i = nodes[i];
+    Node& node_j = nodes[i + 1];
     auto cost_function = RelativePoseFactor::Create(
-        local_pose_i.pose, local_pose_j.pose, 0.01, 0.1);
+        node_i.local_pose, node_j.local_pose, options_.relative_rotation_sigma,
+        options_.relative_translation_sigma);
     problem.AddResidualBlock(cost_function, loss_function,
-                             local_pose_i.pose.rotation().coeffs().data(),
-                             local_pose_i.pose.translation().data(),
-                             local_pose_j.pose.rotation().coeffs().data(),
-                             local_pose_j.pose.translation().data());
+                             node_i.optimized_pose.rotation().coeffs().data(),
+                             node_i.optimized_pose.translation().data(),
+                             node_j.optimized_pose.rotation().coeffs().data(),
+                             node_j.optimized_pose.translation().data());
   }
 
   ceres::Solve(options, &problem, &summary);
-
-  for (auto& fp : fixed_points_) {
-    LOG(INFO) << "gps point: " << fp.timestamp << " "
-              << fp.translation.transpose();
+  LOG_STEP_TIME("GPS", "Optimize window", t_optimize.toc());
+  VLOG(1) << "[GPS] " << nodes.size() << " poses, " << fixed_points.size()
+          << " gps points: " << summary.BriefReport();
+
+  // Nodes may have been added and dropped meanwhile, both are in time order.
+  std::lock_guard<std::mutex> lock(mutex_);
+  local_to_gps_ =
+      nodes.back().optimized_pose * nodes.back().local_pose.inverse();
+  auto solved = nodes.begin();
+  for (Node& node : nodes_) {
+    while (solved != nodes.end() && solved->timestamp < node.timestamp) {
+      ++solved;
+    }
+    if (solved != nodes.end() && solved->timestamp == node.timestamp) {
+      node.optimized_pose = solved->optimized_pose;
+      node.optimized = true;
+    } else if (!node.optimized) {
+      // Added after the copy, starts from the new correction.
+      node.optimized_pose = local_to_gps_ * node.local_pose;
+    }
   }
-
-  for (auto& lp : local_poses_) {
-    LOG(INFO) << "local pose after gps: " << lp.timestamp << " "
-              << lp.pose.translation().transpose();
-  }
-
-  LOG(INFO) << summary.FullReport();
+  return true;
 }
@@ -2,8 +2,11 @@
 #define MSF_LOAM_VELODYNE_GPS_FUSION_H
 
 #include <common/rigid_transform.h>
+#include <deque>
+#include <mutex>
 #include <vector>
 
+#include "common/thread_pool.h"
 #include "common/time_def.h"
 
 struct FixedPoint {
@@ -16,21 +19,81 @@ struct LocalPose {
   Rigid3d pose;
 };
 
+struct GpsFusionOptions {
+  // Newest local poses optimized, older ones are dropped. The oldest pose of
+  // the window is held at its previous solution.
+  int window_size = 300;
+  // Data time in seconds between two background optimizations, i.e. the rate
+  // of the correction. 0 only optimizes in Optimize().
+  double optimization_period = 1.;
+  int max_num_iterations = 6;
+  int num_threads = 1;
+  // 观测的标准差
+  double gps_translation_sigma = 0.01;
+  double relative_rotation_sigma = 0.01;
+  double relative_translation_sigma = 0.1;
+};
+
+/**
+ * @brief 滑动窗口的 GPS 融合
+ *
+ * Optimizes the newest 'window_size' local poses against the relative poses
+ * between them and the GPS points in between, on a background thread every
+ * 'optimization_period' seconds. Every optimization starts from the previous
+ * solution, new poses from the latest correction. The cost per optimization
+ * is bounded by the window, however long the run is.
+ *
+ * The result is the correction local_to_gps() of the newest optimized pose,
+ * which maps the local (map) frame into the GPS frame. Poses and GPS points
+ * may be added from different threads, each in time order.
+ */
 class GpsFusion {
  public:
-  explicit GpsFusion();
+  explicit GpsFusion(const GpsFusionOptions &options = GpsFusionOptions());
 
+  // Waits for a running optimization.
   ~GpsFusion();
 
+  GpsFusion(const GpsFusion &) = delete;
+  GpsFusion &operator=(const GpsFusion &) = delete;
+
   void AddFixedPoint(const Time &time, const Eigen::Vector3d &t);
 
   void AddLocalPose(const Time &time, const Rigid3d &pose);
 
+  // Optimizes the current window on the calling thread.
   void Optimize();
 
+  // Identity until the first optimization with at least 2 GPS points.
+  Rigid3d local_to_gps() const;
+
  private:
-  std::vector<FixedPoint> fixed_points_;
-  std::vector<LocalPose> local_poses_;
+  struct Node {
+    Time timestamp;
+    Rigid3d local_pose;
+    // Initialized from the correction, held constant as the oldest node
+    // once optimized.
+    Rigid3d optimized_pose;
+    bool optimized;
+  };
+
+  // Copies the window under the lock, solves without it and writes the
+  // solution back. Returns false if the window has less than 2 GPS points.
+  bool OptimizeWindow();
+
+  const GpsFusionOptions options_;
+
+  mutable std::mutex mutex_;
+  std::deque<Node> nodes_;
+  // GPS points not older than the oldest node.
+  std::deque<FixedPoint> fixed_points_;
+  Rigid3d local_to_gps_;
+  bool optimization_scheduled_ = false;
+  Time next_optimization_time_ = Time::min();
+
+  // Serializes the optimizations, destroyed first.
+  std::mutex optimization_mutex_;
+  ThreadPool optimization_thread_;
 };
 
 #endif  // MSF_LOAM_VELODYNE_GPS_FUSION_H
@@ -15,20 +15,29 @@
  */
 
 #include <Eigen/Core>
+#include <algorithm>
 #include <array>
 #include <boost/container/set.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
+#include <chrono>
 #include <cmath>
+#include <fstream>
+#include <future>
 #include <limits>
 #include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
-#include <pcl/filters/voxel_grid.h>
-
 #include "common/common.h"
+#include "common/mapped_file.h"
+#include "common/point_cloud_pool.h"
+#include "common/tic_toc.h"
 #include "glog/logging.h"
 #include "slam/hybrid_grid.h"
+#include "slam/hybrid_grid_cells.h"
+#include "slam/tile_store.h"
 
 // Converts an 'index' with each dimension from 0 to 2^'bits' - 1 to a flat
 // z-major index.
@@ -455,95 +464,665 @@ class HybridGridBase : public GridBase<ValueType> {
   const float resolution_;
 };
 
+class HybridGridImpl {
+ public:
+  virtual ~HybridGridImpl() {}
+
+  virtual void UpdatePose(const Rigid3d& pose) = 0;
+
+  virtual PointCloudPtr GetSurroundedCloud(const Rigid3d& pose) = 0;
+
+  virtual int NearestKSearch(const PointType& point, int k,
+                             float max_squared_distance,
+                             std::vector<PointType>* neighbors,
+                             std::vector<float>* squared_distances) const = 0;
+
+  virtual void InsertScan(const PointCloudConstPtr& scan) = 0;
+
+  virtual size_t num_points() const = 0;
+
+  virtual size_t memory_usage() const = 0;
+
+  virtual void Save(const std::string& filename,
+                    HybridGridCellType cell_type) const = 0;
+};
+
+namespace {
+
+// 地图文件格式：文件头、按编号排序的栅格表、各栅格连续存放的点
+constexpr char kMapFileMagic[8] = "MSFGRID";
+constexpr uint32_t kMapFileVersion = 1;
+
+struct MapFileHeader {
+  char magic[8] = {'M', 'S', 'F', 'G', 'R', 'I', 'D', '\0'};
+  uint32_t version = kMapFileVersion;
+  uint32_t point_size = sizeof(PointType);
+  uint32_t cell_type = 0;
+  float resolution = 0.f;
+  float leaf_size = 0.f;
+  uint32_t reserved = 0;
+  uint64_t num_cells = 0;
+  uint64_t num_points = 0;
+  uint64_t cells_offset = 0;
+  uint64_t points_offset = 0;
+};
+
+struct MapFileCell {
+  int32_t x, y, z;
+  uint32_t num_points;
+  // Index of the first point of the cell in the point block.
+  uint64_t first_point;
+};
+
+// The point block is aligned for mapping PointType directly.
+uint64_t AlignMapFileOffset(const uint64_t offset) {
+  constexpr uint64_t kAlignment = 64;
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Tiles are blocks of 2^kTileBits cells per dimension, the unit of eviction.
+constexpr int kTileBits = 4;
+
+Eigen::Array3i GetTileIndex(const Eigen::Array3i& cell_index) {
+  // Arithmetic shifts round towards negative infinity.
+  return {cell_index.x() >> kTileBits, cell_index.y() >> kTileBits,
+          cell_index.z() >> kTileBits};
+}
+
+uint64_t GetTileKey(const Eigen::Array3i& tile_index) {
+  constexpr int kKeyBits = 21;
+  constexpr int kOffset = 1 << (kKeyBits - 1);
+  return (static_cast<uint64_t>(tile_index.x() + kOffset) << (2 * kKeyBits)) |
+         (static_cast<uint64_t>(tile_index.y() + kOffset) << kKeyBits) |
+         static_cast<uint64_t>(tile_index.z() + kOffset);
+}
+
+bool IsInBox(const Eigen::Array3i& index, const Eigen::Array3i& min_index,
+             const Eigen::Array3i& max_index) {
+  return (index >= min_index).all() && (index <= max_index).all();
+}
+
 // Points are expected to be close to the origin. Points far from the origin
 // require the grid to grow dynamically. For centimeter resolution, points
 // can only be tens of meters from the origin.
 // The hard limit of cell indexes is +/- 8192 around the origin.
-class HybridGridImpl : public HybridGridBase<PointCloudPtr> {
+// 'CellType' is one of the cell types in hybrid_grid_cells.h.
+template <typename CellType>
+class TypedHybridGrid : public HybridGridImpl,
+                        public HybridGridBase<std::shared_ptr<CellType>> {
  private:
-  using Set = boost::unordered_set<PointCloudPtr>;
+  using CellPtr = std::shared_ptr<CellType>;
+  using Base = HybridGridBase<CellPtr>;
+  using Cells = std::vector<std::pair<Eigen::Array3i, CellPtr>>;
+
+  struct Tile {
+    Eigen::Array3i index;
+    // 常驻内存的栅格
+    std::vector<Eigen::Array3i> cells;
+    size_t memory = 0;
+    size_t num_points = 0;
+    bool evicted = false;
+    TileStore::Slot slot;
+    // Pending background load of an evicted tile.
+    std::future<Cells> loading;
+  };
 
  public:
-  explicit HybridGridImpl(const float resolution)
-      : HybridGridBase<PointCloudPtr>(resolution) {}
-
-  PointCloudPtr GetSurroundedCloud(const PointCloudConstPtr& scan,
-                                   const Rigid3d& pose) {
-    Set grid_set;
-    for (auto& point : *scan) {
-      if (point.getVector3fMap().norm() > kDist) continue;
-      for (int i = -1; i <= 1; ++i) {
-        for (int j = -1; j <= 1; ++j) {
-          for (int k = -1; k <= 1; ++k) {
-            auto new_point = pose.cast<float>() * point.getVector3fMap();
-            new_point += Eigen::Vector3f(i, j, k);
-            auto grid_id = this->GetCellIndex(new_point);
-            TryInsertGrid(grid_set, grid_id);
-          }
-        }
-      }
+  explicit TypedHybridGrid(const HybridGridOptions& options)
+      : Base(options.resolution),
+        leaf_size_(options.leaf_size),
+        memory_budget_(options.memory_budget) {
+    if (memory_budget_ > 0) {
+      tile_store_.reset(new TileStore(options.tile_directory));
     }
-    // auto new_point = pose.cast<float>().translation();
-    // auto grid_id = this->GetCellIndex(new_point);
-    // for (int i = -100.0 / resolution(); i <= 100.0 / resolution(); ++i) {
-    //   for (int j = -100.0 / resolution(); j <= 100.0 / resolution(); ++j) {
-    //     for (int k = -100.0 / resolution(); k <= 100.0 / resolution(); ++k) {
-    //       TryInsertGrid(grid_set, grid_id + Eigen::Array3i(i, j, k));
-    //     }
-    //   }
-    // }
-    PointCloudPtr cloud_surround(new PointCloud);
-    cloud_surround->reserve(200 * 1000);
-    for (auto& cloud_in_grid : grid_set) {
-      *cloud_surround += *cloud_in_grid;
+  }
+
+  ~TypedHybridGrid() override {
+    // Pending loads read from 'tile_store_'.
+    for (auto& tile : tiles_) {
+      if (tile.second.loading.valid()) tile.second.loading.wait();
     }
+  }
+
+  void UpdatePose(const Rigid3d& pose) override {
+    UpdateActiveWindow(this->GetCellIndex(pose.translation().cast<float>()));
+  }
+
+  PointCloudPtr GetSurroundedCloud(const Rigid3d& pose) override {
+    UpdatePose(pose);
+    size_t num_points = 0;
+    for (const auto& cell : active_cells_) {
+      num_points += cell.second->points().size();
+    }
+    PointCloudPtr cloud_surround = AcquirePointCloud(num_points);
+    for (const auto& cell : active_cells_) {
+      const auto& points = cell.second->points();
+      cloud_surround->points.insert(cloud_surround->points.end(),
+                                    points.begin(), points.end());
+    }
+    cloud_surround->width = cloud_surround->points.size();
+    cloud_surround->height = 1;
     return cloud_surround;
   }
 
-  void InsertScan(const PointCloudPtr& scan, pcl::Filter<PointType>& filter) {
+  int NearestKSearch(const PointType& point, const int k,
+                     const float max_squared_distance,
+                     std::vector<PointType>* const neighbors,
+                     std::vector<float>* const squared_distances)
+      const override {
+    neighbors->clear();
+    squared_distances->clear();
+    const Eigen::Array3f position = point.getArray3fMap();
+    const Eigen::Array3i center_index = this->GetCellIndex(position.matrix());
+    // 先搜索点所在的栅格，其余栅格与点的距离超过当前第k近点时跳过
+    SearchCell(center_index, position, k, max_squared_distance, neighbors,
+               squared_distances);
+    const float half_resolution = 0.5f * this->resolution();
+    for (int i = -1; i <= 1; ++i) {
+      for (int j = -1; j <= 1; ++j) {
+        for (int l = -1; l <= 1; ++l) {
+          if (i == 0 && j == 0 && l == 0) continue;
+          const Eigen::Array3i index = center_index + Eigen::Array3i(i, j, l);
+          const Eigen::Array3f center =
+              this->GetCenterOfCell(index).array() - position;
+          const float box_squared_distance =
+              (center.abs() - half_resolution).max(0.f).matrix().squaredNorm();
+          const float bound = static_cast<int>(neighbors->size()) < k
+                                  ? max_squared_distance
+                                  : squared_distances->back();
+          if (box_squared_distance >= bound) continue;
+          SearchCell(index, position, k, max_squared_distance, neighbors,
+                     squared_distances);
+        }
+      }
+    }
+    return neighbors->size();
+  }
+
+  void InsertScan(const PointCloudConstPtr& scan) override {
     if (scan->empty()) return;
-    // 添加scan到点云
-    for (auto& point : *scan) {
-      PointCloudPtr* cloud_in_grid =
-          this->mutable_value(GetCellIndex(point.getArray3fMap()));
-      if (!cloud_in_grid->get()) cloud_in_grid->reset(new PointCloud);
-      (*cloud_in_grid)->push_back(point);
+    // 添加scan到点云，记录被修改的栅格及其所在的地图块
+    boost::unordered_map<CellType*, Tile*> touched_cells;
+    CellType* last_cell = nullptr;
+    for (const PointType& point : *scan) {
+      const Eigen::Array3i index = this->GetCellIndex(point.getVector3fMap());
+      CellPtr* cell = this->mutable_value(index);
+      Tile* tile = nullptr;
+      if (!*cell) {
+        tile = GetTile(index);
+        // The cell may exist in an evicted tile.
+        if (tile->evicted) {
+          EnsureResident(tile);
+          cell = this->mutable_value(index);
+        }
+      }
+      if (!*cell) {
+        *cell = std::make_shared<CellType>(leaf_size_);
+        tile->cells.push_back(index);
+        if (has_active_window_ &&
+            IsInBox(index, active_min_index_, active_max_index_)) {
+          active_cells_.emplace_back(index, *cell);
+        }
+      }
+      if (cell->get() != last_cell) {
+        last_cell = cell->get();
+        if (touched_cells.count(last_cell) == 0) {
+          if (tile == nullptr) tile = GetTile(index);
+          touched_cells.emplace(last_cell, tile);
+          RemoveCellStatistics(*last_cell, tile);
+        }
+      }
+      last_cell->Insert(point);
     }
     // 降采样
-    Set grid_set;
-    for (auto& point : *scan) {
-      TryInsertGrid(grid_set, this->GetCellIndex(point.getArray3fMap()));
+    for (const auto& touched_cell : touched_cells) {
+      touched_cell.first->Finish();
+      AddCellStatistics(*touched_cell.first, touched_cell.second);
+    }
+  }
+
+  size_t num_points() const override { return num_points_; }
+
+  size_t memory_usage() const override { return memory_usage_; }
+
+  void Save(const std::string& filename,
+            const HybridGridCellType cell_type) const override {
+    // 包括已写入磁盘缓存的地图块，按栅格编号排序
+    Cells cells;
+    for (const auto& cell : *this) cells.push_back(cell);
+    for (const auto& tile : tiles_) {
+      if (!tile.second.evicted) continue;
+      const Cells tile_cells =
+          ReadTile(tile_store_->Read(tile.second.slot), leaf_size_);
+      cells.insert(cells.end(), tile_cells.begin(), tile_cells.end());
     }
-    for (auto& cloud_in_grid : grid_set) {
-      filter.setInputCloud(cloud_in_grid);
-      filter.filter(*cloud_in_grid);
+    std::sort(cells.begin(), cells.end(),
+              [](const std::pair<Eigen::Array3i, CellPtr>& lhs,
+                 const std::pair<Eigen::Array3i, CellPtr>& rhs) {
+                return std::lexicographical_compare(
+                    lhs.first.data(), lhs.first.data() + 3, rhs.first.data(),
+                    rhs.first.data() + 3);
+              });
+
+    MapFileHeader header;
+    header.cell_type = static_cast<uint32_t>(cell_type);
+    header.resolution = this->resolution();
+    header.leaf_size = leaf_size_;
+    header.num_cells = cells.size();
+    header.cells_offset = sizeof(MapFileHeader);
+    header.points_offset = AlignMapFileOffset(
+        header.cells_offset + header.num_cells * sizeof(MapFileCell));
+    std::vector<MapFileCell> file_cells(cells.size());
+    for (size_t i = 0; i < cells.size(); ++i) {
+      MapFileCell& file_cell = file_cells[i];
+      file_cell.x = cells[i].first.x();
+      file_cell.y = cells[i].first.y();
+      file_cell.z = cells[i].first.z();
+      file_cell.num_points = cells[i].second->points().size();
+      file_cell.first_point = header.num_points;
+      header.num_points += file_cell.num_points;
     }
+
+    std::ofstream file(filename, std::ios::binary);
+    CHECK(file) << "Cannot open " << filename;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(file_cells.data()),
+               file_cells.size() * sizeof(MapFileCell));
+    const std::vector<char> padding(
+        header.points_offset - header.cells_offset -
+        file_cells.size() * sizeof(MapFileCell));
+    file.write(padding.data(), padding.size());
+    for (const auto& cell : cells) {
+      for (const PointType& point : cell.second->points()) {
+        PointType file_point;
+        file_point.x = point.x;
+        file_point.y = point.y;
+        file_point.z = point.z;
+        file_point.intensity = point.intensity;
+        file.write(reinterpret_cast<const char*>(&file_point),
+                   sizeof(PointType));
+      }
+    }
+    CHECK(file) << "Cannot write " << filename;
+    LOG(INFO) << "Saved " << header.num_cells << " cells and "
+              << header.num_points << " points to " << filename;
+  }
+
+  // Adds 'cell' at 'index', which must be empty.
+  void AttachCell(const Eigen::Array3i& index, const CellPtr& cell) {
+    AttachCell(index, cell, GetTile(index));
   }
 
  private:
-  void TryInsertGrid(Set& grid_set, const Eigen::Array3i& grid_id) {
-    auto cloud_in_grid = this->value(grid_id);
-    if (cloud_in_grid) {
-      grid_set.insert(cloud_in_grid);
+  void AttachCell(const Eigen::Array3i& index, const CellPtr& cell,
+                  Tile* const tile) {
+    *this->mutable_value(index) = cell;
+    tile->cells.push_back(index);
+    AddCellStatistics(*cell, tile);
+    if (has_active_window_ &&
+        IsInBox(index, active_min_index_, active_max_index_)) {
+      active_cells_.emplace_back(index, cell);
+    }
+  }
+
+  // Returns the tile of the cell at 'cell_index', creating it if necessary.
+  Tile* GetTile(const Eigen::Array3i& cell_index) {
+    const Eigen::Array3i tile_index = GetTileIndex(cell_index);
+    const auto result = tiles_.emplace(GetTileKey(tile_index), Tile());
+    if (result.second) result.first->second.index = tile_index;
+    return &result.first->second;
+  }
+
+  void AddCellStatistics(const CellType& cell, Tile* const tile) {
+    const size_t num_points = cell.points().size();
+    const size_t memory = cell.memory_usage();
+    num_points_ += num_points;
+    tile->num_points += num_points;
+    memory_usage_ += memory;
+    tile->memory += memory;
+  }
+
+  void RemoveCellStatistics(const CellType& cell, Tile* const tile) {
+    const size_t num_points = cell.points().size();
+    const size_t memory = cell.memory_usage();
+    num_points_ -= num_points;
+    tile->num_points -= num_points;
+    memory_usage_ -= memory;
+    tile->memory -= memory;
+  }
+
+  // Moves the window of active cells to be centered at 'center_index'. Cells
+  // leaving the window are dropped, only the cells entering it are looked up.
+  void UpdateActiveWindow(const Eigen::Array3i& center_index) {
+    const int radius = std::ceil(kSurroundDistance / this->resolution());
+    const Eigen::Array3i min_index = center_index - radius;
+    const Eigen::Array3i max_index = center_index + radius;
+    // 窗口内的地图块必须在内存中，相邻的地图块在后台预读
+    const Eigen::Array3i min_tile = GetTileIndex(min_index);
+    const Eigen::Array3i max_tile = GetTileIndex(max_index);
+    if (tile_store_) {
+      AttachLoadedTiles();
+      LoadTiles(min_tile - 1, max_tile + 1, min_tile, max_tile);
+    }
+
+    if (!has_active_window_ || (min_index != active_min_index_).any()) {
+      MoveActiveWindow(min_index, max_index);
+    }
+
+    if (tile_store_) EvictTiles(center_index, min_tile - 1, max_tile + 1);
+  }
+
+  void MoveActiveWindow(const Eigen::Array3i& min_index,
+                        const Eigen::Array3i& max_index) {
+    using Cell = std::pair<Eigen::Array3i, CellPtr>;
+    active_cells_.erase(
+        std::remove_if(active_cells_.begin(), active_cells_.end(),
+                       [&min_index, &max_index](const Cell& cell) {
+                         return !IsInBox(cell.first, min_index, max_index);
+                       }),
+        active_cells_.end());
+
+    // 只遍历新进入窗口的栅格，跳过与旧窗口重叠的 x 区间
+    const int skip_begin = std::max(min_index.x(), active_min_index_.x());
+    const int skip_end = std::min(max_index.x(), active_max_index_.x());
+    for (int z = min_index.z(); z <= max_index.z(); ++z) {
+      for (int y = min_index.y(); y <= max_index.y(); ++y) {
+        const bool yz_in_old_window =
+            has_active_window_ && z >= active_min_index_.z() &&
+            z <= active_max_index_.z() && y >= active_min_index_.y() &&
+            y <= active_max_index_.y() && skip_begin <= skip_end;
+        for (int x = min_index.x(); x <= max_index.x(); ++x) {
+          if (yz_in_old_window && x == skip_begin) {
+            x = skip_end;
+            continue;
+          }
+          const Eigen::Array3i index(x, y, z);
+          const CellPtr cell = this->value(index);
+          if (cell) active_cells_.emplace_back(index, cell);
+        }
+      }
+    }
+    active_min_index_ = min_index;
+    active_max_index_ = max_index;
+    has_active_window_ = true;
+  }
+
+  // Starts loading the evicted tiles in ['min_tile', 'max_tile'] and waits
+  // for those in ['min_required_tile', 'max_required_tile'].
+  void LoadTiles(const Eigen::Array3i& min_tile, const Eigen::Array3i& max_tile,
+                 const Eigen::Array3i& min_required_tile,
+                 const Eigen::Array3i& max_required_tile) {
+    for (int z = min_tile.z(); z <= max_tile.z(); ++z) {
+      for (int y = min_tile.y(); y <= max_tile.y(); ++y) {
+        for (int x = min_tile.x(); x <= max_tile.x(); ++x) {
+          const Eigen::Array3i tile_index(x, y, z);
+          const auto it = tiles_.find(GetTileKey(tile_index));
+          if (it == tiles_.end() || !it->second.evicted) continue;
+          Tile* const tile = &it->second;
+          if (IsInBox(tile_index, min_required_tile, max_required_tile)) {
+            EnsureResident(tile);
+          } else if (!tile->loading.valid()) {
+            const TileStore::Slot slot = tile->slot;
+            const float leaf_size = leaf_size_;
+            TileStore* const tile_store = tile_store_.get();
+            tile->loading =
+                std::async(std::launch::async, [tile_store, slot, leaf_size] {
+                  return ReadTile(tile_store->Read(slot), leaf_size);
+                });
+            loading_tiles_.push_back(tile);
+          }
+        }
+      }
+    }
+  }
+
+  // Attaches the tiles whose background load has finished.
+  void AttachLoadedTiles() {
+    for (auto it = loading_tiles_.begin(); it != loading_tiles_.end();) {
+      Tile* const tile = *it;
+      // Tiles which were needed earlier have been loaded already.
+      if (tile->loading.valid()) {
+        if (tile->loading.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+          ++it;
+          continue;
+        }
+        EnsureResident(tile);
+      }
+      it = loading_tiles_.erase(it);
+    }
+  }
+
+  // Loads an evicted 'tile', or waits for its background load.
+  void EnsureResident(Tile* const tile) {
+    if (!tile->evicted) return;
+    const Cells cells =
+        tile->loading.valid()
+            ? tile->loading.get()
+            : ReadTile(tile_store_->Read(tile->slot), leaf_size_);
+    tile->evicted = false;
+    // The statistics are counted again from the cells.
+    num_points_ -= tile->num_points;
+    tile->num_points = 0;
+    for (const auto& cell : cells) AttachCell(cell.first, cell.second, tile);
+  }
+
+  // Evicts resident tiles outside ['min_tile', 'max_tile'], farthest from
+  // 'center_index' first, until the memory budget is met.
+  void EvictTiles(const Eigen::Array3i& center_index,
+                  const Eigen::Array3i& min_tile,
+                  const Eigen::Array3i& max_tile) {
+    if (memory_usage_ <= memory_budget_) return;
+    const Eigen::Array3i center_tile = GetTileIndex(center_index);
+    std::vector<std::pair<int, Tile*>> candidates;
+    for (auto& tile : tiles_) {
+      if (tile.second.evicted || tile.second.cells.empty()) continue;
+      if (IsInBox(tile.second.index, min_tile, max_tile)) continue;
+      candidates.emplace_back(
+          (tile.second.index - center_tile).abs().maxCoeff(), &tile.second);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<int, Tile*>& lhs,
+                 const std::pair<int, Tile*>& rhs) {
+                return lhs.first > rhs.first;
+              });
+    for (const auto& candidate : candidates) {
+      if (memory_usage_ <= memory_budget_) break;
+      EvictTile(candidate.second);
+    }
+    LOG_IF_EVERY_N(WARNING, memory_usage_ > memory_budget_, 100)
+        << "Map memory " << memory_usage_ << " over budget " << memory_budget_
+        << " with all tiles around the pose resident.";
+  }
+
+  void EvictTile(Tile* const tile) {
+    std::vector<char> buffer;
+    AppendToBuffer<uint32_t>(tile->cells.size(), &buffer);
+    for (const Eigen::Array3i& index : tile->cells) {
+      CellPtr* const cell = this->mutable_value(index);
+      AppendToBuffer<int32_t>(index.x(), &buffer);
+      AppendToBuffer<int32_t>(index.y(), &buffer);
+      AppendToBuffer<int32_t>(index.z(), &buffer);
+      (*cell)->Write(&buffer);
+      cell->reset();
+    }
+    tile_store_->Write(buffer, &tile->slot);
+    memory_usage_ -= tile->memory;
+    tile->memory = 0;
+    tile->cells.clear();
+    tile->cells.shrink_to_fit();
+    tile->evicted = true;
+  }
+
+  static Cells ReadTile(const std::vector<char>& buffer,
+                        const float leaf_size) {
+    const char* data = buffer.data();
+    const uint32_t num_cells = ReadFromBuffer<uint32_t>(&data);
+    Cells cells(num_cells);
+    for (auto& cell : cells) {
+      const int x = ReadFromBuffer<int32_t>(&data);
+      const int y = ReadFromBuffer<int32_t>(&data);
+      const int z = ReadFromBuffer<int32_t>(&data);
+      cell.first = Eigen::Array3i(x, y, z);
+      cell.second = std::make_shared<CellType>(leaf_size);
+      cell.second->Read(&data);
+    }
+    CHECK_EQ(data, buffer.data() + buffer.size());
+    return cells;
+  }
+
+  // Merges the points of the cell at 'index' closer than the current k-th
+  // neighbour into 'neighbors', which is sorted by distance.
+  void SearchCell(const Eigen::Array3i& index, const Eigen::Array3f& position,
+                  const int k, const float max_squared_distance,
+                  std::vector<PointType>* const neighbors,
+                  std::vector<float>* const squared_distances) const {
+    const CellPtr cell = this->value(index);
+    if (!cell) return;
+    for (const PointType& point : cell->points()) {
+      const float squared_distance =
+          (point.getArray3fMap() - position).matrix().squaredNorm();
+      const bool is_full = static_cast<int>(neighbors->size()) == k;
+      if (squared_distance >=
+          (is_full ? squared_distances->back() : max_squared_distance)) {
+        continue;
+      }
+      if (is_full) {
+        neighbors->pop_back();
+        squared_distances->pop_back();
+      }
+      const auto it = std::upper_bound(squared_distances->begin(),
+                                       squared_distances->end(),
+                                       squared_distance);
+      neighbors->insert(neighbors->begin() + (it - squared_distances->begin()),
+                        point);
+      squared_distances->insert(it, squared_distance);
     }
   }
 
  private:
-  const double kDist = 60.0;
-  // const double kDistFlann = 1.1;
+  // 地图窗口的半宽：原始点的最大距离 60m 加上 1m 的邻域
+  const double kSurroundDistance = 61.0;
+  const float leaf_size_;
+  size_t num_points_ = 0;
+  size_t memory_usage_ = 0;
+
+  // Window of cells [min, max] around the last pose passed to
+  // 'UpdatePose()' and its non-empty cells.
+  bool has_active_window_ = false;
+  Eigen::Array3i active_min_index_;
+  Eigen::Array3i active_max_index_;
+  Cells active_cells_;
+
+  // 地图块及其磁盘缓存，没有内存限制时 'tile_store_' 为空
+  const size_t memory_budget_;
+  std::unique_ptr<TileStore> tile_store_;
+  std::unordered_map<uint64_t, Tile> tiles_;
+  std::vector<Tile*> loading_tiles_;
 };
 
-HybridGrid::HybridGrid(const float& resolution)
-    : hybrid_grid_(new HybridGridImpl(resolution)) {}
+}  // namespace
+
+HybridGrid::HybridGrid() {}
+
+HybridGrid::HybridGrid(const HybridGridOptions& options) : options_(options) {
+  switch (options.cell_type) {
+    case HybridGridCellType::kPointCloud:
+      hybrid_grid_.reset(new TypedHybridGrid<PointCloudCell>(options));
+      return;
+    case HybridGridCellType::kVoxelCentroid:
+      hybrid_grid_.reset(new TypedHybridGrid<VoxelCentroidCell>(options));
+      return;
+    case HybridGridCellType::kQuantized:
+      CHECK_LT(options.resolution, kMaxQuantizedResolution);
+      hybrid_grid_.reset(
+          new TypedHybridGrid<QuantizedCell<QuantizedXyz>>(options));
+      return;
+    case HybridGridCellType::kQuantizedWithIntensity:
+      CHECK_LT(options.resolution, kMaxQuantizedResolution);
+      hybrid_grid_.reset(
+          new TypedHybridGrid<QuantizedCell<QuantizedXyzI>>(options));
+      return;
+  }
+  LOG(FATAL) << "Unknown HybridGridCellType.";
+}
+
+HybridGrid::~HybridGrid() {}
+
+void HybridGrid::Save(const std::string& filename) const {
+  hybrid_grid_->Save(filename, options_.cell_type);
+}
+
+std::unique_ptr<HybridGrid> HybridGrid::Load(const std::string& filename) {
+  TicToc t_load;
+  std::shared_ptr<const MappedFile> file =
+      std::make_shared<MappedFile>(filename);
+  CHECK_GE(file->size(), sizeof(MapFileHeader)) << filename;
+  const MapFileHeader& header =
+      *reinterpret_cast<const MapFileHeader*>(file->data());
+  CHECK(std::equal(header.magic, header.magic + 8, kMapFileMagic))
+      << filename << " is not a map file.";
+  CHECK_EQ(header.version, kMapFileVersion) << filename;
+  CHECK_EQ(header.point_size, sizeof(PointType)) << filename;
+  CHECK_EQ(header.points_offset % alignof(PointType), 0) << filename;
+  CHECK_LE(header.cells_offset + header.num_cells * sizeof(MapFileCell),
+           header.points_offset)
+      << filename;
+  CHECK_LE(header.points_offset + header.num_points * sizeof(PointType),
+           file->size())
+      << filename << " is truncated.";
+
+  HybridGridOptions options;
+  options.resolution = header.resolution;
+  options.leaf_size = header.leaf_size;
+  options.cell_type = static_cast<HybridGridCellType>(header.cell_type);
+  auto* const grid = new TypedHybridGrid<MappedCell>(options);
+  const MapFileCell* const file_cells = reinterpret_cast<const MapFileCell*>(
+      file->data() + header.cells_offset);
+  const PointType* const points =
+      reinterpret_cast<const PointType*>(file->data() + header.points_offset);
+  for (uint64_t i = 0; i < header.num_cells; ++i) {
+    const MapFileCell& file_cell = file_cells[i];
+    CHECK_LE(file_cell.first_point + file_cell.num_points, header.num_points);
+    auto cell = std::make_shared<MappedCell>(options.leaf_size);
+    cell->Reset(points + file_cell.first_point, file_cell.num_points);
+    grid->AttachCell(Eigen::Array3i(file_cell.x, file_cell.y, file_cell.z),
+                     cell);
+  }
+
+  std::unique_ptr<HybridGrid> hybrid_grid(new HybridGrid);
+  hybrid_grid->options_ = options;
+  hybrid_grid->mapped_file_ = std::move(file);
+  hybrid_grid->hybrid_grid_.reset(grid);
+  LOG(INFO) << "Loaded " << header.num_cells << " cells and "
+            << header.num_points << " points from " << filename << " in "
+            << t_load.toc() << " ms.";
+  return hybrid_grid;
+}
+
+void HybridGrid::UpdatePose(const Rigid3d& pose) {
+  hybrid_grid_->UpdatePose(pose);
+}
 
-HybridGrid::~HybridGrid() { delete hybrid_grid_; }
+PointCloudPtr HybridGrid::GetSurroundedCloud(const Rigid3d& pose) {
+  return hybrid_grid_->GetSurroundedCloud(pose);
+}
 
-PointCloudPtr HybridGrid::GetSurroundedCloud(const PointCloudConstPtr& scan,
-                                             const Rigid3d& pose) {
-  return hybrid_grid_->GetSurroundedCloud(scan, pose);
+int HybridGrid::NearestKSearch(const PointType& point, const int k,
+                               const float max_squared_distance,
+                               std::vector<PointType>* const neighbors,
+                               std::vector<float>* const squared_distances)
+    const {
+  return hybrid_grid_->NearestKSearch(point, k, max_squared_distance,
+                                      neighbors, squared_distances);
 }
 
-void HybridGrid::InsertScan(const PointCloudPtr& scan,
-                            pcl::Filter<PointType>& filter) {
-  hybrid_grid_->InsertScan(scan, filter);
+void HybridGrid::InsertScan(const PointCloudConstPtr& scan) {
+  hybrid_grid_->InsertScan(scan);
+}
+
+size_t HybridGrid::num_points() const { return hybrid_grid_->num_points(); }
+
+size_t HybridGrid::memory_usage() const {
+  return hybrid_grid_->memory_usage();
 }
@@ -17,25 +17,95 @@
 #ifndef MSF_LOAM_VELODYNE_HYBRID_GRID_H
 #define MSF_LOAM_VELODYNE_HYBRID_GRID_H
 
-#include <pcl/filters/filter.h>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <common/rigid_transform.h>
 #include "common/common.h"
 
+enum class HybridGridCellType {
+  // 点云栅格，每次插入后用 pcl::VoxelGrid 重新降采样
+  kPointCloud,
+  // 增量体素栅格，见 VoxelCentroidCell
+  kVoxelCentroid,
+  // 与点云栅格相同，点压缩为 16 位定点坐标，见 QuantizedCell
+  kQuantized,
+  // Like kQuantized with 8 bits of the intensity.
+  kQuantizedWithIntensity,
+};
+
+struct HybridGridOptions {
+  // Edge length of the grid cells, less than kMaxQuantizedResolution for the
+  // quantized cell types.
+  float resolution = 3.f;
+  // Edge length of the voxels the points of a cell are downsampled to.
+  float leaf_size = 0.2f;
+  HybridGridCellType cell_type = HybridGridCellType::kPointCloud;
+  // Approximate memory of the cells in bytes, 0 for no limit. When exceeded,
+  // tiles of 16^3 cells away from the current pose are written to a file in
+  // 'tile_directory' and released.
+  size_t memory_budget = 0;
+  std::string tile_directory = "/tmp";
+};
+
 class HybridGridImpl;
+class MappedFile;
 
 class HybridGrid {
  public:
-  explicit HybridGrid(const float& resolution);
+  explicit HybridGrid(const HybridGridOptions& options);
   ~HybridGrid();
 
-  PointCloudPtr GetSurroundedCloud(const PointCloudConstPtr& scan,
-                                   const Rigid3d& pose);
+  // Moves the window of cells to 'pose'. With a memory budget, the tiles of
+  // the window are loaded, those next to it are prefetched in the background
+  // and the farthest tiles are evicted until the budget is met.
+  void UpdatePose(const Rigid3d& pose);
+
+  // Moves the window of cells like UpdatePose() and returns the points of
+  // all cells within 61 m of 'pose' along each axis.
+  // The window of cells is kept between calls and only updated by the cells
+  // entering and leaving it, so the cost of the lookup depends on the motion
+  // since the last call rather than on the window size.
+  PointCloudPtr GetSurroundedCloud(const Rigid3d& pose);
+
+  // Finds the 'k' points closest to 'point' among those with a squared
+  // distance less than 'max_squared_distance', searching the cell of 'point'
+  // and its 26 neighbours in place. Cells farther than the current k-th
+  // neighbour are skipped. The result is exact if 'max_squared_distance' is at
+  // most resolution^2. Returns the number of neighbours found, which are
+  // sorted by distance.
+  int NearestKSearch(const PointType& point, int k, float max_squared_distance,
+                     std::vector<PointType>* neighbors,
+                     std::vector<float>* squared_distances) const;
 
-  void InsertScan(const PointCloudPtr& scan, pcl::Filter<PointType>& filter);
+  // Adds the points of 'scan', given in the map frame, and downsamples the
+  // cells they fall into. Evicted tiles touched by the scan are loaded first.
+  void InsertScan(const PointCloudConstPtr& scan);
+
+  // Number of points, including those of evicted tiles.
+  size_t num_points() const;
+
+  // Approximate memory of the resident cells in bytes.
+  size_t memory_usage() const;
+
+  // Writes all cells to 'filename' in the binary map format: a versioned
+  // header, the cell table sorted by cell index and the points of every cell
+  // stored contiguously as PointType. Voxel counts are not stored, quantized
+  // points are stored decoded.
+  void Save(const std::string& filename) const;
+
+  // Maps a file written by Save() read-only. The returned grid references the
+  // points in the file instead of copying them and cannot be inserted into.
+  static std::unique_ptr<HybridGrid> Load(const std::string& filename);
 
  private:
-  HybridGridImpl* hybrid_grid_;
+  HybridGrid();
+
+  HybridGridOptions options_;
+  // Backs the cells of a loaded grid, destroyed after 'hybrid_grid_'.
+  std::shared_ptr<const MappedFile> mapped_file_;
+  std::unique_ptr<HybridGridImpl> hybrid_grid_;
 };
 
 #endif  // MSF_LOAM_VELODYNE_HYBRID_GRID_H
@@ -0,0 +1,276 @@
+#include "slam/hybrid_grid_cells.h"
+
+#include <glog/logging.h>
+#include <pcl/filters/voxel_grid.h>
+#include <cmath>
+#include <limits>
+
+#include "common/point_cloud_pool.h"
+#include "slam/tile_store.h"
+
+namespace {
+
+constexpr uint64_t kEmptyKey = ~uint64_t{0};
+constexpr int kIndexBits = 21;
+constexpr int64_t kIndexOffset = int64_t{1} << (kIndexBits - 1);
+constexpr int kInitialNumBits = 4;
+
+// Points are stored without the padding of PointType.
+void WritePoint(const PointType& point, std::vector<char>* const buffer) {
+  AppendToBuffer(point.x, buffer);
+  AppendToBuffer(point.y, buffer);
+  AppendToBuffer(point.z, buffer);
+  AppendToBuffer(point.intensity, buffer);
+}
+
+PointType ReadPoint(const char** const data) {
+  PointType point;
+  point.x = ReadFromBuffer<float>(data);
+  point.y = ReadFromBuffer<float>(data);
+  point.z = ReadFromBuffer<float>(data);
+  point.intensity = ReadFromBuffer<float>(data);
+  return point;
+}
+
+int16_t QuantizeOffset(const float offset) {
+  const long steps = std::lround(offset / kQuantizationStep);
+  CHECK_LE(std::abs(steps), std::numeric_limits<int16_t>::max())
+      << "Point too far from the cell origin.";
+  return static_cast<int16_t>(steps);
+}
+
+// The fields are written one by one without the padding.
+void WriteEncodedPoint(const QuantizedXyz& point,
+                       std::vector<char>* const buffer) {
+  AppendToBuffer(point.x, buffer);
+  AppendToBuffer(point.y, buffer);
+  AppendToBuffer(point.z, buffer);
+}
+
+void WriteEncodedPoint(const QuantizedXyzI& point,
+                       std::vector<char>* const buffer) {
+  AppendToBuffer(point.x, buffer);
+  AppendToBuffer(point.y, buffer);
+  AppendToBuffer(point.z, buffer);
+  AppendToBuffer(point.intensity, buffer);
+}
+
+void ReadEncodedPoint(const char** const data, QuantizedXyz* const point) {
+  point->x = ReadFromBuffer<int16_t>(data);
+  point->y = ReadFromBuffer<int16_t>(data);
+  point->z = ReadFromBuffer<int16_t>(data);
+}
+
+void ReadEncodedPoint(const char** const data, QuantizedXyzI* const point) {
+  point->x = ReadFromBuffer<int16_t>(data);
+  point->y = ReadFromBuffer<int16_t>(data);
+  point->z = ReadFromBuffer<int16_t>(data);
+  point->intensity = ReadFromBuffer<uint8_t>(data);
+}
+
+// Fibonacci hashing, 'num_bits' is log2 of the table size.
+inline size_t HashKey(const uint64_t key, const int num_bits) {
+  return (key * 0x9E3779B97F4A7C15ull) >> (64 - num_bits);
+}
+
+}  // namespace
+
+PointCloudCell::PointCloudCell(const float leaf_size)
+    : leaf_size_(leaf_size), points_(new PointCloud) {}
+
+void PointCloudCell::Finish() {
+  pcl::VoxelGrid<PointType> filter;
+  filter.setLeafSize(leaf_size_, leaf_size_, leaf_size_);
+  filter.setInputCloud(points_);
+  filter.filter(*points_);
+}
+
+size_t PointCloudCell::memory_usage() const {
+  return sizeof(*this) + sizeof(PointCloud) +
+         points_->points.capacity() * sizeof(PointType);
+}
+
+void PointCloudCell::Write(std::vector<char>* const buffer) const {
+  AppendToBuffer<uint32_t>(points_->size(), buffer);
+  for (const PointType& point : *points_) WritePoint(point, buffer);
+}
+
+void PointCloudCell::Read(const char** const data) {
+  const uint32_t num_points = ReadFromBuffer<uint32_t>(data);
+  points_->clear();
+  points_->reserve(num_points);
+  for (uint32_t i = 0; i < num_points; ++i) {
+    points_->push_back(ReadPoint(data));
+  }
+}
+
+VoxelCentroidCell::VoxelCentroidCell(const float leaf_size)
+    : inverse_leaf_size_(1.f / leaf_size) {
+  CHECK_GT(leaf_size, 0.f);
+}
+
+uint64_t VoxelCentroidCell::VoxelKey(const PointType& point) const {
+  const int64_t i = std::floor(point.x * inverse_leaf_size_) + kIndexOffset;
+  const int64_t j = std::floor(point.y * inverse_leaf_size_) + kIndexOffset;
+  const int64_t k = std::floor(point.z * inverse_leaf_size_) + kIndexOffset;
+  return (static_cast<uint64_t>(i) << (2 * kIndexBits)) |
+         (static_cast<uint64_t>(j) << kIndexBits) | static_cast<uint64_t>(k);
+}
+
+void VoxelCentroidCell::Insert(const PointType& point) {
+  // The table is kept at most half full.
+  if (2 * (points_.size() + 1) > keys_.size()) Grow();
+  const uint64_t key = VoxelKey(point);
+  const size_t mask = keys_.size() - 1;
+  size_t slot = HashKey(key, num_bits_);
+  while (keys_[slot] != kEmptyKey && keys_[slot] != key) {
+    slot = (slot + 1) & mask;
+  }
+  if (keys_[slot] == kEmptyKey) {
+    keys_[slot] = key;
+    voxel_indices_[slot] = points_.size();
+    points_.push_back(point);
+    num_points_.push_back(1);
+    voxel_keys_.push_back(key);
+    return;
+  }
+
+  // 更新体素中心的滑动平均
+  const int index = voxel_indices_[slot];
+  PointType& centroid = points_[index];
+  const float weight = 1.f / ++num_points_[index];
+  centroid.x += (point.x - centroid.x) * weight;
+  centroid.y += (point.y - centroid.y) * weight;
+  centroid.z += (point.z - centroid.z) * weight;
+  centroid.intensity += (point.intensity - centroid.intensity) * weight;
+}
+
+void VoxelCentroidCell::Grow() {
+  num_bits_ = num_bits_ == 0 ? kInitialNumBits : num_bits_ + 1;
+  const size_t mask = (size_t{1} << num_bits_) - 1;
+  keys_.assign(mask + 1, kEmptyKey);
+  voxel_indices_.resize(mask + 1);
+  for (size_t i = 0; i < points_.size(); ++i) {
+    // The centroid may be rounded into the next voxel, use the stored key.
+    const uint64_t key = voxel_keys_[i];
+    size_t slot = HashKey(key, num_bits_);
+    while (keys_[slot] != kEmptyKey) slot = (slot + 1) & mask;
+    keys_[slot] = key;
+    voxel_indices_[slot] = i;
+  }
+}
+
+size_t VoxelCentroidCell::memory_usage() const {
+  return sizeof(*this) + points_.points.capacity() * sizeof(PointType) +
+         num_points_.capacity() * sizeof(int) +
+         voxel_keys_.capacity() * sizeof(uint64_t) +
+         keys_.capacity() * sizeof(uint64_t) +
+         voxel_indices_.capacity() * sizeof(int);
+}
+
+void VoxelCentroidCell::Write(std::vector<char>* const buffer) const {
+  AppendToBuffer<uint32_t>(points_.size(), buffer);
+  for (size_t i = 0; i < points_.size(); ++i) {
+    WritePoint(points_[i], buffer);
+    AppendToBuffer(num_points_[i], buffer);
+    AppendToBuffer(voxel_keys_[i], buffer);
+  }
+}
+
+void VoxelCentroidCell::Read(const char** const data) {
+  const uint32_t num_voxels = ReadFromBuffer<uint32_t>(data);
+  points_.clear();
+  num_points_.clear();
+  voxel_keys_.clear();
+  points_.reserve(num_voxels);
+  num_points_.reserve(num_voxels);
+  voxel_keys_.reserve(num_voxels);
+  for (uint32_t i = 0; i < num_voxels; ++i) {
+    points_.push_back(ReadPoint(data));
+    num_points_.push_back(ReadFromBuffer<int>(data));
+    voxel_keys_.push_back(ReadFromBuffer<uint64_t>(data));
+  }
+  // Rebuilds the hash table at the smallest size at most half full.
+  num_bits_ = kInitialNumBits - 1;
+  while ((size_t{1} << (num_bits_ + 1)) < 2 * (points_.size() + 1)) {
+    ++num_bits_;
+  }
+  Grow();
+}
+
+template <typename EncodedPoint>
+QuantizedCell<EncodedPoint>::QuantizedCell(const float leaf_size)
+    : leaf_size_(leaf_size) {}
+
+template <typename EncodedPoint>
+EncodedPoint QuantizedCell<EncodedPoint>::Encode(
+    const PointType& point) const {
+  EncodedPoint encoded;
+  encoded.x = QuantizeOffset(point.x - origin_.x());
+  encoded.y = QuantizeOffset(point.y - origin_.y());
+  encoded.z = QuantizeOffset(point.z - origin_.z());
+  EncodeIntensity(point, &encoded);
+  return encoded;
+}
+
+template <typename EncodedPoint>
+void QuantizedCell<EncodedPoint>::Insert(const PointType& point) {
+  if (points_.empty()) origin_ = point.getVector3fMap();
+  points_.push_back(Encode(point));
+}
+
+template <typename EncodedPoint>
+void QuantizedCell<EncodedPoint>::Finish() {
+  // 解码后降采样，再按降采样后的点数重新编码
+  const PointCloudPtr cloud = AcquirePointCloud(points_.size());
+  for (const PointType& point : points()) cloud->push_back(point);
+  pcl::VoxelGrid<PointType> filter;
+  filter.setLeafSize(leaf_size_, leaf_size_, leaf_size_);
+  filter.setInputCloud(cloud);
+  filter.filter(*cloud);
+  std::vector<EncodedPoint> points;
+  points.reserve(cloud->size());
+  for (const PointType& point : *cloud) points.push_back(Encode(point));
+  points_.swap(points);
+}
+
+template <typename EncodedPoint>
+size_t QuantizedCell<EncodedPoint>::memory_usage() const {
+  return sizeof(*this) + points_.capacity() * sizeof(EncodedPoint);
+}
+
+template <typename EncodedPoint>
+void QuantizedCell<EncodedPoint>::Write(
+    std::vector<char>* const buffer) const {
+  AppendToBuffer(origin_.x(), buffer);
+  AppendToBuffer(origin_.y(), buffer);
+  AppendToBuffer(origin_.z(), buffer);
+  AppendToBuffer<uint32_t>(points_.size(), buffer);
+  for (const EncodedPoint& point : points_) WriteEncodedPoint(point, buffer);
+}
+
+template <typename EncodedPoint>
+void QuantizedCell<EncodedPoint>::Read(const char** const data) {
+  origin_.x() = ReadFromBuffer<float>(data);
+  origin_.y() = ReadFromBuffer<float>(data);
+  origin_.z() = ReadFromBuffer<float>(data);
+  const uint32_t num_points = ReadFromBuffer<uint32_t>(data);
+  points_.resize(num_points);
+  for (EncodedPoint& point : points_) ReadEncodedPoint(data, &point);
+}
+
+template class QuantizedCell<QuantizedXyz>;
+template class QuantizedCell<QuantizedXyzI>;
+
+void MappedCell::Insert(const PointType& point) {
+  LOG(FATAL) << "Cannot insert into a map loaded from a file.";
+}
+
+void MappedCell::Write(std::vector<char>* const buffer) const {
+  AppendToBuffer<uint32_t>(points_.size(), buffer);
+  for (const PointType& point : points_) WritePoint(point, buffer);
+}
+
+void MappedCell::Read(const char** const data) {
+  LOG(FATAL) << "Cannot evict a map loaded from a file.";
+}
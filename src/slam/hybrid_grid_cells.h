@@ -0,0 +1,250 @@
+#ifndef MSF_LOAM_VELODYNE_HYBRID_GRID_CELLS_H
+#define MSF_LOAM_VELODYNE_HYBRID_GRID_CELLS_H
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "common/common.h"
+
+// Cell types of HybridGrid. A cell holds the map points falling into one grid
+// cell, downsampled to voxels of 'leaf_size'. Every cell type provides
+//
+//   explicit Cell(float leaf_size);
+//   void Insert(const PointType& point);
+//   void Finish();  // called once after the points of a scan were inserted
+//   const PointCloud& points() const;  // or a PointRange
+//   size_t memory_usage() const;  // approximate heap memory in bytes
+//   void Write(std::vector<char>* buffer) const;  // appends the cell
+//   void Read(const char** data);  // restores a written cell
+
+// A contiguous range of points not owned by the range.
+struct PointRange {
+  const PointType* data = nullptr;
+  size_t num_points = 0;
+
+  const PointType* begin() const { return data; }
+  const PointType* end() const { return data + num_points; }
+  size_t size() const { return num_points; }
+};
+
+/**
+ * @brief 原始的栅格类型：点云 + pcl::VoxelGrid
+ *
+ * New points are appended and the whole cell is downsampled again with
+ * pcl::VoxelGrid in Finish(), i.e. the centroid of a voxel weighs the
+ * previous centroid like a single new point.
+ */
+class PointCloudCell {
+ public:
+  explicit PointCloudCell(float leaf_size);
+
+  void Insert(const PointType& point) { points_->push_back(point); }
+  void Finish();
+
+  const PointCloud& points() const { return *points_; }
+
+  size_t memory_usage() const;
+  void Write(std::vector<char>* buffer) const;
+  void Read(const char** data);
+
+ private:
+  const float leaf_size_;
+  PointCloudPtr points_;
+};
+
+/**
+ * @brief 增量体素栅格类型
+ *
+ * Keeps the running centroid and number of points of every voxel, found in a
+ * small open addressing hash table. Inserting a point updates or creates one
+ * voxel in O(1), nothing is filtered again. Voxels are aligned like those of
+ * pcl::VoxelGrid, but all points inserted into a voxel weigh the same.
+ */
+class VoxelCentroidCell {
+ public:
+  explicit VoxelCentroidCell(float leaf_size);
+
+  void Insert(const PointType& point);
+  void Finish() {}
+
+  const PointCloud& points() const { return points_; }
+
+  size_t memory_usage() const;
+  void Write(std::vector<char>* buffer) const;
+  void Read(const char** data);
+
+ private:
+  uint64_t VoxelKey(const PointType& point) const;
+  void Grow();
+
+  const float inverse_leaf_size_;
+  // 体素中心点、点数和体素编号，顺序相同
+  PointCloud points_;
+  std::vector<int> num_points_;
+  std::vector<uint64_t> voxel_keys_;
+  // Hash table of voxel keys and the indices of the voxels in 'points_'.
+  int num_bits_ = 0;
+  std::vector<uint64_t> keys_;
+  std::vector<int> voxel_indices_;
+};
+
+// Step of the fixed-point coordinates of QuantizedCell in m. Offsets from the
+// origin of a cell are limited to +/- 32767 steps, which bounds the cell
+// resolution.
+constexpr float kQuantizationStep = 1e-3f;
+constexpr float kMaxQuantizedResolution = 32767 * kQuantizationStep;
+
+// 压缩的地图点：相对栅格原点的 16 位定点坐标
+struct QuantizedXyz {
+  int16_t x, y, z;
+};
+
+// Like QuantizedXyz with the integer part of the intensity, i.e. the ring,
+// clamped to [0, 255].
+struct QuantizedXyzI {
+  int16_t x, y, z;
+  uint8_t intensity;
+};
+
+inline void EncodeIntensity(const PointType& point,
+                            QuantizedXyz* const encoded) {}
+
+inline void EncodeIntensity(const PointType& point,
+                            QuantizedXyzI* const encoded) {
+  encoded->intensity = static_cast<uint8_t>(
+      std::min(std::max(std::floor(point.intensity), 0.f), 255.f));
+}
+
+inline void DecodeIntensity(const QuantizedXyz& encoded,
+                            PointType* const point) {}
+
+inline void DecodeIntensity(const QuantizedXyzI& encoded,
+                            PointType* const point) {
+  point->intensity = encoded.intensity;
+}
+
+// Decodes points of a QuantizedCell on the fly, dereferencing an iterator
+// returns a PointType by value.
+template <typename EncodedPoint>
+class DecodedPointRange {
+ public:
+  class Iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = PointType;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const PointType*;
+    using reference = PointType;
+
+    Iterator(const Eigen::Vector3f& origin, const EncodedPoint* const encoded)
+        : origin_(origin), encoded_(encoded) {}
+
+    PointType operator*() const {
+      PointType point;
+      point.x = origin_.x() + encoded_->x * kQuantizationStep;
+      point.y = origin_.y() + encoded_->y * kQuantizationStep;
+      point.z = origin_.z() + encoded_->z * kQuantizationStep;
+      DecodeIntensity(*encoded_, &point);
+      return point;
+    }
+
+    Iterator& operator++() {
+      ++encoded_;
+      return *this;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return encoded_ == other.encoded_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return encoded_ != other.encoded_;
+    }
+
+   private:
+    Eigen::Vector3f origin_;
+    const EncodedPoint* encoded_;
+  };
+
+  DecodedPointRange(const Eigen::Vector3f& origin, const EncodedPoint* data,
+                    const size_t num_points)
+      : origin_(origin), data_(data), num_points_(num_points) {}
+
+  Iterator begin() const { return Iterator(origin_, data_); }
+  Iterator end() const { return Iterator(origin_, data_ + num_points_); }
+  size_t size() const { return num_points_; }
+
+ private:
+  Eigen::Vector3f origin_;
+  const EncodedPoint* data_;
+  size_t num_points_;
+};
+
+/**
+ * @brief 压缩栅格类型：16 位定点坐标
+ *
+ * Behaves like PointCloudCell, but stores the points as 'EncodedPoint', i.e.
+ * 16-bit offsets in steps of kQuantizationStep from the first point inserted
+ * into the cell, 6 bytes per point instead of the 32 bytes of PointType.
+ * QuantizedXyzI keeps 8 bits of the intensity in 8 bytes, QuantizedXyz drops
+ * it. The points are decoded on the fly by points(), Finish() decodes them
+ * for pcl::VoxelGrid and encodes the result again.
+ */
+template <typename EncodedPoint>
+class QuantizedCell {
+ public:
+  explicit QuantizedCell(float leaf_size);
+
+  void Insert(const PointType& point);
+  void Finish();
+
+  DecodedPointRange<EncodedPoint> points() const {
+    return {origin_, points_.data(), points_.size()};
+  }
+
+  size_t memory_usage() const;
+  void Write(std::vector<char>* buffer) const;
+  void Read(const char** data);
+
+ private:
+  EncodedPoint Encode(const PointType& point) const;
+
+  const float leaf_size_;
+  // 栅格原点，第一个插入的点
+  Eigen::Vector3f origin_ = Eigen::Vector3f::Zero();
+  std::vector<EncodedPoint> points_;
+};
+
+/**
+ * @brief 只读栅格类型，点在内存映射的地图文件中
+ *
+ * The points are owned by whoever mapped them, see HybridGrid::Load().
+ * Inserting points or reading a cell from a tile is a fatal error.
+ */
+class MappedCell {
+ public:
+  explicit MappedCell(float leaf_size) {}
+
+  void Reset(const PointType* const points, const size_t num_points) {
+    points_.data = points;
+    points_.num_points = num_points;
+  }
+
+  void Insert(const PointType& point);
+  void Finish() {}
+
+  const PointRange& points() const { return points_; }
+
+  size_t memory_usage() const { return sizeof(*this); }
+  void Write(std::vector<char>* buffer) const;
+  void Read(const char** data);
+
+ private:
+  PointRange points_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_HYBRID_GRID_CELLS_H
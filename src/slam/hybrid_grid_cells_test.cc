@@ -0,0 +1,121 @@
+#include "slam/hybrid_grid_cells.h"
+
+#include <gtest/gtest.h>
+#include <array>
+#include <cmath>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr float kLeafSize = 0.2f;
+constexpr float kInverseLeafSize = 1.f / kLeafSize;
+
+struct VoxelAverage {
+  Eigen::Vector4d sum = Eigen::Vector4d::Zero();
+  int num_points = 0;
+};
+
+TEST(VoxelCentroidCellTest, MatchesBruteForceVoxelAverage) {
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> coordinate(-1.5f, 1.5f);
+  std::uniform_real_distribution<float> intensity(0.f, 16.f);
+  VoxelCentroidCell cell(kLeafSize);
+  // Voxels aligned like pcl::VoxelGrid, in the order of their first point,
+  // computed like VoxelCentroidCell so that points on a voxel boundary agree.
+  std::map<std::array<int, 3>, int> voxel_indices;
+  std::vector<VoxelAverage> expected;
+  for (int s = 0; s < 5; ++s) {
+    for (int i = 0; i < 4000; ++i) {
+      PointType point;
+      point.x = coordinate(rng);
+      point.y = coordinate(rng);
+      point.z = coordinate(rng);
+      point.intensity = intensity(rng);
+      cell.Insert(point);
+      const std::array<int, 3> voxel = {
+          {static_cast<int>(std::floor(point.x * kInverseLeafSize)),
+           static_cast<int>(std::floor(point.y * kInverseLeafSize)),
+           static_cast<int>(std::floor(point.z * kInverseLeafSize))}};
+      const auto it = voxel_indices.emplace(voxel, expected.size()).first;
+      if (it->second == static_cast<int>(expected.size())) {
+        expected.emplace_back();
+      }
+      VoxelAverage& average = expected[it->second];
+      average.sum +=
+          Eigen::Vector4d(point.x, point.y, point.z, point.intensity);
+      ++average.num_points;
+    }
+    cell.Finish();
+  }
+
+  // Also after a round trip through the tile format.
+  std::vector<char> buffer;
+  cell.Write(&buffer);
+  VoxelCentroidCell read_cell(kLeafSize);
+  const char* data = buffer.data();
+  read_cell.Read(&data);
+  EXPECT_EQ(buffer.data() + buffer.size(), data);
+
+  for (const VoxelCentroidCell* c : {&cell, &read_cell}) {
+    const PointCloud& points = c->points();
+    ASSERT_EQ(expected.size(), points.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      const Eigen::Vector4d centroid =
+          expected[i].sum / expected[i].num_points;
+      EXPECT_NEAR(centroid[0], points[i].x, 1e-5);
+      EXPECT_NEAR(centroid[1], points[i].y, 1e-5);
+      EXPECT_NEAR(centroid[2], points[i].z, 1e-5);
+      EXPECT_NEAR(centroid[3], points[i].intensity, 1e-4);
+    }
+  }
+}
+
+TEST(QuantizedCellTest, BoundsErrorAndKeepsRing) {
+  std::mt19937 rng(13);
+  // Offsets from the first point up to the cell resolution of 3 m.
+  std::uniform_real_distribution<float> coordinate(-1.5f, 1.5f);
+  std::uniform_int_distribution<int> ring(0, 127);
+  std::uniform_real_distribution<float> time(0.f, 0.0999f);
+  QuantizedCell<QuantizedXyzI> cell(kLeafSize);
+  PointCloud inserted;
+  for (int i = 0; i < 10000; ++i) {
+    PointType point;
+    point.x = 100.f + coordinate(rng);
+    point.y = -50.f + coordinate(rng);
+    point.z = coordinate(rng);
+    // The intensity holds ring + time, a time close to a full sweep must
+    // not round the ring up.
+    point.intensity = ring(rng) + (i % 10 == 0 ? 0.9999f : time(rng));
+    cell.Insert(point);
+    inserted.push_back(point);
+  }
+
+  std::vector<char> buffer;
+  cell.Write(&buffer);
+  QuantizedCell<QuantizedXyzI> read_cell(kLeafSize);
+  const char* data = buffer.data();
+  read_cell.Read(&data);
+
+  // Rounding to the step and the float arithmetic of the decoding.
+  const float max_error = 0.5f * kQuantizationStep + 1e-5f;
+  for (const QuantizedCell<QuantizedXyzI>* c : {&cell, &read_cell}) {
+    ASSERT_EQ(inserted.size(), c->points().size());
+    size_t i = 0;
+    for (const PointType& point : c->points()) {
+      const PointType& expected = inserted[i++];
+      EXPECT_NEAR(expected.x, point.x, max_error);
+      EXPECT_NEAR(expected.y, point.y, max_error);
+      EXPECT_NEAR(expected.z, point.z, max_error);
+      EXPECT_EQ(std::floor(expected.intensity), point.intensity);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,282 @@
+#include "slam/hybrid_grid.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <tuple>
+
+namespace {
+
+constexpr float kResolution = 3.f;
+
+float SquaredDistance(const PointType& a, const PointType& b) {
+  return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) +
+         (a.z - b.z) * (a.z - b.z);
+}
+
+// Index of the grid cell of 'point', the cells being centered at multiples
+// of the resolution.
+Eigen::Array3i CellIndex(const PointType& point) {
+  return Eigen::Array3i(std::lround(point.x / kResolution),
+                        std::lround(point.y / kResolution),
+                        std::lround(point.z / kResolution));
+}
+
+// Inserts 'num_points' random points in a box of 4 x 4 x 2 cells.
+std::unique_ptr<HybridGrid> MakeGrid(const HybridGridCellType cell_type,
+                                     const int num_points,
+                                     std::mt19937* const rng) {
+  HybridGridOptions options;
+  options.resolution = kResolution;
+  options.leaf_size = 0.2f;
+  options.cell_type = cell_type;
+  std::unique_ptr<HybridGrid> grid(new HybridGrid(options));
+  std::uniform_real_distribution<float> xy(-6.f, 6.f);
+  std::uniform_real_distribution<float> z(-3.f, 3.f);
+  for (int s = 0; s < 4; ++s) {
+    PointCloudPtr scan(new PointCloud);
+    for (int i = 0; i < num_points / 4; ++i) {
+      PointType point;
+      point.x = xy(*rng);
+      point.y = xy(*rng);
+      point.z = z(*rng);
+      // Ring 3, the time differs between the scans
+      point.intensity = 3.f + 0.1f * s;
+      scan->push_back(point);
+    }
+    grid->InsertScan(scan);
+  }
+  return grid;
+}
+
+class NearestKSearchTest
+    : public ::testing::TestWithParam<HybridGridCellType> {};
+
+TEST_P(NearestKSearchTest, MatchesBruteForceAcrossCells) {
+  std::mt19937 rng(5);
+  const std::unique_ptr<HybridGrid> grid = MakeGrid(GetParam(), 4000, &rng);
+  grid->UpdatePose(Rigid3d());
+  const PointCloudPtr map_points = grid->GetSurroundedCloud(Rigid3d());
+  ASSERT_EQ(grid->num_points(), map_points->size());
+
+  constexpr int kK = 5;
+  constexpr float kMaxSquaredDistance = 1.f;
+  // Half of the queries are next to a cell boundary, i.e. an odd multiple of
+  // half the resolution.
+  std::uniform_real_distribution<float> coordinate(-5.f, 5.f);
+  std::uniform_int_distribution<int> boundary(-2, 1);
+  std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+  std::vector<PointType> neighbors;
+  std::vector<float> squared_distances;
+  std::vector<float> expected;
+  int num_crossing = 0;
+  for (int q = 0; q < 1000; ++q) {
+    PointType query;
+    query.x = coordinate(rng);
+    query.y = coordinate(rng);
+    query.z = 0.5f * coordinate(rng);
+    if (q % 2 == 0) {
+      query.x = (boundary(rng) + 0.5f) * kResolution + offset(rng);
+    }
+
+    expected.clear();
+    for (const PointType& point : map_points->points) {
+      const float squared_distance = SquaredDistance(point, query);
+      if (squared_distance < kMaxSquaredDistance) {
+        expected.push_back(squared_distance);
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+    expected.resize(std::min<size_t>(kK, expected.size()));
+
+    const int num_found = grid->NearestKSearch(
+        query, kK, kMaxSquaredDistance, &neighbors, &squared_distances);
+    ASSERT_EQ(static_cast<int>(expected.size()), num_found) << "query " << q;
+    for (int i = 0; i < num_found; ++i) {
+      EXPECT_NEAR(expected[i], squared_distances[i], 1e-6f);
+      EXPECT_NEAR(squared_distances[i], SquaredDistance(neighbors[i], query),
+                  1e-6f);
+      if ((CellIndex(neighbors[i]) != CellIndex(query)).any()) ++num_crossing;
+    }
+  }
+  EXPECT_GT(num_crossing, 100);
+}
+
+bool PointLess(const PointType& a, const PointType& b) {
+  return std::tie(a.x, a.y, a.z, a.intensity) <
+         std::tie(b.x, b.y, b.z, b.intensity);
+}
+
+// Points of all cells, sorted.
+std::vector<PointType> SortedPoints(HybridGrid* const grid) {
+  const PointCloudPtr cloud = grid->GetSurroundedCloud(Rigid3d());
+  std::vector<PointType> points(cloud->points.begin(), cloud->points.end());
+  std::sort(points.begin(), points.end(), PointLess);
+  return points;
+}
+
+class SaveLoadTest : public ::testing::TestWithParam<HybridGridCellType> {};
+
+TEST_P(SaveLoadTest, LoadedGridMatchesSavedGrid) {
+  std::mt19937 rng(9);
+  const std::unique_ptr<HybridGrid> grid = MakeGrid(GetParam(), 4000, &rng);
+  const std::string filename = "/tmp/hybrid_grid_test_" +
+                               std::to_string(getpid()) + "_" +
+                               std::to_string(static_cast<int>(GetParam())) +
+                               ".grid";
+  grid->Save(filename);
+  const std::unique_ptr<HybridGrid> loaded = HybridGrid::Load(filename);
+  EXPECT_EQ(grid->num_points(), loaded->num_points());
+
+  const std::vector<PointType> points = SortedPoints(grid.get());
+  const std::vector<PointType> loaded_points = SortedPoints(loaded.get());
+  ASSERT_EQ(points.size(), loaded_points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    EXPECT_EQ(points[i].x, loaded_points[i].x);
+    EXPECT_EQ(points[i].y, loaded_points[i].y);
+    EXPECT_EQ(points[i].z, loaded_points[i].z);
+    EXPECT_EQ(points[i].intensity, loaded_points[i].intensity);
+  }
+
+  std::uniform_real_distribution<float> coordinate(-5.f, 5.f);
+  std::vector<PointType> neighbors;
+  std::vector<float> squared_distances;
+  std::vector<PointType> loaded_neighbors;
+  std::vector<float> loaded_squared_distances;
+  for (int q = 0; q < 200; ++q) {
+    PointType query;
+    query.x = coordinate(rng);
+    query.y = coordinate(rng);
+    query.z = 0.5f * coordinate(rng);
+    const int num_found =
+        grid->NearestKSearch(query, 5, 1.f, &neighbors, &squared_distances);
+    ASSERT_EQ(num_found,
+              loaded->NearestKSearch(query, 5, 1.f, &loaded_neighbors,
+                                     &loaded_squared_distances));
+    for (int i = 0; i < num_found; ++i) {
+      EXPECT_EQ(squared_distances[i], loaded_squared_distances[i]);
+    }
+  }
+  std::remove(filename.c_str());
+}
+
+class MemoryBudgetTest : public ::testing::TestWithParam<HybridGridCellType> {
+};
+
+// Drives two loops of a circle with a diameter of 400 m, much larger than the
+// 5^3 tiles kept around the pose, so the budgeted grid evicts the tiles behind
+// it and loads them again on the second loop.
+TEST_P(MemoryBudgetTest, MatchesUnbudgetedGrid) {
+  HybridGridOptions options;
+  options.resolution = kResolution;
+  options.leaf_size = 0.2f;
+  options.cell_type = GetParam();
+  HybridGrid grid(options);
+  options.memory_budget = 1;
+  options.tile_directory = "/tmp";
+  HybridGrid budgeted_grid(options);
+
+  constexpr double kRadius = 200.;
+  constexpr int kNumSteps = 300;
+  std::mt19937 rng(12);
+  std::uniform_real_distribution<float> offset(-30.f, 30.f);
+  std::uniform_real_distribution<float> query_offset(-5.f, 5.f);
+  std::vector<PointType> neighbors;
+  std::vector<float> squared_distances;
+  std::vector<PointType> budgeted_neighbors;
+  std::vector<float> budgeted_squared_distances;
+  bool evicted = false;
+  for (int step = 0; step < 2 * kNumSteps; ++step) {
+    const double angle = 2. * M_PI * step / kNumSteps;
+    const Rigid3d pose(
+        Eigen::Vector3d(kRadius * std::cos(angle), kRadius * std::sin(angle),
+                        0.),
+        Eigen::Quaterniond::Identity());
+    grid.UpdatePose(pose);
+    budgeted_grid.UpdatePose(pose);
+    evicted |= budgeted_grid.memory_usage() < grid.memory_usage();
+
+    for (int q = 0; q < 20; ++q) {
+      PointType query;
+      query.x = pose.translation().x() + query_offset(rng);
+      query.y = pose.translation().y() + query_offset(rng);
+      query.z = query_offset(rng);
+      const int num_found =
+          grid.NearestKSearch(query, 5, 1.f, &neighbors, &squared_distances);
+      ASSERT_EQ(num_found, budgeted_grid.NearestKSearch(
+                               query, 5, 1.f, &budgeted_neighbors,
+                               &budgeted_squared_distances))
+          << "step " << step;
+      for (int i = 0; i < num_found; ++i) {
+        EXPECT_EQ(squared_distances[i], budgeted_squared_distances[i]);
+      }
+    }
+
+    PointCloudPtr scan(new PointCloud);
+    for (int i = 0; i < 100; ++i) {
+      PointType point;
+      point.x = pose.translation().x() + offset(rng);
+      point.y = pose.translation().y() + offset(rng);
+      point.z = 0.1f * offset(rng);
+      point.intensity = 3.f;
+      scan->push_back(point);
+    }
+    grid.InsertScan(scan);
+    budgeted_grid.InsertScan(scan);
+    ASSERT_EQ(grid.num_points(), budgeted_grid.num_points()) << "step " << step;
+  }
+  EXPECT_TRUE(evicted);
+
+  for (int step = 0; step < kNumSteps; step += 10) {
+    const double angle = 2. * M_PI * step / kNumSteps;
+    const Rigid3d pose(
+        Eigen::Vector3d(kRadius * std::cos(angle), kRadius * std::sin(angle),
+                        0.),
+        Eigen::Quaterniond::Identity());
+    const PointCloudPtr cloud = grid.GetSurroundedCloud(pose);
+    const PointCloudPtr budgeted_cloud = budgeted_grid.GetSurroundedCloud(pose);
+    std::vector<PointType> points(cloud->points.begin(), cloud->points.end());
+    std::vector<PointType> budgeted_points(budgeted_cloud->points.begin(),
+                                           budgeted_cloud->points.end());
+    std::sort(points.begin(), points.end(), PointLess);
+    std::sort(budgeted_points.begin(), budgeted_points.end(), PointLess);
+    ASSERT_EQ(points.size(), budgeted_points.size()) << "step " << step;
+    for (size_t i = 0; i < points.size(); ++i) {
+      EXPECT_EQ(points[i].x, budgeted_points[i].x);
+      EXPECT_EQ(points[i].y, budgeted_points[i].y);
+      EXPECT_EQ(points[i].z, budgeted_points[i].z);
+      EXPECT_EQ(points[i].intensity, budgeted_points[i].intensity);
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(
+    CellTypes, MemoryBudgetTest,
+    ::testing::Values(HybridGridCellType::kPointCloud,
+                      HybridGridCellType::kVoxelCentroid,
+                      HybridGridCellType::kQuantized,
+                      HybridGridCellType::kQuantizedWithIntensity));
+
+INSTANTIATE_TEST_CASE_P(
+    CellTypes, SaveLoadTest,
+    ::testing::Values(HybridGridCellType::kPointCloud,
+                      HybridGridCellType::kVoxelCentroid,
+                      HybridGridCellType::kQuantized,
+                      HybridGridCellType::kQuantizedWithIntensity));
+
+INSTANTIATE_TEST_CASE_P(
+    CellTypes, NearestKSearchTest,
+    ::testing::Values(HybridGridCellType::kPointCloud,
+                      HybridGridCellType::kVoxelCentroid,
+                      HybridGridCellType::kQuantized));
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,279 +1,337 @@
 #include <common/tic_toc.h>
-#include <geometry_msgs/PoseStamped.h>
-#include <nav_msgs/Odometry.h>
-#include <pcl_conversions/pcl_conversions.h>
-#include <ros/init.h>
-#include <tf/transform_broadcaster.h>
+#include <algorithm>
 #include <random>
 
 #include "slam/local/laser_mapping.h"
-#include "slam/local/scan_matching/mapping_scan_matcher.h"
-#include "slam/msg_conversion.h"
 
-namespace {
-
-bool g_is_offline_mode;
-bool g_should_exit = false;
-
-}  // namespace
-
-LaserMapping::LaserMapping(bool is_offline_mode)
-    : gps_fusion_handler_(std::make_shared<GpsFusion>()),
+LaserMapping::LaserMapping(const LaserMappingOptions &options,
+                           const bool is_offline_mode, SlamOutput *const output)
+    : gps_fusion_handler_(
+          std::make_shared<GpsFusion>(options.gps_fusion_options)),
+      output_(CHECK_NOTNULL(output)),
       frame_idx_cur_(0),
-      hybrid_grid_map_corner_(3.0),
-      hybrid_grid_map_surf_(3.0) {
-  g_is_offline_mode = is_offline_mode;
-  // NodeHandle uses reference counting internally,
-  // thus a local variable can be created here
-  ros::NodeHandle nh;
-
+      save_map_prefix_(options.save_map_prefix),
+      line_res_(options.line_resolution),
+      plane_res_(options.plane_resolution) {
   LOG(INFO) << "LaserMapping initializing ...";
-  // get leaf size
-  float line_res = 0;
-  float plane_res = 0;
-  LOG_IF(WARNING, !nh.param<float>("mapping_line_resolution", line_res, 0.2))
-      << "Use default mapping_line_resolution: 0.2";
-  LOG_IF(WARNING, !nh.param<float>("mapping_plane_resolution", plane_res, 0.4))
-      << "Use default mapping_plane_resolution: 0.4";
   LOG(INFO) << "[MAP]"
-            << " line resolution " << line_res << " plane resolution "
-            << plane_res;
-  downsize_filter_corner_.setLeafSize(line_res, line_res, line_res);
-  downsize_filter_surf_.setLeafSize(plane_res, plane_res, plane_res);
-  // set publishers
-  cloud_scan_publisher_ =
-      nh.advertise<sensor_msgs::PointCloud2>("/velodyne_cloud_2", 100);
-  cloud_corner_publisher_ =
-      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_sharp", 100);
-  cloud_corner_less_publisher_ =
-      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_less_sharp", 100);
-  cloud_surf_publisher_ =
-      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_flat", 100);
-  cloud_surf_less_publisher_ =
-      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_less_flat", 100);
+            << " line resolution " << line_res_ << " plane resolution "
+            << plane_res_;
+  // STGM 地图
+  HybridGridOptions map_options;
+  map_options.resolution = 3.f;
+  map_options.cell_type = HybridGridCellType::kPointCloud;
+  if (options.use_voxel_centroid_map) {
+    LOG_IF(WARNING, options.use_quantized_map)
+        << "[MAP] the voxel centroid map is not quantized.";
+    map_options.cell_type = HybridGridCellType::kVoxelCentroid;
+  } else if (options.use_quantized_map) {
+    map_options.cell_type = options.keep_map_intensity
+                                ? HybridGridCellType::kQuantizedWithIntensity
+                                : HybridGridCellType::kQuantized;
+  }
+  if (options.num_scans_per_submap == 0) {
+    // 内存限制平分给 corner 和 surf 地图
+    map_options.memory_budget =
+        (size_t(std::max(options.memory_budget_mb, 0)) << 20) / 2;
+  } else {
+    LOG_IF(WARNING, options.memory_budget_mb > 0)
+        << "[MAP] the memory budget is not supported with submaps.";
+  }
+  map_options.tile_directory = options.tile_directory;
+  // 定位模式：加载 Save() 保存的地图，只匹配不更新地图
+  localization_mode_ = !options.localization_map_prefix.empty();
+  if (localization_mode_) {
+    LOG(INFO) << "[MAP] localization mode, loading map "
+              << options.localization_map_prefix << " ...";
+    submaps_.reset(new Submaps(
+        HybridGrid::Load(options.localization_map_prefix + "_corner.grid"),
+        HybridGrid::Load(options.localization_map_prefix + "_surf.grid")));
+  } else {
+    SubmapsOptions submaps_options;
+    submaps_options.num_scans_per_submap = options.num_scans_per_submap;
+    submaps_options.corner_grid_options = map_options;
+    submaps_options.corner_grid_options.leaf_size = line_res_;
+    submaps_options.surf_grid_options = map_options;
+    submaps_options.surf_grid_options.leaf_size = plane_res_;
+    submaps_.reset(new Submaps(submaps_options));
+    map_update_thread_.reset(new ThreadPool(1));
+  }
+  // scan matcher, the association threads include the mapping thread
+  if (options.num_association_threads > 1) {
+    scan_matcher_thread_pool_.reset(
+        new ThreadPool(options.num_association_threads - 1));
+  }
+  scan_matcher_.reset(new MappingScanMatcher(options.scan_matcher_options,
+                                             scan_matcher_thread_pool_.get()));
+  max_num_rounds_ = options.scan_matcher_options.max_num_rounds;
+  // 在线模式下按时间预算调整每帧的计算量，而不是丢帧
+  if (!is_offline_mode && options.scheduler_options.deadline_ms > 0.) {
+    scheduler_.reset(new MappingScheduler(options.scheduler_options));
+  }
 
-  cloud_surround_publisher_ =
-      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_surround", 100);
-  aftmapped_odom_publisher_ =
-      nh.advertise<nav_msgs::Odometry>("/aft_mapped_to_init", 100);
-  aftmapped_odom_highfrec_publisher_ =
-      nh.advertise<nav_msgs::Odometry>("/aft_mapped_to_init_high_frec", 100);
-  aftmapped_path_publisher_ =
-      nh.advertise<nav_msgs::Path>("/aft_mapped_path", 100);
+  if (options.use_loop_closure) {
+    sparse_pose_graph_.reset(
+        new SparsePoseGraph(options.loop_closure_options, is_offline_mode));
+  }
 
   // RUN
-  thread_ = std::thread([this] { this->Run(); });
+  // Online mode only maps the newest frame, offline mode maps every frame.
+  PipelineStageOptions stage_options;
+  stage_options.name = "MAP";
+  stage_options.queue_size = 16;
+  stage_options.cpu = options.cpu;
+  stage_options.drop_when_full = !is_offline_mode;
+  stage_options.blocking = is_offline_mode;
+  stage_options.keep_latest_only = !is_offline_mode && scheduler_ == nullptr;
+  mapping_stage_.reset(new PipelineStage<LaserOdometryResultType>(
+      stage_options, [this](LaserOdometryResultType odom_result) {
+        this->HandleOdometryResult(std::move(odom_result));
+      }));
 }
 
 LaserMapping::~LaserMapping() {
-  {
-    std::unique_lock<std::mutex> ul(mutex_);
-    g_should_exit = true;
+  // Maps the remaining frames and stops the mapping thread
+  mapping_stage_.reset();
+  WaitForMapUpdate();
+  sparse_pose_graph_.reset();
+  if (scheduler_ != nullptr) scheduler_->LogStatistics();
+  if (!localization_mode_ && !save_map_prefix_.empty()) {
+    if (submaps_->num_submaps() == 1) {
+      submaps_->submap(0)->corner_grid().Save(save_map_prefix_ +
+                                              "_corner.grid");
+      submaps_->submap(0)->surf_grid().Save(save_map_prefix_ + "_surf.grid");
+    } else {
+      LOG(WARNING) << "[MAP] " << submaps_->num_submaps()
+                   << " submaps cannot be saved as a single map.";
+    }
   }
-  thread_.join();
+  // Only the last window, the older poses have been optimized in the session
   gps_fusion_handler_->Optimize();
+  LOG(INFO) << "[GPS] local to gps "
+            << gps_fusion_handler_->local_to_gps().DebugString();
   LOG(INFO) << "LaserMapping finished.";
 }
 
 void LaserMapping::AddLaserOdometryResult(
     const LaserOdometryResultType &laser_odometry_result) {
-  std::unique_lock<std::mutex> ul(mutex_);
-  odometry_result_queue_.push(laser_odometry_result);
-  cv_.notify_one();
-  // publish odom tf
-  // high frequence publish
-  nav_msgs::Odometry aftmapped_odom;
-  aftmapped_odom.child_frame_id = "aft_mapped";
-  aftmapped_odom.header.frame_id = "camera_init";
-  aftmapped_odom.header.stamp = ToRos(laser_odometry_result.timestamp);
-  aftmapped_odom.pose = ToRos(pose_odom2map_ * laser_odometry_result.odom_pose);
-  aftmapped_odom_highfrec_publisher_.publish(aftmapped_odom);
+  mapping_stage_->Push(laser_odometry_result);
+  // high frequence pose
+  Rigid3d pose_odom2map;
+  Rigid3d pose_map2global;
+  {
+    std::lock_guard<std::mutex> lg(mutex_);
+    pose_odom2map = pose_odom2map_;
+    pose_map2global = pose_map2global_;
+  }
+  output_->AddHighFrequencyPose(
+      laser_odometry_result.timestamp,
+      pose_map2global * pose_odom2map * laser_odometry_result.odom_pose);
 }
 
-void LaserMapping::Run() {
-  while (ros::ok()) {
-    LaserOdometryResultType odom_result;
-    {
-      std::unique_lock<std::mutex> ul(mutex_);
-      // Try to get new messages in 50 ms, return false if failed
-      bool has_new_msg = cv_.wait_for(
-          ul, std::chrono::milliseconds(50),
-          [this] { return !this->odometry_result_queue_.empty(); });
-      if (!has_new_msg) {
-        if (g_should_exit)
-          break;
-        else
-          continue;
-      }
-      odom_result = odometry_result_queue_.front();
-      odometry_result_queue_.pop();
-      if (!g_is_offline_mode) {
-        while (!odometry_result_queue_.empty()) {
-          LOG(WARNING)
-              << "[MAP] drop lidar frame in mapping for real time performance";
-          odometry_result_queue_.pop();
-        }
-      }
-    }
-
-    // scan match
-    // input: from odom
-    PointCloudConstPtr laserCloudCornerLast =
-        odom_result.cloud_corner_less_sharp;
-    PointCloudConstPtr laserCloudSurfLast = odom_result.cloud_surf_less_flat;
-    PointCloudConstPtr laserCloudFullRes = odom_result.cloud_full_res;
-
-    pose_odom_scan2world_ = odom_result.odom_pose;
-
-    TicToc t_whole;
-
-    transformAssociateToMap();
+void LaserMapping::UpdateCorrection() {
+  int num_optimizations = 0;
+  if (sparse_pose_graph_ != nullptr) {
+    num_optimizations = sparse_pose_graph_->num_optimizations();
+    pose_map2optimized_ = sparse_pose_graph_->local_to_optimized();
+  }
+  const Rigid3d local_to_gps = gps_fusion_handler_->local_to_gps();
+  {
+    std::lock_guard<std::mutex> lg(mutex_);
+    pose_map2global_ = local_to_gps * pose_map2optimized_;
+  }
 
-    TicToc t_shift;
-    PointCloudPtr laserCloudCornerFromMap =
-        hybrid_grid_map_corner_.GetSurroundedCloud(laserCloudCornerLast,
-                                                   pose_map_scan2world_);
-    PointCloudPtr laserCloudSurfFromMap =
-        hybrid_grid_map_surf_.GetSurroundedCloud(laserCloudSurfLast,
-                                                 pose_map_scan2world_);
-    LOG_STEP_TIME("MAP", "Collect surround cloud", t_shift.toc());
+  // 修正改变时重新计算所有子地图的全局位姿，否则只计算新的子地图
+  if (num_optimizations != num_optimizations_ ||
+      local_to_gps.translation() != local_to_gps_.translation() ||
+      local_to_gps.rotation().coeffs() != local_to_gps_.rotation().coeffs()) {
+    num_optimizations_ = num_optimizations;
+    local_to_gps_ = local_to_gps;
+    num_corrected_submaps_ = 0;
+  }
+  for (; num_corrected_submaps_ < submaps_->num_submaps();
+       ++num_corrected_submaps_) {
+    Submap *const submap = submaps_->submap(num_corrected_submaps_);
+    const Rigid3d local_to_optimized =
+        sparse_pose_graph_ != nullptr
+            ? sparse_pose_graph_->LocalToOptimized(submap->anchor_time())
+            : Rigid3d();
+    submap->set_global_pose(local_to_gps * local_to_optimized *
+                            submap->local_pose());
+  }
+}
 
-    PointCloudPtr laserCloudCornerLastStack(new PointCloud);
-    downsize_filter_corner_.setInputCloud(laserCloudCornerLast);
-    downsize_filter_corner_.filter(*laserCloudCornerLastStack);
+void LaserMapping::WaitForMapUpdate() {
+  if (!map_update_.valid()) return;
+  TicToc t_wait;
+  map_update_.get();
+  LOG_STEP_TIME("MAP", "Wait for map update", t_wait.toc());
+}
 
-    PointCloudPtr laserCloudSurfLastStack(new PointCloud);
-    downsize_filter_surf_.setInputCloud(laserCloudSurfLast);
-    downsize_filter_surf_.filter(*laserCloudSurfLastStack);
+void LaserMapping::HandleOdometryResult(LaserOdometryResultType odom_result) {
+  // scan match
+  // input: from odom
+  PointCloudConstPtr laserCloudCornerLast =
+      odom_result.cloud_corner_less_sharp;
+  PointCloudConstPtr laserCloudSurfLast = odom_result.cloud_surf_less_flat;
+  PointCloudConstPtr laserCloudFullRes = odom_result.cloud_full_res;
+
+  pose_odom_scan2world_ = odom_result.odom_pose;
+
+  TicToc t_frame;
+  MappingQuality quality;
+  quality.max_num_rounds = max_num_rounds_;
+  if (scheduler_ != nullptr) {
+    quality = scheduler_->quality();
+    quality.max_num_rounds = std::min(quality.max_num_rounds, max_num_rounds_);
+  }
+  downsize_filter_corner_.setLeafSize(line_res_ * quality.leaf_size_scale,
+                                      line_res_ * quality.leaf_size_scale,
+                                      line_res_ * quality.leaf_size_scale);
+  downsize_filter_surf_.setLeafSize(plane_res_ * quality.leaf_size_scale,
+                                    plane_res_ * quality.leaf_size_scale,
+                                    plane_res_ * quality.leaf_size_scale);
+  scan_matcher_->set_max_num_rounds(quality.max_num_rounds);
+
+  TicToc t_whole;
+
+  transformAssociateToMap();
+
+  // 降采样的点数不超过输入，缓冲区从对象池取出时已足够大
+  PointCloudPtr laserCloudCornerLastStack =
+      AcquirePointCloud(laserCloudCornerLast->size());
+  PointCloudPtr laserCloudSurfLastStack =
+      AcquirePointCloud(laserCloudSurfLast->size());
+  // corner 和 surf 分支并行降采样，与上一帧的地图插入同时进行
+  const auto downsample = [&](const int i) {
+    if (i == 0) {
+      downsize_filter_corner_.setInputCloud(laserCloudCornerLast);
+      downsize_filter_corner_.filter(*laserCloudCornerLastStack);
+    } else {
+      downsize_filter_surf_.setInputCloud(laserCloudSurfLast);
+      downsize_filter_surf_.filter(*laserCloudSurfLastStack);
+    }
+  };
+  if (scan_matcher_thread_pool_ != nullptr) {
+    scan_matcher_thread_pool_->ParallelFor(0, 2, downsample);
+  } else {
+    downsample(0);
+    downsample(1);
+  }
 
+  // 匹配前等待上一帧插入完成，匹配的地图与串行插入时相同
+  WaitForMapUpdate();
+
+  // 在子地图坐标系中匹配，子地图的位姿改变时匹配结果随之移动
+  Submap *const matching_submap = submaps_->matching_submap();
+  bool matched = false;
+  if (matching_submap != nullptr) {
+    HybridGrid &corner_map = matching_submap->corner_grid();
+    HybridGrid &surf_map = matching_submap->surf_grid();
+    Rigid3d pose_submap_scan2world =
+        matching_submap->local_pose().inverse() * pose_map_scan2world_;
+    corner_map.UpdatePose(pose_submap_scan2world);
+    surf_map.UpdatePose(pose_submap_scan2world);
     LOG(INFO) << "[MAP]"
-              << " corner=" << laserCloudCornerFromMap->size()
-              << ", surf=" << laserCloudSurfFromMap->size();
-    if (laserCloudCornerFromMap->size() > 10 &&
-        laserCloudSurfFromMap->size() > 50) {
-      TimestampedPointCloud cloud_map, scan_curr;
-      cloud_map.cloud_corner_less_sharp = laserCloudCornerFromMap;
-      cloud_map.cloud_surf_less_flat = laserCloudSurfFromMap;
+              << " corner=" << corner_map.num_points()
+              << ", surf=" << surf_map.num_points();
+    if (corner_map.num_points() > 10 && surf_map.num_points() > 50) {
+      TimestampedPointCloud scan_curr;
       scan_curr.cloud_corner_less_sharp = laserCloudCornerLastStack;
       scan_curr.cloud_surf_less_flat = laserCloudSurfLastStack;
-      MappingScanMatcher::Match(cloud_map, scan_curr, &pose_map_scan2world_);
-    } else {
-      LOG(WARNING) << "[MAP] time Map corner and surf num are not enough";
+      scan_matcher_->Match(corner_map, surf_map, scan_curr,
+                           &pose_submap_scan2world);
+      pose_map_scan2world_ =
+          matching_submap->local_pose() * pose_submap_scan2world;
+      matched = true;
     }
-    transformUpdate();
-
-    TicToc t_add;
-
-    hybrid_grid_map_corner_.InsertScan(
-        TransformPointCloud(laserCloudCornerLastStack, pose_map_scan2world_),
-        downsize_filter_corner_);
-
-    hybrid_grid_map_surf_.InsertScan(
-        TransformPointCloud(laserCloudSurfLastStack, pose_map_scan2world_),
-        downsize_filter_surf_);
-
-    LOG_STEP_TIME("MAP", "add points", t_add.toc());
-    LOG_STEP_TIME("MAP", "whole mapping", t_whole.toc());
-
-    // publish surround map for every 5 frame
-    if (frame_idx_cur_ % 5 == 0) {
-      PointCloudPtr laserCloudSurround(new PointCloud);
-      *laserCloudSurround += *laserCloudCornerFromMap;
-      *laserCloudSurround += *laserCloudSurfFromMap;
+  }
+  LOG_IF(WARNING, !matched)
+      << "[MAP] time Map corner and surf num are not enough";
+  transformUpdate();
+  UpdateCorrection();
+
+  // 地图插入在后台进行，下一帧读地图前等待
+  if (!localization_mode_ && frame_idx_cur_ % quality.insert_every == 0) {
+    const auto insert = std::make_shared<std::packaged_task<void()>>(
+        [this, time = odom_result.timestamp, pose = pose_map_scan2world_,
+         corner_cloud = laserCloudCornerLastStack,
+         surf_cloud = laserCloudSurfLastStack]() {
+          TicToc t_add;
+          submaps_->InsertScan(time, pose, corner_cloud, surf_cloud,
+                               scan_matcher_thread_pool_.get());
+          LOG_STEP_TIME("MAP", "add points", t_add.toc());
+        });
+    map_update_ = insert->get_future();
+    map_update_thread_->Schedule([insert]() { (*insert)(); });
+  }
+  LOG_STEP_TIME("MAP", "whole mapping", t_whole.toc());
 
-      sensor_msgs::PointCloud2 laserCloudSurround3;
-      pcl::toROSMsg(*laserCloudSurround, laserCloudSurround3);
-      laserCloudSurround3.header.stamp = ToRos(odom_result.timestamp);
-      laserCloudSurround3.header.frame_id = "camera_init";
-      cloud_surround_publisher_.publish(laserCloudSurround3);
+  // publish surround map for every 5 frame by default
+  if (frame_idx_cur_ % quality.surround_every == 0 &&
+      output_->WantsSurroundCloud()) {
+    // 周围地图包含当前帧，且 GetSurroundedCloud() 会移动活动区域
+    WaitForMapUpdate();
+    TicToc t_shift;
+    PointCloudPtr laserCloudSurround;
+    Submap *const submap = submaps_->matching_submap();
+    if (submap != nullptr) {
+      const Rigid3d pose_submap_scan2world =
+          submap->local_pose().inverse() * pose_map_scan2world_;
+      const PointCloudPtr corner_surround =
+          submap->corner_grid().GetSurroundedCloud(pose_submap_scan2world);
+      const PointCloudPtr surf_surround =
+          submap->surf_grid().GetSurroundedCloud(pose_submap_scan2world);
+      laserCloudSurround =
+          AcquirePointCloud(corner_surround->size() + surf_surround->size());
+      *laserCloudSurround += *corner_surround;
+      *laserCloudSurround += *surf_surround;
+      // 与发布的位姿在同一坐标系中
+      laserCloudSurround =
+          TransformPointCloud(laserCloudSurround, submap->global_pose());
+    } else {
+      laserCloudSurround = AcquirePointCloud();
     }
+    LOG_STEP_TIME("MAP", "Collect surround cloud", t_shift.toc());
 
-    nav_msgs::Odometry aftmapped_odom;
-    aftmapped_odom.header.frame_id = "camera_init";
-    aftmapped_odom.header.stamp = ToRos(odom_result.timestamp);
-    aftmapped_odom.child_frame_id = "aft_mapped";
-    aftmapped_odom.pose = ToRos(pose_map_scan2world_);
-    aftmapped_odom_publisher_.publish(aftmapped_odom);
-
-    geometry_msgs::PoseStamped laserAfterMappedPose;
-    laserAfterMappedPose.header = aftmapped_odom.header;
-    laserAfterMappedPose.pose = aftmapped_odom.pose.pose;
-    aftmapped_path_.header.stamp = aftmapped_odom.header.stamp;
-    aftmapped_path_.header.frame_id = "camera_init";
-    aftmapped_path_.poses.push_back(laserAfterMappedPose);
-    aftmapped_path_publisher_.publish(aftmapped_path_);
-
-    gps_fusion_handler_->AddLocalPose(odom_result.timestamp,
-                                      pose_map_scan2world_);
-
-    PublishScan(odom_result);
+    output_->AddSurroundCloud(odom_result.timestamp, laserCloudSurround);
+  }
 
-    tf::Transform transform;
-    transform.setOrigin({pose_map_scan2world_.translation().x(),
-                         pose_map_scan2world_.translation().y(),
-                         pose_map_scan2world_.translation().z()});
-    transform.setRotation({pose_map_scan2world_.rotation().x(),
-                           pose_map_scan2world_.rotation().y(),
-                           pose_map_scan2world_.rotation().z(),
-                           pose_map_scan2world_.rotation().w()});
-    transform_broadcaster_.sendTransform(tf::StampedTransform(
-        transform, aftmapped_odom.header.stamp, "/camera_init", "/aft_mapped"));
+  // GPS 融合闭环修正后的位姿
+  gps_fusion_handler_->AddLocalPose(odom_result.timestamp,
+                                    pose_map2optimized_ * pose_map_scan2world_);
+  if (sparse_pose_graph_ != nullptr) {
+    sparse_pose_graph_->AddScan(odom_result.timestamp, pose_map_scan2world_,
+                                laserCloudCornerLastStack,
+                                laserCloudSurfLastStack, laserCloudFullRes);
+  }
+  output_->AddMappedScan(odom_result, pose_map2global_ * pose_map_scan2world_);
 
-    frame_idx_cur_++;
+  if (scheduler_ != nullptr) {
+    scheduler_->AddFrame(t_frame.toc(), mapping_stage_->num_queued());
+    if (frame_idx_cur_ % 100 == 99) scheduler_->LogStatistics();
   }
+  frame_idx_cur_++;
 }
 
 void LaserMapping::AddImu(const ImuData &imu_data) {
-  // TODO
-  // calib imu and lidar
-  // LOG(FATAL) << "AddIMU not implemented yet.";
-}
-
-void LaserMapping::PublishScan(const TimestampedPointCloud &scan) {
-  sensor_msgs::PointCloud2 laser_cloud_out_msg;
-  pcl::toROSMsg(*scan.cloud_full_res, laser_cloud_out_msg);
-  laser_cloud_out_msg.header.stamp = ToRos(scan.timestamp);
-  laser_cloud_out_msg.header.frame_id = "aft_mapped";
-  cloud_scan_publisher_.publish(laser_cloud_out_msg);
-
-  sensor_msgs::PointCloud2 cloud_corner_sharp_msg;
-  pcl::toROSMsg(*scan.cloud_corner_sharp, cloud_corner_sharp_msg);
-  cloud_corner_sharp_msg.header.stamp = ToRos(scan.timestamp);
-  cloud_corner_sharp_msg.header.frame_id = "aft_mapped";
-  cloud_corner_publisher_.publish(cloud_corner_sharp_msg);
-
-  sensor_msgs::PointCloud2 cloud_corner_less_sharp_msg;
-  pcl::toROSMsg(*scan.cloud_corner_less_sharp, cloud_corner_less_sharp_msg);
-  cloud_corner_less_sharp_msg.header.stamp = ToRos(scan.timestamp);
-  cloud_corner_less_sharp_msg.header.frame_id = "aft_mapped";
-  cloud_corner_less_publisher_.publish(cloud_corner_less_sharp_msg);
-
-  sensor_msgs::PointCloud2 cloud_surf_flat_msg;
-  pcl::toROSMsg(*scan.cloud_surf_flat, cloud_surf_flat_msg);
-  cloud_surf_flat_msg.header.stamp = ToRos(scan.timestamp);
-  cloud_surf_flat_msg.header.frame_id = "aft_mapped";
-  cloud_surf_publisher_.publish(cloud_surf_flat_msg);
-
-  sensor_msgs::PointCloud2 cloud_surf_less_flat_msg;
-  pcl::toROSMsg(*scan.cloud_surf_less_flat, cloud_surf_less_flat_msg);
-  cloud_surf_less_flat_msg.header.stamp = ToRos(scan.timestamp);
-  cloud_surf_less_flat_msg.header.frame_id = "aft_mapped";
-  cloud_surf_less_publisher_.publish(cloud_surf_less_flat_msg);
+  // The imu rotation enters the mapping through the initial guess, which
+  // composes the odometry seeded with it, see transformAssociateToMap().
+  // Using the imu data here would need the imu-lidar extrinsic, which is not
+  // calibrated yet, see LaserOdometryOptions::use_imu_rotation.
 }
 
 void LaserMapping::AddOdom(const OdometryData &odom_data) {
 #ifdef _SIM_GPS
-  static int counter = 1;
   /**
    * Simulate GPS data for GPS fusion
    */
-  if (counter % 10 == 0) {
-    static std::default_random_engine g;
-    static std::uniform_real_distribution<double> dist(-0.05, 0.05);
+  if (++num_odoms_ % 10 == 0) {
+    std::uniform_real_distribution<double> dist(-0.05, 0.05);
+    std::default_random_engine &g = gps_noise_generator_;
     gps_fusion_handler_->AddFixedPoint(
         odom_data.timestamp, Vector<double>(dist(g), dist(g), dist(g)) +
                                  odom_data.odom.translation());
   }
-  ++counter;
 #endif
 }
@@ -1,23 +1,71 @@
 #ifndef MSF_LOAM_VELODYNE_LASER_MAPPING_H
 #define MSF_LOAM_VELODYNE_LASER_MAPPING_H
 
-#include <nav_msgs/Path.h>
 #include <pcl/filters/voxel_grid.h>
-#include <tf/transform_broadcaster.h>
-#include <condition_variable>
-#include <queue>
-#include <thread>
-
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include "common/pipeline_stage.h"
+#include "common/thread_pool.h"
 #include "common/timestamped_pointcloud.h"
 #include "slam/gps_fusion/gps_fusion.h"
-#include "slam/hybrid_grid.h"
 #include "slam/imu_fusion/imu_tracker.h"
+#include "slam/local/mapping_scheduler.h"
+#include "slam/local/scan_matching/mapping_scan_matcher.h"
+#include "slam/local/submaps.h"
+#include "slam/loop_closure/sparse_pose_graph.h"
+#include "slam/slam_output.h"
 
 using LaserOdometryResultType = TimestampedPointCloud;
 
+struct LaserMappingOptions {
+  // 特征点降采样的体素大小
+  float line_resolution = 0.2f;
+  float plane_resolution = 0.4f;
+  // STGM 地图的格网类型，见 HybridGridCellType
+  bool use_voxel_centroid_map = false;
+  // Stores the points of the point cloud cells as 16-bit fixed-point
+  // coordinates, with 8 bits of the intensity if 'keep_map_intensity'.
+  bool use_quantized_map = false;
+  bool keep_map_intensity = false;
+  // Scans per submap, see SubmapsOptions. 0 maps into a single grid in the
+  // map frame.
+  int num_scans_per_submap = 0;
+  // Memory limit of both maps, 0 for no limit. Far tiles are spilled to a
+  // scratch file in 'tile_directory'. Only used without submaps.
+  int memory_budget_mb = 0;
+  std::string tile_directory = "/tmp";
+  // If not empty, the maps '<prefix>_corner.grid' and '<prefix>_surf.grid'
+  // are loaded and only matched against (localization mode).
+  std::string localization_map_prefix;
+  // If not empty, the maps are saved to '<prefix>_corner.grid' and
+  // '<prefix>_surf.grid' on shutdown.
+  std::string save_map_prefix;
+  // Threads of the data association, including the mapping thread.
+  int num_association_threads = 4;
+  MappingScanMatcherOptions scan_matcher_options;
+  // Only used in online mode, a deadline of 0 maps the newest frame only.
+  MappingSchedulerOptions scheduler_options;
+  // CPU the mapping thread is pinned to, -1 for none.
+  int cpu = -1;
+  // The GPS correction is applied to the published poses, matching and the
+  // map stay in the map frame.
+  GpsFusionOptions gps_fusion_options;
+  // Searches the keyframes for loops and optimizes them in a pose graph on a
+  // background thread. The correction of the newest keyframe is applied to
+  // the published poses and to the poses fused with GPS.
+  bool use_loop_closure = false;
+  SparsePoseGraphOptions loop_closure_options;
+};
+
 class LaserMapping {
  public:
-  explicit LaserMapping(bool is_offline_mode);
+  // 'output' is not owned and must outlive the instance.
+  LaserMapping(const LaserMappingOptions &options, bool is_offline_mode,
+               SlamOutput *output);
 
   ~LaserMapping();
 
@@ -29,9 +77,12 @@ class LaserMapping {
   void AddOdom(const OdometryData &odom_data);
 
  private:
-  void Run();
+  // Last stage of the pipeline, runs on its own thread.
+  void HandleOdometryResult(LaserOdometryResultType odom_result);
 
-  void PublishScan(const TimestampedPointCloud &scan);
+  // Blocks until the scan of the previous frame is in the map. Called by the
+  // mapping thread before the map is read.
+  void WaitForMapUpdate();
 
   // set initial guess for pose
   void transformAssociateToMap() {
@@ -39,23 +90,59 @@ class LaserMapping {
   }
 
   void transformUpdate() {
+    std::lock_guard<std::mutex> lg(mutex_);
     pose_odom2map_ = pose_map_scan2world_ * pose_odom_scan2world_.inverse();
   }
 
+  // Reads the latest loop closure and GPS corrections into
+  // 'pose_map2optimized_' and 'pose_map2global_'. Re-anchors the submaps if
+  // either changed. Called on the mapping thread while no scan is inserted.
+  void UpdateCorrection();
+
  private:
   std::shared_ptr<GpsFusion> gps_fusion_handler_;
+  // 闭环检测，may be null
+  std::unique_ptr<SparsePoseGraph> sparse_pose_graph_;
+  // Used by the odometry and the mapping thread.
+  SlamOutput *const output_;
 
   int frame_idx_cur_;
 
-  std::thread thread_;
-  std::mutex mutex_;
-  std::condition_variable cv_;
-
-  std::queue<LaserOdometryResultType> odometry_result_queue_;
+  // 模拟 GPS 的计数和噪声
+  int num_odoms_ = 0;
+  std::default_random_engine gps_noise_generator_;
 
-  HybridGrid hybrid_grid_map_corner_;
-  HybridGrid hybrid_grid_map_surf_;
+  // Guards 'pose_odom2map_' and 'pose_map2global_', which are read by the
+  // odometry thread.
+  std::mutex mutex_;
 
+  std::unique_ptr<PipelineStage<LaserOdometryResultType>> mapping_stage_;
+
+  // Helpers of the mapping thread for the data association and the corner
+  // and surf branches, may be null.
+  std::unique_ptr<ThreadPool> scan_matcher_thread_pool_;
+  std::unique_ptr<MappingScanMatcher> scan_matcher_;
+  int max_num_rounds_;
+
+  // Adapts the work per frame to the deadline in online mode, may be null.
+  std::unique_ptr<MappingScheduler> scheduler_;
+
+  // In localization mode the maps are loaded from files and not updated.
+  bool localization_mode_;
+  // Maps are saved to '<prefix>_corner.grid' and '<prefix>_surf.grid' on
+  // shutdown if not empty.
+  std::string save_map_prefix_;
+  // STGM 地图：单一地图或子地图
+  std::unique_ptr<Submaps> submaps_;
+  // Inserts the scan of frame N into 'submaps_' while frame N+1 is
+  // downsampled, declared after 'submaps_' to be stopped before it. Null in
+  // localization mode.
+  std::unique_ptr<ThreadPool> map_update_thread_;
+  // 上一帧的地图插入，没有时无效
+  std::future<void> map_update_;
+
+  float line_res_;
+  float plane_res_;
   pcl::VoxelGrid<PointType> downsize_filter_corner_;
   pcl::VoxelGrid<PointType> downsize_filter_surf_;
 
@@ -65,26 +152,16 @@ class LaserMapping {
   Rigid3d pose_map_scan2world_;
   // Transformation between odom's world and map's world frame
   Rigid3d pose_odom2map_;
-
-  /**
-   * @brief ROS
-   *
-   */
-
-  ros::Publisher cloud_scan_publisher_;
-  ros::Publisher cloud_corner_publisher_;
-  ros::Publisher cloud_corner_less_publisher_;
-  ros::Publisher cloud_surf_publisher_;
-  ros::Publisher cloud_surf_less_publisher_;
-
-  ros::Publisher cloud_surround_publisher_;
-  ros::Publisher aftmapped_odom_publisher_;
-  ros::Publisher aftmapped_odom_highfrec_publisher_;
-  ros::Publisher aftmapped_path_publisher_;
-
-  nav_msgs::Path aftmapped_path_;
-
-  tf::TransformBroadcaster transform_broadcaster_;
+  // 闭环修正：map's world frame to the pose graph frame
+  Rigid3d pose_map2optimized_;
+  // Transformation from map's world frame to the published frame, the GPS
+  // correction after the loop closure correction
+  Rigid3d pose_map2global_;
+  // Corrections the submap global poses were computed with, 子地图
+  // [0, num_corrected_submaps_) 已修正
+  int num_optimizations_ = 0;
+  Rigid3d local_to_gps_;
+  int num_corrected_submaps_ = 0;
 };
 
 #endif  // MSF_LOAM_VELODYNE_LASER_MAPPING_H
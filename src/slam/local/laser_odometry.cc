@@ -36,13 +36,7 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-#include <geometry_msgs/PoseStamped.h>
-#include <nav_msgs/Odometry.h>
-#include <nav_msgs/Path.h>
-#include <pcl_conversions/pcl_conversions.h>
-#include <ros/ros.h>
-#include <sensor_msgs/PointCloud2.h>
-#include <slam/msg_conversion.h>
+#include <algorithm>
 #include <queue>
 
 #include "common/rigid_transform.h"
@@ -50,16 +44,22 @@
 #include "slam/local/laser_mapping.h"
 #include "slam/local/laser_odometry.h"
 #include "slam/local/scan_matching/odometry_scan_matcher.h"
-
-LaserOdometry::LaserOdometry(bool is_offline_mode)
-    : laser_mapper_handler_(std::make_shared<LaserMapping>(is_offline_mode)) {
-  // NodeHandle uses reference counting internally,
-  // thus a local variable can be created here
-  ros::NodeHandle nh;
+#include "slam/local/scan_matching/scan_deskewer.h"
+
+LaserOdometry::LaserOdometry(const LaserOdometryOptions &options,
+                             const LaserMappingOptions &mapping_options,
+                             const bool is_offline_mode,
+                             SlamOutput *const output,
+                             ThreadPool *const thread_pool)
+    : options_(options),
+      output_(CHECK_NOTNULL(output)),
+      thread_pool_(thread_pool),
+      laser_mapper_handler_(std::make_shared<LaserMapping>(
+          mapping_options, is_offline_mode, output)) {
   LOG(INFO) << "LaserOdometry initializing ...";
-  laser_odom_publisher_ =
-      nh.advertise<nav_msgs::Odometry>("/laser_odom_to_init", 100);
-  laser_path_publisher_ = nh.advertise<nav_msgs::Path>("/laser_odom_path", 100);
+  CHECK_GT(options_.scan_period, 0.);
+  CHECK_LT(options_.scan_period, 1.)
+      << "The point times are stored as ring + time in the intensity.";
 }
 
 LaserOdometry::~LaserOdometry() { LOG(INFO) << "LaserOdometry finished."; }
@@ -69,15 +69,49 @@ void LaserOdometry::AddLaserScan(TimestampedPointCloud scan_curr) {
   if (rotation) {
     scan_curr.imu_rotation = *rotation;
   }
+  const bool has_imu_rotation = rotation != nullptr;
 
   TicToc t_whole;
+  const bool initialized = !scan_last_.cloud_full_res->empty();
+  if (initialized) {
+    pose_curr2last_ = PredictCurr2Last(scan_curr, has_imu_rotation);
+    // 用预测的运动去畸变，之后按整帧同一时刻匹配
+    if (options_.deskew) {
+      TicToc t_deskew;
+      const ScanDeskewer deskewer(
+          pose_curr2last_,
+          ToSeconds(scan_curr.timestamp - scan_last_.timestamp),
+          options_.scan_period);
+      scan_curr.cloud_full_res = deskewer.Deskew(scan_curr.cloud_full_res);
+      scan_curr.cloud_corner_sharp =
+          deskewer.Deskew(scan_curr.cloud_corner_sharp);
+      scan_curr.cloud_corner_less_sharp =
+          deskewer.Deskew(scan_curr.cloud_corner_less_sharp);
+      scan_curr.cloud_surf_flat = deskewer.Deskew(scan_curr.cloud_surf_flat);
+      scan_curr.cloud_surf_less_flat =
+          deskewer.Deskew(scan_curr.cloud_surf_less_flat);
+      LOG_STEP_TIME("ODO", "Deskew", t_deskew.toc());
+    }
+  }
+
+  // 当前帧的搜索索引在匹配的同时于后台构建，下一帧匹配时直接使用
+  scan_curr.corner_less_sharp_index =
+      std::make_shared<FeatureSearchIndex>(scan_curr.cloud_corner_less_sharp);
+  scan_curr.surf_less_flat_index =
+      std::make_shared<FeatureSearchIndex>(scan_curr.cloud_surf_less_flat);
+  if (thread_pool_ != nullptr) {
+    scan_curr.corner_less_sharp_index->BuildAsync(thread_pool_);
+    scan_curr.surf_less_flat_index->BuildAsync(thread_pool_);
+  }
+
   // initializing
-  if (scan_last_.cloud_full_res->empty()) {
+  if (!initialized) {
     LOG(INFO) << "[ODO] Initializing ...";
   } else {
-    // pose_curr2last_.rotation() =
-    // scan_last_.imu_rotation * scan_curr.imu_rotation.inverse();
-    OdometryScanMatcher::Match(scan_last_, scan_curr, &pose_curr2last_);
+    OdometryScanMatcher::Match(scan_last_, scan_curr, &pose_curr2last_,
+                               options_.scan_matcher_options);
+    last_motion_duration_ =
+        ToSeconds(scan_curr.timestamp - scan_last_.timestamp);
 
     LOG(INFO) << "[ODO] odometry_delta: " << pose_curr2last_;
     LOG(INFO) << "[ODO] odometry_curr: " << pose_scan2world_;
@@ -85,32 +119,41 @@ void LaserOdometry::AddLaserScan(TimestampedPointCloud scan_curr) {
   }
 
   // publish odometry
-  nav_msgs::Odometry laserOdometry;
-  laserOdometry.header.frame_id = "camera_init";
-  laserOdometry.child_frame_id = "laser_odom";
-  laserOdometry.header.stamp = ToRos(scan_curr.timestamp);
-  laserOdometry.pose = ToRos(pose_scan2world_);
-  laser_odom_publisher_.publish(laserOdometry);
-
-  geometry_msgs::PoseStamped laserPose;
-  laserPose.header = laserOdometry.header;
-  laserPose.pose = laserOdometry.pose.pose;
-  laser_path_.header.stamp = laserOdometry.header.stamp;
-  laser_path_.poses.push_back(laserPose);
-  laser_path_.header.frame_id = "camera_init";
-  laser_path_publisher_.publish(laser_path_);
+  output_->AddOdometryPose(scan_curr.timestamp, pose_scan2world_);
 
   scan_curr.odom_pose = pose_scan2world_;
   laser_mapper_handler_->AddLaserOdometryResult(scan_curr);
 
   scan_last_ = scan_curr;
+  scan_last_has_imu_rotation_ = has_imu_rotation;
 
   LOG_STEP_TIME("ODO", "Whole LaserOdometry", t_whole.toc());
   LOG_IF_EVERY_N(WARNING, t_whole.toc() > 100, 10)
       << "Odometry process over 100ms!!";
 }
 
+Rigid3d LaserOdometry::PredictCurr2Last(const TimestampedPointCloud &scan_curr,
+                                        const bool has_imu_rotation) const {
+  // 匀速模型：按时间间隔缩放上一帧的运动，丢帧时也适用
+  Rigid3d prediction = pose_curr2last_;
+  if (last_motion_duration_ > 0.) {
+    const double ratio = std::min(
+        ToSeconds(scan_curr.timestamp - scan_last_.timestamp) /
+            last_motion_duration_,
+        3.);
+    prediction = ScaleMotion(pose_curr2last_, ratio);
+  }
+  if (options_.use_imu_rotation && has_imu_rotation &&
+      scan_last_has_imu_rotation_) {
+    prediction.rotation() =
+        (scan_last_.imu_rotation.inverse() * scan_curr.imu_rotation)
+            .normalized();
+  }
+  return prediction;
+}
+
 void LaserOdometry::AddImu(const ImuData &imu_data) {
+  std::unique_lock<std::mutex> ul(imu_mutex_);
   // estimate rotation_delta
   if (!imu_tracker_) {
     LOG(INFO) << "Initializing imu tracker ...";
@@ -120,11 +163,13 @@ void LaserOdometry::AddImu(const ImuData &imu_data) {
   }
   CHECK(imu_queue_.empty() || imu_data.time > imu_queue_.back().time);
   imu_queue_.push(imu_data);
+  ul.unlock();
   laser_mapper_handler_->AddImu(imu_data);
 }
 
 std::unique_ptr<Quaternion<double>> LaserOdometry::AdvanceImuTracker(
     const Time &time) {
+  std::lock_guard<std::mutex> lg(imu_mutex_);
   if (!imu_tracker_ || time < imu_tracker_->time()) return nullptr;
   while (!imu_queue_.empty() && imu_queue_.front().time <= time) {
     imu_tracker_->AddImuObservation(imu_queue_.front());
@@ -1,15 +1,40 @@
 #ifndef MSF_LOAM_VELODYNE_LASER_ODOMETRY_H
 #define MSF_LOAM_VELODYNE_LASER_ODOMETRY_H
 
-#include <ros/node_handle.h>
+#include <mutex>
+#include <queue>
 
+#include "common/thread_pool.h"
 #include "common/timestamped_pointcloud.h"
 #include "laser_mapping.h"
 #include "slam/imu_fusion/imu_tracker.h"
+#include "slam/local/scan_matching/odometry_scan_matcher.h"
+#include "slam/slam_output.h"
+
+struct LaserOdometryOptions {
+  // Predict the rotation between two scans from the imu orientations, which
+  // assumes the imu frame is aligned with the lidar frame since there is no
+  // imu-lidar extrinsic yet. Otherwise and without imu data, the last motion
+  // is extrapolated.
+  bool use_imu_rotation = false;
+  // Moves the points of a scan to the scan end by the predicted motion
+  // before matching, for lidars moving noticeably during a sweep.
+  bool deskew = false;
+  // 扫描周期，less than 1 s since the time of a point is stored in the
+  // fractional part of its intensity.
+  double scan_period = 0.1;
+  OdometryScanMatcherOptions scan_matcher_options;
+};
 
 class LaserOdometry {
  public:
-  explicit LaserOdometry(bool is_offline_mode);
+  // 'output' is not owned and must outlive the instance. The search indices
+  // of a scan are built on 'thread_pool' while it is matched, or on the first
+  // search if 'thread_pool' is null. 'thread_pool' must outlive the instance.
+  LaserOdometry(const LaserOdometryOptions &options,
+                const LaserMappingOptions &mapping_options,
+                bool is_offline_mode, SlamOutput *output,
+                ThreadPool *thread_pool = nullptr);
 
   ~LaserOdometry();
 
@@ -21,22 +46,33 @@ class LaserOdometry {
 
   std::unique_ptr<Quaternion<double>> AdvanceImuTracker(const Time &time);
 
+  LaserMapping *laser_mapping() { return laser_mapper_handler_.get(); }
+
  private:
+  // Initial guess of the motion from the last scan to 'scan_curr': the last
+  // motion at constant velocity, with the imu rotation if available.
+  Rigid3d PredictCurr2Last(const TimestampedPointCloud &scan_curr,
+                           bool has_imu_rotation) const;
+
+  const LaserOdometryOptions options_;
+  SlamOutput *const output_;
+  ThreadPool *const thread_pool_;
   std::shared_ptr<LaserMapping> laser_mapper_handler_;
+  // Guards the imu data, which is added by a different thread than the laser
+  // scans in pipeline mode.
+  std::mutex imu_mutex_;
   std::unique_ptr<ImuTracker> imu_tracker_;
   std::queue<ImuData> imu_queue_;
 
   TimestampedPointCloud scan_last_;
+  bool scan_last_has_imu_rotation_ = false;
+  // Time between the last two scans, 0 before the first motion.
+  double last_motion_duration_ = 0.;
 
   // Transformation from scan to map
   Rigid3d pose_scan2world_;
   // Transformation from current scan to previous scan
   Rigid3d pose_curr2last_;
-
-  ros::Publisher laser_odom_publisher_;
-  ros::Publisher laser_path_publisher_;
-
-  nav_msgs::Path laser_path_;
 };
 
 #endif  // MSF_LOAM_VELODYNE_LASER_ODOMETRY_H
@@ -0,0 +1,77 @@
+#include "slam/local/mapping_scheduler.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+std::vector<MappingQuality> DefaultLevels() {
+  // {leaf_size_scale, max_num_rounds, insert_every, surround_every}
+  return {{1.f, 3, 1, 5},
+          {1.f, 2, 1, 10},
+          {1.5f, 2, 1, 10},
+          {1.5f, 1, 2, 20},
+          {2.f, 1, 3, 40}};
+}
+
+}  // namespace
+
+MappingScheduler::MappingScheduler(const MappingSchedulerOptions& options)
+    : options_(options) {
+  CHECK_GT(options_.deadline_ms, 0.);
+  CHECK_GT(options_.latency_smoothing, 0.);
+  CHECK_LE(options_.latency_smoothing, 1.);
+  if (options_.levels.empty()) options_.levels = DefaultLevels();
+  for (const MappingQuality& quality : options_.levels) {
+    CHECK_GT(quality.leaf_size_scale, 0.f);
+    CHECK_GT(quality.max_num_rounds, 0);
+    CHECK_GT(quality.insert_every, 0);
+    CHECK_GT(quality.surround_every, 0);
+  }
+  num_frames_per_level_.resize(options_.levels.size(), 0);
+}
+
+void MappingScheduler::AddFrame(const double latency_ms,
+                                const size_t num_queued) {
+  ++num_frames_;
+  ++num_frames_per_level_[level_];
+  if (latency_ms > options_.deadline_ms) ++num_deadline_misses_;
+  max_latency_ms_ = std::max(max_latency_ms_, latency_ms);
+  average_latency_ms_ =
+      num_frames_ == 1
+          ? latency_ms
+          : average_latency_ms_ + options_.latency_smoothing *
+                                      (latency_ms - average_latency_ms_);
+
+  const int last_level = static_cast<int>(options_.levels.size()) - 1;
+  const int previous_level = level_;
+  if (num_queued > 0 || average_latency_ms_ > 0.9 * options_.deadline_ms) {
+    // 降级，直到跟上输入
+    num_frames_at_low_load_ = 0;
+    level_ = std::min(level_ + 1, last_level);
+  } else if (average_latency_ms_ < 0.6 * options_.deadline_ms) {
+    if (++num_frames_at_low_load_ >= options_.num_frames_to_upgrade) {
+      num_frames_at_low_load_ = 0;
+      level_ = std::max(level_ - 1, 0);
+    }
+  } else {
+    num_frames_at_low_load_ = 0;
+  }
+  LOG_IF(INFO, level_ != previous_level)
+      << "[MAP] quality level " << previous_level << " -> " << level_
+      << ", average latency " << average_latency_ms_ << " ms, " << num_queued
+      << " frames queued";
+}
+
+void MappingScheduler::LogStatistics() const {
+  std::ostringstream frames_per_level;
+  for (size_t i = 0; i < num_frames_per_level_.size(); ++i) {
+    frames_per_level << (i == 0 ? "" : ", ") << num_frames_per_level_[i];
+  }
+  LOG(INFO) << "[MAP] scheduler: " << num_frames_ << " frames, "
+            << num_deadline_misses_ << " over the deadline of "
+            << options_.deadline_ms << " ms, max latency " << max_latency_ms_
+            << " ms, frames per quality level [" << frames_per_level.str()
+            << "]";
+}
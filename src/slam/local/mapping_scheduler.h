@@ -0,0 +1,69 @@
+#ifndef MSF_LOAM_VELODYNE_MAPPING_SCHEDULER_H
+#define MSF_LOAM_VELODYNE_MAPPING_SCHEDULER_H
+
+#include <cstddef>
+#include <vector>
+
+// How much work the mapping stage spends on a frame.
+struct MappingQuality {
+  // Scales the leaf size the features are downsampled to before matching.
+  float leaf_size_scale = 1.f;
+  // Rounds of association and optimization, see MappingScanMatcherOptions.
+  int max_num_rounds = 3;
+  // Only every 'insert_every'-th frame is inserted into the map.
+  int insert_every = 1;
+  // Only every 'surround_every'-th frame publishes the surround cloud.
+  int surround_every = 5;
+};
+
+struct MappingSchedulerOptions {
+  // Time budget of a frame in milliseconds, normally the scan period.
+  double deadline_ms = 100.;
+  // Weight of the newest frame in the moving average of the latency.
+  double latency_smoothing = 0.2;
+  // Frames at low load before the quality is raised by one level.
+  int num_frames_to_upgrade = 20;
+  // Quality levels, best first. Empty for the default levels.
+  std::vector<MappingQuality> levels;
+};
+
+/**
+ * @brief 建图的时间预算调度
+ *
+ * Picks the quality level of the next frame from the moving average of the
+ * frame latency and the number of frames waiting, so that the mapping stage
+ * keeps up with the scans and every frame is processed instead of dropping
+ * frames under load. The quality is lowered by one level as soon as the
+ * average latency exceeds 90% of the deadline or frames queue up, and raised
+ * again after 'num_frames_to_upgrade' frames below 60% of the deadline.
+ * Not thread-safe.
+ */
+class MappingScheduler {
+ public:
+  explicit MappingScheduler(const MappingSchedulerOptions& options);
+
+  const MappingQuality& quality() const { return options_.levels[level_]; }
+  // 0 is the best level.
+  int level() const { return level_; }
+
+  // Reports the processing time of a frame and the number of frames waiting
+  // behind it, and updates the level of the next frame.
+  void AddFrame(double latency_ms, size_t num_queued);
+
+  // Logs the latency and how many frames were processed at each level.
+  void LogStatistics() const;
+
+ private:
+  MappingSchedulerOptions options_;
+  int level_ = 0;
+  double average_latency_ms_ = 0.;
+  int num_frames_at_low_load_ = 0;
+
+  // 统计
+  size_t num_frames_ = 0;
+  size_t num_deadline_misses_ = 0;
+  double max_latency_ms_ = 0.;
+  std::vector<size_t> num_frames_per_level_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_MAPPING_SCHEDULER_H
@@ -0,0 +1,179 @@
+#include "slam/local/scan_matching/gauss_newton_solver.h"
+
+#include <glog/logging.h>
+#include <Eigen/Cholesky>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+#include <cmath>
+
+namespace {
+
+// Damping added to the diagonal relative to the trace, keeps the Cholesky
+// factorization of unobservable directions, e.g. along a corridor, finite.
+constexpr double kDamping = 1e-9;
+
+struct NormalEquations {
+  // 只累加上三角
+  Eigen::Matrix<double, 6, 6> hessian;
+  Eigen::Matrix<double, 6, 1> gradient;
+  double cost;
+
+  void SetZero() {
+    hessian.setZero();
+    gradient.setZero();
+    cost = 0.;
+  }
+
+  NormalEquations &operator+=(const NormalEquations &other) {
+    hessian += other.hessian;
+    gradient += other.gradient;
+    cost += other.cost;
+    return *this;
+  }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+double HuberLoss(const double squared_residual, const double scale) {
+  return squared_residual <= scale * scale
+             ? squared_residual
+             : 2. * scale * std::sqrt(squared_residual) - scale * scale;
+}
+
+// Derivative of the loss, the weight of the residual in the iteration.
+double HuberWeight(const double squared_residual, const double scale) {
+  return squared_residual <= scale * scale
+             ? 1.
+             : scale / std::sqrt(squared_residual);
+}
+
+Eigen::Matrix3d SkewSymmetric(const Eigen::Vector3d &v) {
+  Eigen::Matrix3d m;
+  m << 0., -v.z(), v.y(), v.z(), 0., -v.x(), -v.y(), v.x(), 0.;
+  return m;
+}
+
+// Adds the residuals of 'correspondences' at 'pose'. With the left
+// perturbation (R, t) <- (Exp(dr) * R, t + dt) a transformed point moves by
+// -[R * p]x * dr + dt.
+void Linearize(const LidarCorrespondences &correspondences,
+               const Eigen::Matrix3d &rotation,
+               const Eigen::Vector3d &translation, const double huber_scale,
+               NormalEquations *const normal_equations) {
+  auto hessian = normal_equations->hessian.selfadjointView<Eigen::Upper>();
+
+  // 点到直线：垂直于直线的误差向量 e = P * (p' - a)，P 为到法平面的投影
+  Eigen::Matrix<double, 6, 3> jacobian_transpose;
+  for (const LineCorrespondence &line : correspondences.lines) {
+    const Eigen::Vector3d rotated = rotation * line.curr_point;
+    const Eigen::Vector3d direction =
+        (line.point_a - line.point_b).normalized();
+    const Eigen::Matrix3d projection =
+        Eigen::Matrix3d::Identity() - direction * direction.transpose();
+    const Eigen::Vector3d error =
+        projection * (rotated + translation - line.point_a);
+    const double squared_residual = error.squaredNorm();
+    const double weight = HuberWeight(squared_residual, huber_scale);
+    // J^T = [[R * p]x * P; P]，P 和 [.]x 的转置分别为自身和相反数
+    jacobian_transpose.topRows<3>() = SkewSymmetric(rotated) * projection;
+    jacobian_transpose.bottomRows<3>() = projection;
+    hessian.rankUpdate(jacobian_transpose, weight);
+    normal_equations->gradient.noalias() +=
+        weight * jacobian_transpose * error;
+    normal_equations->cost += HuberLoss(squared_residual, huber_scale);
+  }
+
+  // 点到平面：r = n^T * (p' - c)
+  Eigen::Matrix<double, 6, 1> jacobian;
+  for (const PlaneCorrespondence &plane : correspondences.planes) {
+    const Eigen::Vector3d rotated = rotation * plane.curr_point;
+    const double residual =
+        plane.norm.dot(rotated + translation - plane.center);
+    const double squared_residual = residual * residual;
+    const double weight = HuberWeight(squared_residual, huber_scale);
+    jacobian.head<3>() = rotated.cross(plane.norm);
+    jacobian.tail<3>() = plane.norm;
+    hessian.rankUpdate(jacobian, weight);
+    normal_equations->gradient.noalias() += (weight * residual) * jacobian;
+    normal_equations->cost += HuberLoss(squared_residual, huber_scale);
+  }
+}
+
+}  // namespace
+
+GaussNewtonSummary SolveGaussNewton(
+    const GaussNewtonOptions &options,
+    const std::vector<const LidarCorrespondences *> &blocks,
+    ThreadPool *const thread_pool, Rigid3d *const pose_estimate) {
+  CHECK_GT(options.max_num_iterations, 0);
+  const int num_blocks = blocks.size();
+  std::vector<NormalEquations, Eigen::aligned_allocator<NormalEquations>>
+      partial_sums(num_blocks);
+  const auto linearize_all = [&](const Rigid3d &pose) {
+    const Eigen::Matrix3d rotation = pose.rotation().toRotationMatrix();
+    const auto linearize_block = [&](const int i) {
+      partial_sums[i].SetZero();
+      Linearize(*blocks[i], rotation, pose.translation(), options.huber_scale,
+                &partial_sums[i]);
+    };
+    if (thread_pool != nullptr && num_blocks > 1) {
+      thread_pool->ParallelFor(0, num_blocks, linearize_block);
+    } else {
+      for (int i = 0; i < num_blocks; ++i) linearize_block(i);
+    }
+    NormalEquations sum;
+    sum.SetZero();
+    for (const NormalEquations &partial_sum : partial_sums) {
+      sum += partial_sum;
+    }
+    return sum;
+  };
+
+  GaussNewtonSummary summary;
+  NormalEquations normal_equations = linearize_all(*pose_estimate);
+  summary.initial_cost = normal_equations.cost;
+  summary.final_cost = normal_equations.cost;
+  while (summary.num_iterations < options.max_num_iterations) {
+    Eigen::Matrix<double, 6, 6> &hessian = normal_equations.hessian;
+    hessian.diagonal().array() += kDamping * hessian.trace();
+    const Eigen::LLT<Eigen::Matrix<double, 6, 6>, Eigen::Upper> llt(hessian);
+    if (llt.info() != Eigen::Success) {
+      VLOG(1) << "Singular normal equation, stopping.";
+      break;
+    }
+    const Eigen::Matrix<double, 6, 1> step =
+        -llt.solve(normal_equations.gradient);
+    ++summary.num_iterations;
+
+    const Rigid3d pose_before = *pose_estimate;
+    const double rotation_step = step.head<3>().norm();
+    const Eigen::Quaterniond delta_rotation(
+        rotation_step > 0.
+            ? Eigen::AngleAxisd(rotation_step, step.head<3>() / rotation_step)
+            : Eigen::AngleAxisd::Identity());
+    pose_estimate->rotation() =
+        (delta_rotation * pose_before.rotation()).normalized();
+    pose_estimate->translation() = pose_before.translation() + step.tail<3>();
+
+    normal_equations = linearize_all(*pose_estimate);
+    if (normal_equations.cost > summary.final_cost) {
+      *pose_estimate = pose_before;
+      break;
+    }
+    summary.final_cost = normal_equations.cost;
+    if (step.norm() < options.min_step) break;
+  }
+  return summary;
+}
+
+double EvaluateLidarCost(const LidarCorrespondences &correspondences,
+                         const double huber_scale, const Rigid3d &pose,
+                         Eigen::Matrix<double, 6, 1> *const gradient) {
+  NormalEquations normal_equations;
+  normal_equations.SetZero();
+  Linearize(correspondences, pose.rotation().toRotationMatrix(),
+            pose.translation(), huber_scale, &normal_equations);
+  // 法方程的右端为 J^T * W * r，损失之和的梯度是它的两倍
+  *gradient = 2. * normal_equations.gradient;
+  return normal_equations.cost;
+}
@@ -0,0 +1,78 @@
+#ifndef MSF_LOAM_VELODYNE_GAUSS_NEWTON_SOLVER_H
+#define MSF_LOAM_VELODYNE_GAUSS_NEWTON_SOLVER_H
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "common/rigid_transform.h"
+#include "common/thread_pool.h"
+
+// 匹配的求解器：ceres 为参考实现，高斯牛顿专用于 6 自由度的点-线、点-面匹配
+enum class ScanMatcherSolverType { kCeres, kGaussNewton };
+
+// The current point is matched to the line through 'point_a' and 'point_b'.
+struct LineCorrespondence {
+  Eigen::Vector3d curr_point;
+  Eigen::Vector3d point_a;
+  Eigen::Vector3d point_b;
+};
+
+// The current point is matched to the plane through 'center' with the unit
+// normal 'norm'.
+struct PlaneCorrespondence {
+  Eigen::Vector3d curr_point;
+  Eigen::Vector3d center;
+  Eigen::Vector3d norm;
+};
+
+struct LidarCorrespondences {
+  std::vector<LineCorrespondence> lines;
+  std::vector<PlaneCorrespondence> planes;
+};
+
+struct GaussNewtonOptions {
+  // 与 ceres 的 max_num_iterations 相同
+  int max_num_iterations = 4;
+  // Scale of the Huber loss, the residuals are weighted like by
+  // ceres::HuberLoss.
+  double huber_scale = 0.1;
+  // Iterations stop after a step smaller than this, in m and rad.
+  double min_step = 1e-6;
+};
+
+struct GaussNewtonSummary {
+  int num_iterations = 0;
+  // Sum of the Huber losses of the squared residuals.
+  double initial_cost = 0.;
+  double final_cost = 0.;
+};
+
+/**
+ * @brief 6 自由度高斯牛顿求解
+ *
+ * Minimizes the Huber loss of the point-to-line and point-to-plane distances
+ * over the pose 'pose_estimate' from the current to the target frame by
+ * iteratively reweighted Gauss-Newton. The Jacobians are analytic, with the
+ * rotation perturbed on the left, and every iteration reduces them into a
+ * single 6x6 normal equation, solved by Cholesky. Nothing is allocated per
+ * residual.
+ *
+ * The blocks are linearized in parallel on 'thread_pool' if not null and
+ * summed in block order, so the result does not depend on the number of
+ * threads. A step which increases the cost is undone and ends the
+ * iterations, as does a singular normal equation.
+ */
+GaussNewtonSummary SolveGaussNewton(
+    const GaussNewtonOptions &options,
+    const std::vector<const LidarCorrespondences *> &blocks,
+    ThreadPool *thread_pool, Rigid3d *pose_estimate);
+
+// Returns the sum of the Huber losses of 'correspondences' at 'pose' as in
+// SolveGaussNewton(). Sets 'gradient' to its analytic gradient with respect
+// to the left perturbation (rotation, translation) of 'pose', from the same
+// Jacobians as the solver.
+double EvaluateLidarCost(const LidarCorrespondences &correspondences,
+                         double huber_scale, const Rigid3d &pose,
+                         Eigen::Matrix<double, 6, 1> *gradient);
+
+#endif  // MSF_LOAM_VELODYNE_GAUSS_NEWTON_SOLVER_H
@@ -0,0 +1,179 @@
+#include "slam/local/scan_matching/gauss_newton_solver.h"
+
+#include <ceres/ceres.h>
+#include <gtest/gtest.h>
+#include <Eigen/Geometry>
+#include <random>
+
+#include "slam/local/scan_matching/lidar_factor.h"
+
+namespace {
+
+constexpr double kHuberScale = 0.1;
+
+Rigid3d MakePose(const Eigen::Vector3d &axis_angle,
+                 const Eigen::Vector3d &translation) {
+  const double angle = axis_angle.norm();
+  return Rigid3d(translation,
+                 Quaternion<double>(Eigen::AngleAxisd(
+                     angle, angle > 0. ? Eigen::Vector3d(axis_angle / angle)
+                                       : Eigen::Vector3d::UnitX())));
+}
+
+// Pose moved by the left perturbation 'delta' = (rotation, translation).
+Rigid3d Perturb(const Rigid3d &pose,
+                const Eigen::Matrix<double, 6, 1> &delta) {
+  const Rigid3d rotation =
+      MakePose(delta.head<3>(), Eigen::Vector3d::Zero());
+  return Rigid3d(pose.translation() + delta.tail<3>(),
+                 rotation.rotation() * pose.rotation());
+}
+
+// Points on three walls and a floor and on four vertical edges, observed from
+// 'pose_world_scan' with noise of 'noise' m. A fraction 'outlier_ratio' of
+// the points is moved by up to 1 m.
+LidarCorrespondences MakeCorrespondences(const Rigid3d &pose_world_scan,
+                                         const double noise,
+                                         const double outlier_ratio) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> coordinate(-5., 5.);
+  std::normal_distribution<double> point_noise(0., noise);
+  std::uniform_real_distribution<double> unit(0., 1.);
+  std::uniform_real_distribution<double> outlier(-1., 1.);
+  const auto observe = [&](const Eigen::Vector3d &world_point) {
+    Eigen::Vector3d point =
+        world_point + Eigen::Vector3d(point_noise(rng), point_noise(rng),
+                                      point_noise(rng));
+    if (unit(rng) < outlier_ratio) {
+      point += Eigen::Vector3d(outlier(rng), outlier(rng), outlier(rng));
+    }
+    return pose_world_scan.inverse() * point;
+  };
+
+  LidarCorrespondences correspondences;
+  const Eigen::Vector3d normals[] = {
+      Eigen::Vector3d::UnitX(), Eigen::Vector3d::UnitY(),
+      Eigen::Vector3d(1., 1., 0.).normalized(), Eigen::Vector3d::UnitZ()};
+  const double offsets[] = {6., -7., 8., -2.};
+  for (int i = 0; i < 4; ++i) {
+    const Eigen::Vector3d &n = normals[i];
+    const Eigen::Vector3d center = offsets[i] * n;
+    const Eigen::Vector3d u = n.unitOrthogonal();
+    const Eigen::Vector3d v = n.cross(u);
+    for (int j = 0; j < 100; ++j) {
+      const Eigen::Vector3d world_point =
+          center + coordinate(rng) * u + coordinate(rng) * v;
+      correspondences.planes.push_back({observe(world_point), center, n});
+    }
+  }
+  const Eigen::Vector3d edges[] = {
+      Eigen::Vector3d(6., -7., 0.), Eigen::Vector3d(-6., 7., 0.),
+      Eigen::Vector3d(3., 4., 0.), Eigen::Vector3d(-4., -3., 1.)};
+  for (const Eigen::Vector3d &edge : edges) {
+    const Eigen::Vector3d point_a = edge + Eigen::Vector3d(0., 0., -1.);
+    const Eigen::Vector3d point_b = edge + Eigen::Vector3d(0.2, 0., 1.);
+    for (int j = 0; j < 50; ++j) {
+      const Eigen::Vector3d world_point =
+          point_a + unit(rng) * 3. * (point_b - point_a);
+      correspondences.lines.push_back(
+          {observe(world_point), point_a, point_b});
+    }
+  }
+  return correspondences;
+}
+
+TEST(GaussNewtonSolverTest, GradientMatchesFiniteDifferences) {
+  const Rigid3d pose_world_scan = MakePose(
+      Eigen::Vector3d(0.05, -0.02, 0.3), Eigen::Vector3d(1., 2., 0.1));
+  const LidarCorrespondences correspondences =
+      MakeCorrespondences(pose_world_scan, 0.02, 0.05);
+  // Away from the solution, so that both branches of the Huber loss occur.
+  const Rigid3d pose = Perturb(
+      pose_world_scan,
+      (Eigen::Matrix<double, 6, 1>() << 0.02, 0.01, -0.03, 0.1, -0.05, 0.08)
+          .finished());
+
+  Eigen::Matrix<double, 6, 1> gradient;
+  EvaluateLidarCost(correspondences, kHuberScale, pose, &gradient);
+  constexpr double kStep = 1e-6;
+  Eigen::Matrix<double, 6, 1> unused;
+  for (int i = 0; i < 6; ++i) {
+    Eigen::Matrix<double, 6, 1> delta = Eigen::Matrix<double, 6, 1>::Zero();
+    delta[i] = kStep;
+    const double cost_plus = EvaluateLidarCost(
+        correspondences, kHuberScale, Perturb(pose, delta), &unused);
+    const double cost_minus = EvaluateLidarCost(
+        correspondences, kHuberScale, Perturb(pose, -delta), &unused);
+    const double numerical = (cost_plus - cost_minus) / (2. * kStep);
+    EXPECT_NEAR(numerical, gradient[i], 1e-5 * gradient.norm()) << "i = " << i;
+  }
+}
+
+TEST(GaussNewtonSolverTest, ConvergesToCeresSolution) {
+  const Rigid3d pose_world_scan = MakePose(
+      Eigen::Vector3d(0.02, -0.01, 0.2), Eigen::Vector3d(0.5, -0.3, 0.05));
+  const LidarCorrespondences correspondences =
+      MakeCorrespondences(pose_world_scan, 0.01, 0.05);
+  const Rigid3d initial_pose = Perturb(
+      pose_world_scan,
+      (Eigen::Matrix<double, 6, 1>() << 0.01, -0.01, 0.02, 0.1, 0.05, -0.05)
+          .finished());
+
+  GaussNewtonOptions options;
+  options.max_num_iterations = 20;
+  options.huber_scale = kHuberScale;
+  options.min_step = 1e-10;
+  Rigid3d gauss_newton_pose = initial_pose;
+  const GaussNewtonSummary summary = SolveGaussNewton(
+      options, {&correspondences}, nullptr, &gauss_newton_pose);
+  EXPECT_LT(summary.final_cost, summary.initial_cost);
+
+  Rigid3d ceres_pose = initial_pose;
+  ceres::Problem problem;
+  ceres::LossFunction *loss_function = new ceres::HuberLoss(kHuberScale);
+  problem.AddParameterBlock(ceres_pose.rotation().coeffs().data(), 4,
+                            new ceres::EigenQuaternionParameterization());
+  problem.AddParameterBlock(ceres_pose.translation().data(), 3);
+  for (const LineCorrespondence &line : correspondences.lines) {
+    problem.AddResidualBlock(
+        LidarEdgeFactor::Create(line.curr_point, line.point_a, line.point_b),
+        loss_function, ceres_pose.rotation().coeffs().data(),
+        ceres_pose.translation().data());
+  }
+  for (const PlaneCorrespondence &plane : correspondences.planes) {
+    problem.AddResidualBlock(
+        LidarPlaneFactor::Create(plane.curr_point, plane.center, plane.norm),
+        loss_function, ceres_pose.rotation().coeffs().data(),
+        ceres_pose.translation().data());
+  }
+  ceres::Solver::Options solver_options;
+  solver_options.linear_solver_type = ceres::DENSE_QR;
+  solver_options.max_num_iterations = 50;
+  solver_options.function_tolerance = 1e-12;
+  solver_options.gradient_tolerance = 1e-12;
+  solver_options.parameter_tolerance = 1e-12;
+  ceres::Solver::Summary ceres_summary;
+  ceres::Solve(solver_options, &problem, &ceres_summary);
+  ASSERT_TRUE(ceres_summary.IsSolutionUsable());
+
+  EXPECT_LT((gauss_newton_pose.translation() - ceres_pose.translation())
+                .norm(),
+            1e-4);
+  EXPECT_LT(gauss_newton_pose.rotation().angularDistance(
+                ceres_pose.rotation()),
+            1e-4);
+  // The outliers are down-weighted by the Huber loss.
+  EXPECT_LT((gauss_newton_pose.translation() - pose_world_scan.translation())
+                .norm(),
+            5e-3);
+  EXPECT_LT(gauss_newton_pose.rotation().angularDistance(
+                pose_world_scan.rotation()),
+            2e-3);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -11,10 +11,7 @@ bool LidarEdgeFactor::operator()(const T *q, const T *t, T *residual) const {
   Eigen::Matrix<T, 3, 1> lpb = last_point_b_.cast<T>();
 
   Eigen::Quaternion<T> g_r_curr2last(q);
-  Eigen::Quaternion<T> q_identity{T(1), T(0), T(0), T(0)};
-  g_r_curr2last = q_identity.slerp(T(s_), g_r_curr2last);
-  Eigen::Matrix<T, 3, 1> g_t_curr2last{T(s_) * t[0], T(s_) * t[1],
-                                       T(s_) * t[2]};
+  Eigen::Matrix<T, 3, 1> g_t_curr2last{t[0], t[1], t[2]};
 
   Eigen::Matrix<T, 3, 1> lp;
   lp = g_r_curr2last * cp + g_t_curr2last;
@@ -36,9 +33,9 @@ template bool LidarEdgeFactor::operator()<ceres::Jet<double, 7> >(
 
 ceres::CostFunction *LidarEdgeFactor::Create(
     const Eigen::Vector3d &curr_point, const Eigen::Vector3d &last_point_a,
-    const Eigen::Vector3d &last_point_b, const double s) {
+    const Eigen::Vector3d &last_point_b) {
   return new ceres::AutoDiffCostFunction<LidarEdgeFactor, 1, 4, 3>(
-      new LidarEdgeFactor(curr_point, last_point_a, last_point_b, s));
+      new LidarEdgeFactor(curr_point, last_point_a, last_point_b));
 }
 
 template <typename T>
@@ -48,10 +45,7 @@ bool LidarPlaneFactor::operator()(const T *q, const T *t, T *residual) const {
   Eigen::Matrix<T, 3, 1> ijk = last_plane_N_.cast<T>();
 
   Eigen::Quaternion<T> g_r_curr2last(q);
-  Eigen::Quaternion<T> q_identity{T(1), T(0), T(0), T(0)};
-  g_r_curr2last = q_identity.slerp(T(s_), g_r_curr2last);
-  Eigen::Matrix<T, 3, 1> g_t_curr2last{T(s_) * t[0], T(s_) * t[1],
-                                       T(s_) * t[2]};
+  Eigen::Matrix<T, 3, 1> g_t_curr2last{t[0], t[1], t[2]};
 
   Eigen::Matrix<T, 3, 1> lp;
   lp = g_r_curr2last * cp + g_t_curr2last;
@@ -70,19 +64,18 @@ template bool LidarPlaneFactor::operator()<ceres::Jet<double, 7> >(
 
 ceres::CostFunction *LidarPlaneFactor::Create(
     const Eigen::Vector3d &curr_point, const Eigen::Vector3d &last_point_i,
-    const Eigen::Vector3d &last_point_j, const Eigen::Vector3d &last_point_k,
-    const double s) {
+    const Eigen::Vector3d &last_point_j, const Eigen::Vector3d &last_point_k) {
   auto last_plane_N =
       (last_point_i - last_point_j).cross(last_point_i - last_point_k);
   last_plane_N.normalize();
   auto last_plane_C = (last_point_i + last_point_j + last_point_k) / 3;
   return new ceres::AutoDiffCostFunction<LidarPlaneFactor, 1, 4, 3>(
-      new LidarPlaneFactor(curr_point, last_plane_C, last_plane_N, s));
+      new LidarPlaneFactor(curr_point, last_plane_C, last_plane_N));
 }
 
 ceres::CostFunction *LidarPlaneFactor::Create(
     const Eigen::Vector3d &curr_point, const Eigen::Vector3d &last_plane_C,
     const Eigen::Vector3d &last_plane_N) {
   return new ceres::AutoDiffCostFunction<LidarPlaneFactor, 1, 4, 3>(
-      new LidarPlaneFactor(curr_point, last_plane_C, last_plane_N, 1.0));
+      new LidarPlaneFactor(curr_point, last_plane_C, last_plane_N));
 }
@@ -11,27 +11,26 @@
  *
  * residual[0] = 面积 / 线段长
  *
+ * The current point is transformed rigidly, scans are deskewed before
+ * matching, see ScanDeskewer.
  */
 struct LidarEdgeFactor {
   LidarEdgeFactor(const Eigen::Vector3d &curr_point,
                   const Eigen::Vector3d &last_point_a,
-                  const Eigen::Vector3d &last_point_b, double s)
+                  const Eigen::Vector3d &last_point_b)
       : curr_point_(curr_point),
         last_point_a_(last_point_a),
-        last_point_b_(last_point_b),
-        s_(s) {}
+        last_point_b_(last_point_b) {}
 
   template <typename T>
   bool operator()(const T *q, const T *t, T *residual) const;
 
   static ceres::CostFunction *Create(const Eigen::Vector3d &curr_point,
                                      const Eigen::Vector3d &last_point_a,
-                                     const Eigen::Vector3d &last_point_b,
-                                     const double s);
+                                     const Eigen::Vector3d &last_point_b);
 
  private:
   const Eigen::Vector3d curr_point_, last_point_a_, last_point_b_;
-  const double s_;
 };
 
 /**
@@ -44,11 +43,10 @@ struct LidarEdgeFactor {
 struct LidarPlaneFactor {
   LidarPlaneFactor(const Eigen::Vector3d &curr_point,
                    const Eigen::Vector3d &last_plane_C,
-                   const Eigen::Vector3d &last_plane_N, double s)
+                   const Eigen::Vector3d &last_plane_N)
       : curr_point_(curr_point),
         last_plane_C_(last_plane_C),
-        last_plane_N_(last_plane_N),
-        s_(s) {}
+        last_plane_N_(last_plane_N) {}
 
   template <typename T>
   bool operator()(const T *q, const T *t, T *residual) const;
@@ -56,8 +54,7 @@ struct LidarPlaneFactor {
   static ceres::CostFunction *Create(const Eigen::Vector3d &curr_point,
                                      const Eigen::Vector3d &last_point_i,
                                      const Eigen::Vector3d &last_point_j,
-                                     const Eigen::Vector3d &last_point_k,
-                                     const double s);
+                                     const Eigen::Vector3d &last_point_k);
 
   static ceres::CostFunction *Create(const Eigen::Vector3d &curr_point,
                                      const Eigen::Vector3d &last_plane_C,
@@ -67,5 +64,4 @@ struct LidarPlaneFactor {
   const Eigen::Vector3d curr_point_;
   const Eigen::Vector3d last_plane_C_;
   const Eigen::Vector3d last_plane_N_;
-  const double s_;
 };
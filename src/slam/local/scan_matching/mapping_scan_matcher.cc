@@ -2,148 +2,253 @@
 // Created by kekeliu on 12/17/19.
 //
 
-#include <pcl/kdtree/kdtree_flann.h>
+#include <algorithm>
 
 #include "common/tic_toc.h"
 #include "lidar_factor.h"
 #include "mapping_scan_matcher.h"
 
-bool MappingScanMatcher::Match(const TimestampedPointCloud &cloud_map,
+namespace {
+
+// Number of feature points per association block.
+constexpr int kPointsPerBlock = 128;
+
+}  // namespace
+
+MappingScanMatcher::MappingScanMatcher(
+    const MappingScanMatcherOptions &options, ThreadPool *const thread_pool)
+    : options_(options), thread_pool_(thread_pool) {
+  CHECK_GT(options_.num_solver_threads, 0);
+  CHECK_GT(options_.coarse_point_stride, 0);
+  CHECK_GT(options_.max_num_rounds, 0);
+}
+
+void MappingScanMatcher::set_max_num_rounds(const int max_num_rounds) {
+  CHECK_GT(max_num_rounds, 0);
+  options_.max_num_rounds = max_num_rounds;
+}
+
+bool MappingScanMatcher::Match(const HybridGrid &corner_map,
+                               const HybridGrid &surf_map,
                                const TimestampedPointCloud &scan_curr,
                                Rigid3d *pose_estimate_map_scan2world) {
   TicToc t_opt;
-  TicToc t_tree;
-
-  pcl::KdTreeFLANN<PointType>::Ptr kdtreeCornerFromMap(
-      new pcl::KdTreeFLANN<PointType>());
-  pcl::KdTreeFLANN<PointType>::Ptr kdtreeSurfFromMap(
-      new pcl::KdTreeFLANN<PointType>());
-
-  kdtreeCornerFromMap->setInputCloud(cloud_map.cloud_corner_less_sharp);
-  kdtreeSurfFromMap->setInputCloud(cloud_map.cloud_surf_less_flat);
-  LOG_STEP_TIME("MAP", "build tree", t_tree.toc());
-
-  for (int iterCount = 0; iterCount < 2; iterCount++) {
-    // ceres::LossFunction *loss_function = NULL;
-    ceres::LossFunction *loss_function = new ceres::HuberLoss(0.1);
-    ceres::LocalParameterization *q_parameterization =
-        new ceres::EigenQuaternionParameterization();
-    ceres::Problem::Options problem_options;
-
-    ceres::Problem problem(problem_options);
-    problem.AddParameterBlock(
-        pose_estimate_map_scan2world->rotation().coeffs().data(), 4,
-        q_parameterization);
-    problem.AddParameterBlock(
-        pose_estimate_map_scan2world->translation().data(), 3);
-
-    TicToc t_data;
-    int corner_num = 0;
-
-    std::vector<int> pointSearchInd;
-    std::vector<float> pointSearchSqDis;
-
-    PointType pointOri, pointSel;
-
-    for (size_t i = 0; i < scan_curr.cloud_corner_less_sharp->size(); i++) {
-      pointOri = scan_curr.cloud_corner_less_sharp->points[i];
-      pointSel = *pose_estimate_map_scan2world * pointOri;
-      kdtreeCornerFromMap->nearestKSearch(pointSel, 5, pointSearchInd,
-                                          pointSearchSqDis);
-
-      if (pointSearchSqDis[4] < 1.0) {
-        TicToc t;
-        Eigen::Matrix<double, 3, 5> matA0;
-        for (int j = 0; j < 5; j++) {
-          matA0.col(j) =
-              cloud_map.cloud_corner_less_sharp->points[pointSearchInd[j]]
-                  .getVector3fMap()
-                  .cast<double>();
-        }
-        Eigen::Vector3d center = matA0.rowwise().mean();
-        matA0 = matA0.colwise() - center;
-        Eigen::Matrix3d covMat = matA0 * matA0.transpose();
-
-        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(covMat);
-
-        // if is indeed line feature
-        // note Eigen library sort eigenvalues in increasing order
-        Eigen::Vector3d unit_direction = saes.eigenvectors().col(2);
-        Eigen::Vector3d curr_point(pointOri.x, pointOri.y, pointOri.z);
-        if (saes.eigenvalues()[2] > 3 * saes.eigenvalues()[1]) {
-          const Eigen::Vector3d &point_on_line = center;
-          Eigen::Vector3d point_a, point_b;
-          point_a = 0.1 * unit_direction + point_on_line;
-          point_b = -0.1 * unit_direction + point_on_line;
-
-          ceres::CostFunction *cost_function =
-              LidarEdgeFactor::Create(curr_point, point_a, point_b, 1.0);
-          problem.AddResidualBlock(
-              cost_function, loss_function,
-              pose_estimate_map_scan2world->rotation().coeffs().data(),
-              pose_estimate_map_scan2world->translation().data());
-          corner_num++;
-        }
+
+  // 由粗到精：第一轮只用部分特征点，位姿变化足够小时提前结束
+  int num_rounds = 0;
+  while (num_rounds < options_.max_num_rounds) {
+    const int stride = num_rounds == 0 ? options_.coarse_point_stride : 1;
+    const Rigid3d pose_before = *pose_estimate_map_scan2world;
+    MatchRound(corner_map, surf_map, scan_curr, stride,
+               pose_estimate_map_scan2world);
+    ++num_rounds;
+
+    const Rigid3d &pose_after = *pose_estimate_map_scan2world;
+    const double translation_update =
+        (pose_after.translation() - pose_before.translation()).norm();
+    const double rotation_update =
+        pose_after.rotation().angularDistance(pose_before.rotation());
+    VLOG(1) << "[MAP] round " << num_rounds << " stride " << stride
+            << ": translation update " << translation_update
+            << ", rotation update " << rotation_update;
+    if (translation_update < options_.min_translation_update &&
+        rotation_update < options_.min_rotation_update) {
+      break;
+    }
+  }
+  VLOG(1) << "[MAP] matched in " << num_rounds << " rounds";
+  LOG_STEP_TIME("MAP", "Optimization", t_opt.toc());
+
+  return true;
+}
+
+void MappingScanMatcher::MatchRound(const HybridGrid &corner_map,
+                                    const HybridGrid &surf_map,
+                                    const TimestampedPointCloud &scan_curr,
+                                    const int stride,
+                                    Rigid3d *pose_estimate_map_scan2world) {
+  const int num_corners =
+      (scan_curr.cloud_corner_less_sharp->size() + stride - 1) / stride;
+  const int num_surfs =
+      (scan_curr.cloud_surf_less_flat->size() + stride - 1) / stride;
+  const int num_blocks = std::max(
+      1, (num_corners + num_surfs + kPointsPerBlock - 1) / kPointsPerBlock);
+  if (static_cast<int>(blocks_.size()) < num_blocks) blocks_.resize(num_blocks);
+  for (int i = 0; i < num_blocks; ++i) {
+    Block &block = blocks_[i];
+    block.corner_begin = int64_t{num_corners} * i / num_blocks;
+    block.corner_end = int64_t{num_corners} * (i + 1) / num_blocks;
+    block.surf_begin = int64_t{num_surfs} * i / num_blocks;
+    block.surf_end = int64_t{num_surfs} * (i + 1) / num_blocks;
+  }
+
+  TicToc t_data;
+  const Rigid3d pose_map_scan2world = *pose_estimate_map_scan2world;
+  const auto associate_block = [&, this](const int i) {
+    AssociateBlock(corner_map, surf_map, scan_curr, pose_map_scan2world,
+                   stride, &blocks_[i]);
+  };
+  if (thread_pool_ != nullptr) {
+    thread_pool_->ParallelFor(0, num_blocks, associate_block);
+  } else {
+    for (int i = 0; i < num_blocks; ++i) associate_block(i);
+  }
+  LOG_STEP_TIME("MAP", "Data association", t_data.toc());
+
+  int corner_num = 0;
+  int surf_num = 0;
+  for (int i = 0; i < num_blocks; ++i) {
+    corner_num += blocks_[i].correspondences.lines.size();
+    surf_num += blocks_[i].correspondences.planes.size();
+  }
+  METRICS_COUNT("MAP/line correspondences", corner_num);
+  METRICS_COUNT("MAP/plane correspondences", surf_num);
+  VLOG(1) << "[MAP] corner_num=" << corner_num << ", surf_num=" << surf_num;
+
+  if (options_.solver_type == ScanMatcherSolverType::kGaussNewton) {
+    SolveGaussNewton(num_blocks, pose_estimate_map_scan2world);
+  } else {
+    SolveCeres(num_blocks, pose_estimate_map_scan2world);
+  }
+}
+
+void MappingScanMatcher::SolveCeres(const int num_blocks,
+                                    Rigid3d *pose_estimate_map_scan2world) {
+  // ceres::LossFunction *loss_function = NULL;
+  ceres::LossFunction *loss_function = new ceres::HuberLoss(0.1);
+  ceres::LocalParameterization *q_parameterization =
+      new ceres::EigenQuaternionParameterization();
+  ceres::Problem::Options problem_options;
+
+  ceres::Problem problem(problem_options);
+  problem.AddParameterBlock(
+      pose_estimate_map_scan2world->rotation().coeffs().data(), 4,
+      q_parameterization);
+  problem.AddParameterBlock(
+      pose_estimate_map_scan2world->translation().data(), 3);
+
+  TicToc t_residual;
+  for (int i = 0; i < num_blocks; ++i) {
+    for (const LineCorrespondence &line : blocks_[i].correspondences.lines) {
+      ceres::CostFunction *cost_function = LidarEdgeFactor::Create(
+          line.curr_point, line.point_a, line.point_b);
+      problem.AddResidualBlock(
+          cost_function, loss_function,
+          pose_estimate_map_scan2world->rotation().coeffs().data(),
+          pose_estimate_map_scan2world->translation().data());
+    }
+  }
+  for (int i = 0; i < num_blocks; ++i) {
+    for (const PlaneCorrespondence &plane :
+         blocks_[i].correspondences.planes) {
+      ceres::CostFunction *cost_function = LidarPlaneFactor::Create(
+          plane.curr_point, plane.center, plane.norm);
+      problem.AddResidualBlock(
+          cost_function, loss_function,
+          pose_estimate_map_scan2world->rotation().coeffs().data(),
+          pose_estimate_map_scan2world->translation().data());
+    }
+  }
+  LOG_STEP_TIME("MAP", "Add residuals", t_residual.toc());
+
+  TicToc t_solver;
+  ceres::Solver::Options options;
+  options.linear_solver_type = ceres::DENSE_QR;
+  options.max_num_iterations = 4;
+  options.num_threads = options_.num_solver_threads;
+  options.minimizer_progress_to_stdout = false;
+  options.check_gradients = false;
+  options.gradient_check_relative_precision = 1e-4;
+  ceres::Solver::Summary summary;
+  ceres::Solve(options, &problem, &summary);
+  LOG_STEP_TIME("MAP", "Solver time", t_solver.toc());
+}
+
+void MappingScanMatcher::SolveGaussNewton(
+    const int num_blocks, Rigid3d *pose_estimate_map_scan2world) {
+  TicToc t_solver;
+  std::vector<const LidarCorrespondences *> correspondences(num_blocks);
+  for (int i = 0; i < num_blocks; ++i) {
+    correspondences[i] = &blocks_[i].correspondences;
+  }
+  const GaussNewtonSummary summary =
+      ::SolveGaussNewton(GaussNewtonOptions(), correspondences, thread_pool_,
+                         pose_estimate_map_scan2world);
+  VLOG(2) << "[MAP] Gauss-Newton " << summary.num_iterations
+          << " iterations, cost " << summary.initial_cost << " -> "
+          << summary.final_cost;
+  LOG_STEP_TIME("MAP", "Solver time", t_solver.toc());
+}
+
+void MappingScanMatcher::AssociateBlock(const HybridGrid &corner_map,
+                                        const HybridGrid &surf_map,
+                                        const TimestampedPointCloud &scan_curr,
+                                        const Rigid3d &pose_map_scan2world,
+                                        const int stride, Block *const block) {
+  std::vector<PointType> &pointSearch = block->point_search;
+  std::vector<float> &pointSearchSqDis = block->point_search_sq_dis;
+  block->correspondences.lines.clear();
+  block->correspondences.planes.clear();
+
+  PointType pointOri, pointSel;
+
+  for (int i = block->corner_begin; i < block->corner_end; i++) {
+    pointOri = scan_curr.cloud_corner_less_sharp->points[i * stride];
+    pointSel = pose_map_scan2world * pointOri;
+    if (corner_map.NearestKSearch(pointSel, 5, 1.0, &pointSearch,
+                                  &pointSearchSqDis) == 5) {
+      Eigen::Matrix<double, 3, 5> matA0;
+      for (int j = 0; j < 5; j++) {
+        matA0.col(j) = pointSearch[j].getVector3fMap().cast<double>();
+      }
+      Eigen::Vector3d center = matA0.rowwise().mean();
+      matA0 = matA0.colwise() - center;
+      Eigen::Matrix3d covMat = matA0 * matA0.transpose();
+
+      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(covMat);
+
+      // if is indeed line feature
+      // note Eigen library sort eigenvalues in increasing order
+      Eigen::Vector3d unit_direction = saes.eigenvectors().col(2);
+      Eigen::Vector3d curr_point(pointOri.x, pointOri.y, pointOri.z);
+      if (saes.eigenvalues()[2] > 3 * saes.eigenvalues()[1]) {
+        const Eigen::Vector3d &point_on_line = center;
+        Eigen::Vector3d point_a, point_b;
+        point_a = 0.1 * unit_direction + point_on_line;
+        point_b = -0.1 * unit_direction + point_on_line;
+        block->correspondences.lines.push_back({curr_point, point_a, point_b});
       }
     }
+  }
 
-    int surf_num = 0;
-    for (size_t i = 0; i < scan_curr.cloud_surf_less_flat->size(); i++) {
-      pointOri = scan_curr.cloud_surf_less_flat->points[i];
-      pointSel = *pose_estimate_map_scan2world * pointOri;
-      kdtreeSurfFromMap->nearestKSearch(pointSel, 5, pointSearchInd,
-                                        pointSearchSqDis);
-
-      if (pointSearchSqDis[4] < 1.0) {
-        Eigen::Matrix<double, 5, 3> matA0;
-        Eigen::Matrix<double, 5, 1> matB0 =
-            -1 * Eigen::Matrix<double, 5, 1>::Ones();
-        for (int j = 0; j < 5; j++) {
-          matA0.row(j) =
-              cloud_map.cloud_surf_less_flat->points[pointSearchInd[j]]
-                  .getVector3fMap()
-                  .cast<double>();
-        }
-        // 平面到原点的垂直向量
-        // 原理：平面ax+by+cz+D=0的法向量是(a,b,c)
-        Eigen::Vector3d norm = matA0.colPivHouseholderQr().solve(matB0);
-        norm.normalize();
-        Eigen::Vector3d center = matA0.colwise().mean();
-
-        bool planeValid = true;
-        for (int j = 0; j < 5; j++) {
-          if (std::abs(norm.dot(matA0.row(j).transpose() - center)) > 0.2) {
-            planeValid = false;
-            break;
-          }
-        }
-        Eigen::Vector3d curr_point(pointOri.x, pointOri.y, pointOri.z);
-        if (planeValid) {
-          ceres::CostFunction *cost_function =
-              LidarPlaneFactor::Create(curr_point, center, norm);
-          problem.AddResidualBlock(
-              cost_function, loss_function,
-              pose_estimate_map_scan2world->rotation().coeffs().data(),
-              pose_estimate_map_scan2world->translation().data());
-          surf_num++;
+  for (int i = block->surf_begin; i < block->surf_end; i++) {
+    pointOri = scan_curr.cloud_surf_less_flat->points[i * stride];
+    pointSel = pose_map_scan2world * pointOri;
+    if (surf_map.NearestKSearch(pointSel, 5, 1.0, &pointSearch,
+                                &pointSearchSqDis) == 5) {
+      Eigen::Matrix<double, 5, 3> matA0;
+      Eigen::Matrix<double, 5, 1> matB0 =
+          -1 * Eigen::Matrix<double, 5, 1>::Ones();
+      for (int j = 0; j < 5; j++) {
+        matA0.row(j) = pointSearch[j].getVector3fMap().cast<double>();
+      }
+      // 平面到原点的垂直向量
+      // 原理：平面ax+by+cz+D=0的法向量是(a,b,c)
+      Eigen::Vector3d norm = matA0.colPivHouseholderQr().solve(matB0);
+      norm.normalize();
+      Eigen::Vector3d center = matA0.colwise().mean();
+
+      bool planeValid = true;
+      for (int j = 0; j < 5; j++) {
+        if (std::abs(norm.dot(matA0.row(j).transpose() - center)) > 0.2) {
+          planeValid = false;
+          break;
         }
       }
+      Eigen::Vector3d curr_point(pointOri.x, pointOri.y, pointOri.z);
+      if (planeValid) {
+        block->correspondences.planes.push_back({curr_point, center, norm});
+      }
     }
-
-    LOG_STEP_TIME("MAP", "Data association", t_data.toc());
-
-    TicToc t_solver;
-    ceres::Solver::Options options;
-    options.linear_solver_type = ceres::DENSE_QR;
-    options.max_num_iterations = 4;
-    options.minimizer_progress_to_stdout = false;
-    options.check_gradients = false;
-    options.gradient_check_relative_precision = 1e-4;
-    ceres::Solver::Summary summary;
-    ceres::Solve(options, &problem, &summary);
-    LOG_STEP_TIME("MAP", "Solver time", t_solver.toc());
   }
-  LOG_STEP_TIME("MAP", "Optimization twice", t_opt.toc());
-
-  return true;
 }
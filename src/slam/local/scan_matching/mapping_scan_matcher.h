@@ -5,14 +5,88 @@
 #ifndef MSF_LOAM_VELODYNE_MAPPING_SCAN_MATCHER_H
 #define MSF_LOAM_VELODYNE_MAPPING_SCAN_MATCHER_H
 
+#include <Eigen/Core>
+#include <vector>
+
+#include "common/thread_pool.h"
 #include "common/timestamped_pointcloud.h"
 #include "slam/hybrid_grid.h"
+#include "slam/local/scan_matching/gauss_newton_solver.h"
+
+struct MappingScanMatcherOptions {
+  ScanMatcherSolverType solver_type = ScanMatcherSolverType::kCeres;
+  // Threads used by ceres to evaluate the residuals. The Gauss-Newton solver
+  // linearizes the association blocks on the association threads instead.
+  int num_solver_threads = 1;
+  // The coarse level of the pyramid matches only every
+  // 'coarse_point_stride'-th feature point, 1 disables the coarse level.
+  int coarse_point_stride = 4;
+  // Rounds of data association and optimization, the first one at the coarse
+  // level and the others at full resolution.
+  int max_num_rounds = 3;
+  // Matching stops after a round which moved the pose by less than this.
+  double min_translation_update = 0.01;
+  double min_rotation_update = 0.002;  // rad
+};
 
+/**
+ * @brief 帧到地图的匹配
+ *
+ * The features of the scan are split into blocks which are associated with
+ * the map in parallel, each block with its own search buffers and
+ * correspondences. The correspondences are added to the problem in block
+ * order afterwards, so the residuals do not depend on the number of threads.
+ * Matching starts with a subset of the features and continues at full
+ * resolution only while the pose still moves noticeably, so well predicted
+ * frames converge after a single cheap round.
+ * A single instance must not be used concurrently.
+ */
 class MappingScanMatcher {
  public:
-  static bool Match(const TimestampedPointCloud &cloud_map,
-                    const TimestampedPointCloud &scan_curr,
-                    Rigid3d *pose_estimate_map_scan2world);
+  // 'thread_pool' is not owned and may be null, then the association runs
+  // on the calling thread only.
+  MappingScanMatcher(const MappingScanMatcherOptions &options,
+                     ThreadPool *thread_pool);
+
+  // Neighbours of the scan points are searched in the map grids directly.
+  bool Match(const HybridGrid &corner_map, const HybridGrid &surf_map,
+             const TimestampedPointCloud &scan_curr,
+             Rigid3d *pose_estimate_map_scan2world);
+
+  // Overrides 'max_num_rounds' of the options for the following matches.
+  void set_max_num_rounds(int max_num_rounds);
+
+ private:
+  struct Block {
+    // 当前块负责的特征点范围 [begin, end)，以 stride 为单位
+    int corner_begin = 0, corner_end = 0;
+    int surf_begin = 0, surf_end = 0;
+
+    std::vector<PointType> point_search;
+    std::vector<float> point_search_sq_dis;
+
+    LidarCorrespondences correspondences;
+  };
+
+  static void AssociateBlock(const HybridGrid &corner_map,
+                             const HybridGrid &surf_map,
+                             const TimestampedPointCloud &scan_curr,
+                             const Rigid3d &pose_map_scan2world, int stride,
+                             Block *block);
+
+  // One round of data association and optimization using every 'stride'-th
+  // feature point.
+  void MatchRound(const HybridGrid &corner_map, const HybridGrid &surf_map,
+                  const TimestampedPointCloud &scan_curr, int stride,
+                  Rigid3d *pose_estimate_map_scan2world);
+
+  // 用前 'num_blocks' 块的对应关系优化位姿
+  void SolveCeres(int num_blocks, Rigid3d *pose_estimate_map_scan2world);
+  void SolveGaussNewton(int num_blocks, Rigid3d *pose_estimate_map_scan2world);
+
+  MappingScanMatcherOptions options_;
+  ThreadPool *const thread_pool_;
+  std::vector<Block> blocks_;
 };
 
 #endif  // MSF_LOAM_VELODYNE_MAPPING_SCAN_MATCHER_H
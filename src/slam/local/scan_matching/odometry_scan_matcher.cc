@@ -1,5 +1,4 @@
 #include <ceres/ceres.h>
-#include <pcl/kdtree/kdtree_flann.h>
 
 #include "common/common.h"
 #include "common/tic_toc.h"
@@ -8,36 +7,64 @@
 
 namespace {
 
-constexpr double kScanPeriod = 0.1;
 constexpr double kDistanceSqThreshold = 25;
-constexpr double kNearByScan = 2.5;
+// 搜索第二、三个对应点的相邻扫描线数
+constexpr int kNearByScan = 2;
 
-// undistort lidar point
+// Scans are deskewed before matching, see ScanDeskewer.
 void TransformToStart(const PointType &pi, PointType &po,
                       const Rigid3d &transform_curr2last) {
-  // interpolation ratio
-  double s;
-  if (DISTORTION)
-    s = (pi.intensity - int(pi.intensity)) / kScanPeriod;
-  else
-    s = 1.0;
-  Eigen::Quaterniond q_point_last =
-      Eigen::Quaterniond::Identity().slerp(s, transform_curr2last.rotation());
-  Eigen::Vector3d t_point_last = s * transform_curr2last.translation();
-  Eigen::Vector3d point(pi.x, pi.y, pi.z);
-  Eigen::Vector3d un_point = q_point_last * point + t_point_last;
-
-  po.x = un_point.x();
-  po.y = un_point.y();
-  po.z = un_point.z();
+  const Eigen::Vector3d point =
+      transform_curr2last * Eigen::Vector3d(pi.x, pi.y, pi.z);
+  po.x = point.x();
+  po.y = point.y();
+  po.z = point.z();
   po.intensity = pi.intensity;
 }
 
+void SolveCeres(const LidarCorrespondences &correspondences,
+                Rigid3d *pose_estimate_curr2last) {
+  // ceres::LossFunction *loss_function = NULL;
+  ceres::LossFunction *loss_function = new ceres::HuberLoss(0.1);
+  ceres::LocalParameterization *q_parameterization =
+      new ceres::EigenQuaternionParameterization();
+  ceres::Problem::Options problem_options;
+
+  ceres::Problem problem(problem_options);
+  problem.AddParameterBlock(pose_estimate_curr2last->rotation().coeffs().data(),
+                            4, q_parameterization);
+  problem.AddParameterBlock(pose_estimate_curr2last->translation().data(), 3);
+  for (const LineCorrespondence &line : correspondences.lines) {
+    ceres::CostFunction *cost_function =
+        LidarEdgeFactor::Create(line.curr_point, line.point_a, line.point_b);
+    problem.AddResidualBlock(
+        cost_function, loss_function,
+        pose_estimate_curr2last->rotation().coeffs().data(),
+        pose_estimate_curr2last->translation().data());
+  }
+  for (const PlaneCorrespondence &plane : correspondences.planes) {
+    ceres::CostFunction *cost_function =
+        LidarPlaneFactor::Create(plane.curr_point, plane.center, plane.norm);
+    problem.AddResidualBlock(
+        cost_function, loss_function,
+        pose_estimate_curr2last->rotation().coeffs().data(),
+        pose_estimate_curr2last->translation().data());
+  }
+
+  ceres::Solver::Options solver_options;
+  solver_options.linear_solver_type = ceres::DENSE_QR;
+  solver_options.max_num_iterations = 4;
+  solver_options.minimizer_progress_to_stdout = false;
+  ceres::Solver::Summary summary;
+  ceres::Solve(solver_options, &problem, &summary);
+}
+
 }  // namespace
 
 bool OdometryScanMatcher::Match(const TimestampedPointCloud &scan_last,
                                 const TimestampedPointCloud &scan_curr,
-                                Rigid3d *pose_estimate_curr2last) {
+                                Rigid3d *pose_estimate_curr2last,
+                                const OdometryScanMatcherOptions &options) {
   PointCloudConstPtr cloud_corner_sharp = scan_curr.cloud_corner_sharp;
   PointCloudConstPtr cloud_corner_less_sharp =
       scan_curr.cloud_corner_less_sharp;
@@ -49,101 +76,50 @@ bool OdometryScanMatcher::Match(const TimestampedPointCloud &scan_last,
   TicToc t_opt;
 
   TicToc t_kdtree;
-  // less sharp 点构造的 kdtree
-  pcl::KdTreeFLANN<PointType>::Ptr kdtree_corner_last(
-      new pcl::KdTreeFLANN<PointType>());
-  kdtree_corner_last->setInputCloud(cloud_corner_last);
-  // less flat 点构造的 kdtree
-  pcl::KdTreeFLANN<PointType>::Ptr kdtree_surf_last(
-      new pcl::KdTreeFLANN<PointType>());
-  kdtree_surf_last->setInputCloud(cloud_surf_last);
+  // less sharp 点和 less flat 点构造的搜索索引，通常已在上一帧匹配时构建
+  const std::shared_ptr<FeatureSearchIndex> corner_last_index =
+      scan_last.corner_less_sharp_index
+          ? scan_last.corner_less_sharp_index
+          : std::make_shared<FeatureSearchIndex>(cloud_corner_last);
+  const std::shared_ptr<FeatureSearchIndex> surf_last_index =
+      scan_last.surf_less_flat_index
+          ? scan_last.surf_less_flat_index
+          : std::make_shared<FeatureSearchIndex>(cloud_surf_last);
+  CHECK(corner_last_index->cloud() == cloud_corner_last);
+  CHECK(surf_last_index->cloud() == cloud_surf_last);
+  const RingSearchIndex &index_corner_last = corner_last_index->Get();
+  const RingSearchIndex &index_surf_last = surf_last_index->Get();
   LOG_STEP_TIME("ODO", "Build kdtree", t_kdtree.toc());
 
-  for (size_t opti_counter = 0; opti_counter < 2; ++opti_counter) {
-    int corner_correspondence = 0, plane_correspondence = 0;
-
-    // ceres::LossFunction *loss_function = NULL;
-    ceres::LossFunction *loss_function = new ceres::HuberLoss(0.1);
-    ceres::LocalParameterization *q_parameterization =
-        new ceres::EigenQuaternionParameterization();
-    ceres::Problem::Options problem_options;
-
-    ceres::Problem problem(problem_options);
-    problem.AddParameterBlock(
-        pose_estimate_curr2last->rotation().coeffs().data(), 4,
-        q_parameterization);
-    problem.AddParameterBlock(pose_estimate_curr2last->translation().data(), 3);
+  LidarCorrespondences correspondences;
+  int num_rounds = 0;
+  while (num_rounds < options.max_num_rounds) {
+    const Rigid3d pose_before = *pose_estimate_curr2last;
+    correspondences.lines.clear();
+    correspondences.planes.clear();
 
     PointType pointSel;
-    std::vector<int> pointSearchInd;
-    std::vector<float> pointSearchSqDis;
+    float pointSearchSqDis;
 
     TicToc t_data;
     // find correspondence for corner features
     for (size_t i = 0; i < cloud_corner_sharp->size(); ++i) {
       TransformToStart(cloud_corner_sharp->points[i], pointSel,
                        *pose_estimate_curr2last);
-      kdtree_corner_last->nearestKSearch(pointSel, 1, pointSearchInd,
-                                         pointSearchSqDis);
-
-      int closestPointInd = -1, minPointInd2 = -1;
-      if (pointSearchSqDis[0] < kDistanceSqThreshold) {
-        closestPointInd = pointSearchInd[0];
-        int closestPointScanID =
-            int(cloud_corner_last->points[closestPointInd].intensity);
-
-        double minPointSqDis2 = kDistanceSqThreshold;
-        // search in the direction of increasing scan line
-        for (int j = closestPointInd + 1; j < (int)cloud_corner_last->size();
-             ++j) {
-          // if in the same scan line, continue
-          if (int(cloud_corner_last->points[j].intensity) <= closestPointScanID)
-            continue;
-
-          // if not in nearby scans, end the loop
-          if (int(cloud_corner_last->points[j].intensity) >
-              (closestPointScanID + kNearByScan))
-            break;
-
-          double pointSqDis =
-              (cloud_corner_last->points[j].x - pointSel.x) *
-                  (cloud_corner_last->points[j].x - pointSel.x) +
-              (cloud_corner_last->points[j].y - pointSel.y) *
-                  (cloud_corner_last->points[j].y - pointSel.y) +
-              (cloud_corner_last->points[j].z - pointSel.z) *
-                  (cloud_corner_last->points[j].z - pointSel.z);
-
-          if (pointSqDis < minPointSqDis2) {
-            // find nearer point
-            minPointSqDis2 = pointSqDis;
-            minPointInd2 = j;
-          }
-        }
-
-        // search in the direction of decreasing scan line
-        for (int j = closestPointInd - 1; j >= 0; --j) {
-          // if in the same scan line, continue
-          if (int(cloud_corner_last->points[j].intensity) >= closestPointScanID)
-            continue;
-
-          // if not in nearby scans, end the loop
-          if (int(cloud_corner_last->points[j].intensity) <
-              (closestPointScanID - kNearByScan))
-            break;
-
-          double pointSqDis =
-              (cloud_corner_last->points[j].x - pointSel.x) *
-                  (cloud_corner_last->points[j].x - pointSel.x) +
-              (cloud_corner_last->points[j].y - pointSel.y) *
-                  (cloud_corner_last->points[j].y - pointSel.y) +
-              (cloud_corner_last->points[j].z - pointSel.z) *
-                  (cloud_corner_last->points[j].z - pointSel.z);
-
-          if (pointSqDis < minPointSqDis2) {
-            // find nearer point
-            minPointSqDis2 = pointSqDis;
-            minPointInd2 = j;
-          }
+      int closestPointInd =
+          index_corner_last.Nearest(pointSel, &pointSearchSqDis);
+
+      int minPointInd2 = -1;
+      if (closestPointInd >= 0 && pointSearchSqDis < kDistanceSqThreshold) {
+        const int closestPointScanID = index_corner_last.ring(closestPointInd);
+
+        // search in nearby scan lines except the closest point's one
+        float minPointSqDis2 = kDistanceSqThreshold;
+        for (int scan_id = closestPointScanID - kNearByScan;
+             scan_id <= closestPointScanID + kNearByScan; ++scan_id) {
+          if (scan_id == closestPointScanID) continue;
+          index_corner_last.SearchRing(pointSel, scan_id, -1, &minPointInd2,
+                                       &minPointSqDis2);
         }
       }
       // both closestPointInd and minPointInd2 is valid
@@ -159,20 +135,8 @@ bool OdometryScanMatcher::Match(const TimestampedPointCloud &scan_last,
                                      cloud_corner_last->points[minPointInd2].y,
                                      cloud_corner_last->points[minPointInd2].z);
 
-        double s;
-        if (DISTORTION)
-          s = (cloud_corner_sharp->points[i].intensity -
-               int(cloud_corner_sharp->points[i].intensity)) /
-              kScanPeriod;
-        else
-          s = 1.0;
-        ceres::CostFunction *cost_function =
-            LidarEdgeFactor::Create(curr_point, last_point_a, last_point_b, s);
-        problem.AddResidualBlock(
-            cost_function, loss_function,
-            pose_estimate_curr2last->rotation().coeffs().data(),
-            pose_estimate_curr2last->translation().data());
-        corner_correspondence++;
+        correspondences.lines.push_back(
+            {curr_point, last_point_a, last_point_b});
       }
     }
 
@@ -180,74 +144,26 @@ bool OdometryScanMatcher::Match(const TimestampedPointCloud &scan_last,
     for (size_t i = 0; i < cloud_surf_flat->size(); ++i) {
       TransformToStart(cloud_surf_flat->points[i], pointSel,
                        *pose_estimate_curr2last);
-      kdtree_surf_last->nearestKSearch(pointSel, 1, pointSearchInd,
-                                       pointSearchSqDis);
-
-      int closestPointInd = -1, minPointInd2 = -1, minPointInd3 = -1;
-      if (pointSearchSqDis[0] < kDistanceSqThreshold) {
-        closestPointInd = pointSearchInd[0];
+      int closestPointInd =
+          index_surf_last.Nearest(pointSel, &pointSearchSqDis);
 
+      int minPointInd2 = -1, minPointInd3 = -1;
+      if (closestPointInd >= 0 && pointSearchSqDis < kDistanceSqThreshold) {
         // get closest point's scan ID
-        int closestPointScanID =
-            int(cloud_surf_last->points[closestPointInd].intensity);
-        double minPointSqDis2 = kDistanceSqThreshold,
-               minPointSqDis3 = kDistanceSqThreshold;
-
-        // search in the direction of increasing scan line
-        for (size_t j = closestPointInd + 1; j < cloud_surf_last->size(); ++j) {
-          // if not in nearby scans, end the loop
-          if (int(cloud_surf_last->points[j].intensity) >
-              (closestPointScanID + kNearByScan))
-            break;
-
-          double pointSqDis = (cloud_surf_last->points[j].x - pointSel.x) *
-                                  (cloud_surf_last->points[j].x - pointSel.x) +
-                              (cloud_surf_last->points[j].y - pointSel.y) *
-                                  (cloud_surf_last->points[j].y - pointSel.y) +
-                              (cloud_surf_last->points[j].z - pointSel.z) *
-                                  (cloud_surf_last->points[j].z - pointSel.z);
-
-          // if in the same or lower scan line
-          if (int(cloud_surf_last->points[j].intensity) <= closestPointScanID &&
-              pointSqDis < minPointSqDis2) {
-            minPointSqDis2 = pointSqDis;
-            minPointInd2 = j;
-          }
-          // if in the higher scan line
-          else if (int(cloud_surf_last->points[j].intensity) >
-                       closestPointScanID &&
-                   pointSqDis < minPointSqDis3) {
-            minPointSqDis3 = pointSqDis;
-            minPointInd3 = j;
-          }
-        }
-
-        // search in the direction of decreasing scan line
-        for (int j = closestPointInd - 1; j >= 0; --j) {
-          // if not in nearby scans, end the loop
-          if (int(cloud_surf_last->points[j].intensity) <
-              (closestPointScanID - kNearByScan))
-            break;
-
-          double pointSqDis = (cloud_surf_last->points[j].x - pointSel.x) *
-                                  (cloud_surf_last->points[j].x - pointSel.x) +
-                              (cloud_surf_last->points[j].y - pointSel.y) *
-                                  (cloud_surf_last->points[j].y - pointSel.y) +
-                              (cloud_surf_last->points[j].z - pointSel.z) *
-                                  (cloud_surf_last->points[j].z - pointSel.z);
-
-          // if in the same or higher scan line
-          if (int(cloud_surf_last->points[j].intensity) >= closestPointScanID &&
-              pointSqDis < minPointSqDis2) {
-            minPointSqDis2 = pointSqDis;
-            minPointInd2 = j;
-          } else if (int(cloud_surf_last->points[j].intensity) <
-                         closestPointScanID &&
-                     pointSqDis < minPointSqDis3) {
-            // find nearer point
-            minPointSqDis3 = pointSqDis;
-            minPointInd3 = j;
-          }
+        const int closestPointScanID = index_surf_last.ring(closestPointInd);
+        float minPointSqDis2 = kDistanceSqThreshold,
+              minPointSqDis3 = kDistanceSqThreshold;
+
+        // the second point is in the same scan line, the third one in a
+        // nearby scan line
+        index_surf_last.SearchRing(pointSel, closestPointScanID,
+                                   closestPointInd, &minPointInd2,
+                                   &minPointSqDis2);
+        for (int scan_id = closestPointScanID - kNearByScan;
+             scan_id <= closestPointScanID + kNearByScan; ++scan_id) {
+          if (scan_id == closestPointScanID) continue;
+          index_surf_last.SearchRing(pointSel, scan_id, -1, &minPointInd3,
+                                     &minPointSqDis3);
         }
 
         if (minPointInd2 >= 0 && minPointInd3 >= 0) {
@@ -265,25 +181,22 @@ bool OdometryScanMatcher::Match(const TimestampedPointCloud &scan_last,
                                        cloud_surf_last->points[minPointInd3].y,
                                        cloud_surf_last->points[minPointInd3].z);
 
-          double s;
-          if (DISTORTION)
-            s = (cloud_surf_flat->points[i].intensity -
-                 int(cloud_surf_flat->points[i].intensity)) /
-                kScanPeriod;
-          else
-            s = 1.0;
-          ceres::CostFunction *cost_function = LidarPlaneFactor::Create(
-              curr_point, last_point_a, last_point_b, last_point_c, s);
-          problem.AddResidualBlock(
-              cost_function, loss_function,
-              pose_estimate_curr2last->rotation().coeffs().data(),
-              pose_estimate_curr2last->translation().data());
-          plane_correspondence++;
+          // 三点确定的平面，与 LidarPlaneFactor::Create 相同
+          Eigen::Vector3d norm = (last_point_a - last_point_b)
+                                     .cross(last_point_a - last_point_c);
+          norm.normalize();
+          correspondences.planes.push_back(
+              {curr_point, (last_point_a + last_point_b + last_point_c) / 3,
+               norm});
         }
       }
     }
 
     LOG_STEP_TIME("ODO", "Data association", t_data.toc());
+    const int corner_correspondence = correspondences.lines.size();
+    const int plane_correspondence = correspondences.planes.size();
+    METRICS_COUNT("ODO/corner correspondences", corner_correspondence);
+    METRICS_COUNT("ODO/plane correspondences", plane_correspondence);
 
     if ((corner_correspondence + plane_correspondence) < 10) {
       LOG(WARNING) << "[MAP] less correspondence: corner_correspondence="
@@ -293,13 +206,26 @@ bool OdometryScanMatcher::Match(const TimestampedPointCloud &scan_last,
     }
 
     TicToc t_solver;
-    ceres::Solver::Options options;
-    options.linear_solver_type = ceres::DENSE_QR;
-    options.max_num_iterations = 4;
-    options.minimizer_progress_to_stdout = false;
-    ceres::Solver::Summary summary;
-    ceres::Solve(options, &problem, &summary);
+    if (options.solver_type == ScanMatcherSolverType::kGaussNewton) {
+      const GaussNewtonSummary summary = SolveGaussNewton(
+          GaussNewtonOptions(), {&correspondences}, nullptr,
+          pose_estimate_curr2last);
+      VLOG(2) << "[ODO] Gauss-Newton " << summary.num_iterations
+              << " iterations, cost " << summary.initial_cost << " -> "
+              << summary.final_cost;
+    } else {
+      SolveCeres(correspondences, pose_estimate_curr2last);
+    }
     LOG_STEP_TIME("ODO", "Solver time", t_solver.toc());
+    ++num_rounds;
+
+    const Rigid3d &pose_after = *pose_estimate_curr2last;
+    if ((pose_after.translation() - pose_before.translation()).norm() <
+            options.min_translation_update &&
+        pose_after.rotation().angularDistance(pose_before.rotation()) <
+            options.min_rotation_update) {
+      break;
+    }
     // if (opti_counter == 0) {
     //   LOG(INFO) << "Odometry match start error: "
     //             << std::sqrt(2 * summary.initial_cost /
@@ -311,7 +237,9 @@ bool OdometryScanMatcher::Match(const TimestampedPointCloud &scan_last,
     //                          (corner_correspondence + plane_correspondence));
     // }
   }
-  LOG_STEP_TIME("ODO", "Optimization twice", t_opt.toc());
+  VLOG(1) << "[ODO] matched in " << num_rounds << " rounds";
+  METRICS_RECORD("ODO/rounds", num_rounds);
+  LOG_STEP_TIME("ODO", "Optimization", t_opt.toc());
 
   return true;
 }
\ No newline at end of file
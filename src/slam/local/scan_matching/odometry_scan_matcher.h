@@ -2,12 +2,26 @@
 #define LOAM_VELODYNE_ODOMETRY_SCAN_MATCHER_H
 
 #include "common/timestamped_pointcloud.h"
+#include "slam/local/scan_matching/gauss_newton_solver.h"
+
+struct OdometryScanMatcherOptions {
+  ScanMatcherSolverType solver_type = ScanMatcherSolverType::kCeres;
+  // Rounds of data association and optimization.
+  int max_num_rounds = 2;
+  // Matching stops after a round which moved the pose by less than this, so
+  // a prediction which agrees with the first round skips the others.
+  double min_translation_update = 0.01;
+  double min_rotation_update = 0.002;  // rad
+};
 
 class OdometryScanMatcher {
  public:
-  static bool Match(const TimestampedPointCloud &scan_last,
-                    const TimestampedPointCloud &scan_curr,
-                    Rigid3d *pose_estimate_curr2last);
+  // 'pose_estimate_curr2last' is the initial guess and the result.
+  static bool Match(
+      const TimestampedPointCloud &scan_last,
+      const TimestampedPointCloud &scan_curr,
+      Rigid3d *pose_estimate_curr2last,
+      const OdometryScanMatcherOptions &options = OdometryScanMatcherOptions());
 };
 
 #endif  // LOAM_VELODYNE_ODOMETRY_SCAN_MATCHER_H
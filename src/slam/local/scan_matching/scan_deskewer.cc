@@ -0,0 +1,38 @@
+#include "slam/local/scan_matching/scan_deskewer.h"
+
+#include <glog/logging.h>
+
+ScanDeskewer::ScanDeskewer(const Rigid3d &motion_between_scans,
+                           const double motion_duration,
+                           const double scan_period)
+    : time_scale_(1. / scan_period) {
+  CHECK_GT(scan_period, 0.);
+  // 帧间的运动可能跨越多个扫描周期（丢帧或时间戳抖动），缩放到一帧
+  const Rigid3d motion =
+      motion_duration > 0.
+          ? ScaleMotion(motion_between_scans, scan_period / motion_duration)
+          : motion_between_scans;
+  const Rigid3d end_inverse = motion.inverse();
+  for (int k = 0; k <= kNumSegments; ++k) {
+    const double s = static_cast<double>(k) / kNumSegments;
+    // 时刻 s 的位姿，从帧首按匀速插值，再变换到帧尾
+    const Rigid3d pose_start_s(
+        s * motion.translation(),
+        Quaternion<double>::Identity().slerp(s, motion.rotation()));
+    table_[k] = ToAffineTransform3f(end_inverse * pose_start_s);
+  }
+}
+
+PointCloudPtr ScanDeskewer::Deskew(const PointCloudConstPtr &cloud) const {
+  PointCloudPtr cloud_out = AcquirePointCloud(cloud->size());
+  cloud_out->header = cloud->header;
+  cloud_out->resize(cloud->size());
+  if (cloud->empty()) return cloud_out;
+  constexpr int kStride = sizeof(PointType) / sizeof(float);
+  // The intensity follows x, y, z and the padding.
+  constexpr int kTimeIndex = 4;
+  DeskewPointsAoS(table_.data(), kNumSegments, kTimeIndex, time_scale_,
+                  cloud->points[0].data, kStride, cloud->size(),
+                  cloud_out->points[0].data);
+  return cloud_out;
+}
@@ -0,0 +1,38 @@
+#ifndef MSF_LOAM_VELODYNE_SCAN_DESKEWER_H
+#define MSF_LOAM_VELODYNE_SCAN_DESKEWER_H
+
+#include <array>
+
+#include "common/point_kernels.h"
+#include "common/timestamped_pointcloud.h"
+
+/**
+ * @brief 点云去畸变
+ *
+ * Moves the points of a scan, captured while the lidar moved by 'motion'
+ * from the scan start to the scan end, into the frame of the scan end. The
+ * motion is sampled once per scan into a table of kNumSegments + 1 poses,
+ * interpolated at constant velocity, and the points are moved in one pass by
+ * linear interpolation in the table, so no point needs a slerp. Afterwards
+ * the scan is matched as if it had been captured at once.
+ */
+class ScanDeskewer {
+ public:
+  static constexpr int kNumSegments = 16;
+
+  // 'motion' is the pose of the current scan end in the frame of the last
+  // scan end, i.e. the curr2last odometry, over 'motion_duration' seconds. It
+  // is scaled at constant velocity to a single sweep of 'scan_period', since
+  // frames may have been dropped in between. The time of a point is the
+  // fractional part of its intensity in seconds, see PointCloudIngest.
+  ScanDeskewer(const Rigid3d &motion, double motion_duration,
+               double scan_period);
+
+  PointCloudPtr Deskew(const PointCloudConstPtr &cloud) const;
+
+ private:
+  std::array<AffineTransform3f, kNumSegments + 1> table_;
+  const float time_scale_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_SCAN_DESKEWER_H
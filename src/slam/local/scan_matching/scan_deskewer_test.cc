@@ -0,0 +1,64 @@
+#include "slam/local/scan_matching/scan_deskewer.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr double kScanPeriod = 0.1;
+
+// A point of ring 3 captured 'time' seconds after the scan start.
+PointType MakePoint(const float x, const float y, const float z,
+                    const float time) {
+  PointType point;
+  point.x = x;
+  point.y = y;
+  point.z = z;
+  point.intensity = 3.f + time;
+  return point;
+}
+
+void ExpectNear(const Eigen::Vector3d &expected, const PointType &point) {
+  EXPECT_NEAR(expected.x(), point.x, 1e-4);
+  EXPECT_NEAR(expected.y(), point.y, 1e-4);
+  EXPECT_NEAR(expected.z(), point.z, 1e-4);
+}
+
+TEST(ScanDeskewerTest, MovesPointsToScanEnd) {
+  const Rigid3d motion(Eigen::Vector3d(1., 0., 0.),
+                       Quaternion<double>::Identity());
+  const ScanDeskewer deskewer(motion, kScanPeriod, kScanPeriod);
+  PointCloudPtr cloud(new PointCloud);
+  cloud->push_back(MakePoint(5.f, 1.f, 0.f, 0.f));
+  cloud->push_back(MakePoint(5.f, 1.f, 0.f, 0.05f));
+  cloud->push_back(MakePoint(5.f, 1.f, 0.f, 0.0999f));
+  const PointCloudPtr deskewed = deskewer.Deskew(cloud);
+  ASSERT_EQ(3u, deskewed->size());
+  ExpectNear(Eigen::Vector3d(4., 1., 0.), deskewed->points[0]);
+  ExpectNear(Eigen::Vector3d(4.5, 1., 0.), deskewed->points[1]);
+  ExpectNear(Eigen::Vector3d(4.999, 1., 0.), deskewed->points[2]);
+  EXPECT_EQ(cloud->points[1].intensity, deskewed->points[1].intensity);
+}
+
+// After a dropped frame the odometry spans two sweeps at constant velocity,
+// the points must only be moved by the motion of one.
+TEST(ScanDeskewerTest, ScalesMotionOfDroppedFrameToOneSweep) {
+  const Rigid3d motion_per_sweep(
+      Eigen::Vector3d(1., 0.2, 0.),
+      Quaternion<double>(Eigen::AngleAxisd(0.1, Eigen::Vector3d::UnitZ())));
+  const Rigid3d motion_two_sweeps = ScaleMotion(motion_per_sweep, 2.);
+  const ScanDeskewer deskewer(motion_two_sweeps, 2. * kScanPeriod,
+                              kScanPeriod);
+  PointCloudPtr cloud(new PointCloud);
+  cloud->push_back(MakePoint(5.f, 1.f, 0.5f, 0.f));
+  const PointCloudPtr deskewed = deskewer.Deskew(cloud);
+  ASSERT_EQ(1u, deskewed->size());
+  ExpectNear(motion_per_sweep.inverse() * Eigen::Vector3d(5., 1., 0.5),
+             deskewed->points[0]);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,85 @@
+#include "slam/local/submaps.h"
+
+#include <glog/logging.h>
+
+#include "common/timestamped_pointcloud.h"
+
+Submap::Submap(const Time &anchor_time, const Rigid3d &local_pose,
+               std::unique_ptr<HybridGrid> corner_grid,
+               std::unique_ptr<HybridGrid> surf_grid)
+    : anchor_time_(anchor_time),
+      local_pose_(local_pose),
+      global_pose_(local_pose),
+      corner_grid_(std::move(corner_grid)),
+      surf_grid_(std::move(surf_grid)) {}
+
+void Submap::InsertScan(const Rigid3d &pose,
+                        const PointCloudConstPtr &corner_cloud,
+                        const PointCloudConstPtr &surf_cloud,
+                        ThreadPool *const thread_pool) {
+  const Rigid3d pose_in_submap = local_pose_.inverse() * pose;
+  // corner 和 surf 地图互不相关，可并行插入
+  const auto insert = [&, this](const int i) {
+    if (i == 0) {
+      corner_grid_->InsertScan(
+          TransformPointCloud(corner_cloud, pose_in_submap));
+    } else {
+      surf_grid_->InsertScan(TransformPointCloud(surf_cloud, pose_in_submap));
+    }
+  };
+  if (thread_pool != nullptr) {
+    thread_pool->ParallelFor(0, 2, insert);
+  } else {
+    insert(0);
+    insert(1);
+  }
+  ++num_scans_;
+}
+
+Submaps::Submaps(const SubmapsOptions &options)
+    : options_(options), frozen_(false) {
+  CHECK(options_.num_scans_per_submap == 0 ||
+        options_.num_scans_per_submap >= 2);
+}
+
+Submaps::Submaps(std::unique_ptr<HybridGrid> corner_grid,
+                 std::unique_ptr<HybridGrid> surf_grid)
+    : frozen_(true) {
+  submaps_.emplace_back(new Submap(Time(), Rigid3d(), std::move(corner_grid),
+                                   std::move(surf_grid)));
+  active_submaps_.push_back(0);
+}
+
+Submap *Submaps::matching_submap() {
+  return active_submaps_.empty() ? nullptr
+                                 : submaps_[active_submaps_.front()].get();
+}
+
+void Submaps::InsertScan(const Time &time, const Rigid3d &pose,
+                         const PointCloudConstPtr &corner_cloud,
+                         const PointCloudConstPtr &surf_cloud,
+                         ThreadPool *const thread_pool) {
+  CHECK(!frozen_) << "Submaps of a loaded map cannot be inserted into.";
+  const int num_scans_per_submap = options_.num_scans_per_submap;
+  if (active_submaps_.empty() ||
+      (num_scans_per_submap > 0 &&
+       submaps_[active_submaps_.back()]->num_scans() >=
+           num_scans_per_submap / 2)) {
+    // 单一地图在地图坐标系中，子地图以第一帧的位姿为原点
+    submaps_.emplace_back(new Submap(
+        time, num_scans_per_submap > 0 ? pose : Rigid3d(),
+        std::unique_ptr<HybridGrid>(
+            new HybridGrid(options_.corner_grid_options)),
+        std::unique_ptr<HybridGrid>(
+            new HybridGrid(options_.surf_grid_options))));
+    active_submaps_.push_back(submaps_.size() - 1);
+  }
+  for (const int index : active_submaps_) {
+    submaps_[index]->InsertScan(pose, corner_cloud, surf_cloud, thread_pool);
+  }
+  if (num_scans_per_submap > 0 &&
+      submaps_[active_submaps_.front()]->num_scans() >=
+          num_scans_per_submap) {
+    active_submaps_.erase(active_submaps_.begin());
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef MSF_LOAM_VELODYNE_SUBMAPS_H
+#define MSF_LOAM_VELODYNE_SUBMAPS_H
+
+#include <memory>
+#include <vector>
+
+#include "common/rigid_transform.h"
+#include "common/thread_pool.h"
+#include "common/time_def.h"
+#include "slam/hybrid_grid.h"
+
+/**
+ * @brief 子地图
+ *
+ * Corner and surf grids in the local frame of the submap. The local pose
+ * anchors that frame in the map frame, the points are stored relative to it.
+ * The global pose is the anchor corrected by loop closure and GPS fusion.
+ * Moving the submap only changes the global pose.
+ */
+class Submap {
+ public:
+  Submap(const Time &anchor_time, const Rigid3d &local_pose,
+         std::unique_ptr<HybridGrid> corner_grid,
+         std::unique_ptr<HybridGrid> surf_grid);
+
+  // Time of the scan the submap was started with.
+  const Time &anchor_time() const { return anchor_time_; }
+  // Transformation from the submap frame to the map frame, which scans are
+  // matched in.
+  const Rigid3d &local_pose() const { return local_pose_; }
+  // Transformation from the submap frame to the corrected frame, equal to
+  // the local pose until corrected.
+  const Rigid3d &global_pose() const { return global_pose_; }
+  void set_global_pose(const Rigid3d &global_pose) {
+    global_pose_ = global_pose;
+  }
+
+  HybridGrid &corner_grid() { return *corner_grid_; }
+  HybridGrid &surf_grid() { return *surf_grid_; }
+  const HybridGrid &corner_grid() const { return *corner_grid_; }
+  const HybridGrid &surf_grid() const { return *surf_grid_; }
+
+  int num_scans() const { return num_scans_; }
+
+  // Adds features given in the scan frame with 'pose' in the map frame. The
+  // corner and surf grids are updated concurrently on 'thread_pool' if not
+  // null.
+  void InsertScan(const Rigid3d &pose, const PointCloudConstPtr &corner_cloud,
+                  const PointCloudConstPtr &surf_cloud,
+                  ThreadPool *thread_pool = nullptr);
+
+ private:
+  const Time anchor_time_;
+  const Rigid3d local_pose_;
+  Rigid3d global_pose_;
+  std::unique_ptr<HybridGrid> corner_grid_;
+  std::unique_ptr<HybridGrid> surf_grid_;
+  int num_scans_ = 0;
+};
+
+struct SubmapsOptions {
+  // Scans inserted into a submap. A new submap is started halfway, so two
+  // submaps are active and the older one, which is matched against, always
+  // covers the last half submap. 0 keeps a single submap in the map frame.
+  int num_scans_per_submap = 0;
+  HybridGridOptions corner_grid_options;
+  HybridGridOptions surf_grid_options;
+};
+
+/**
+ * @brief 子地图序列
+ *
+ * Scans are matched against and inserted into submaps anchored at the scan
+ * they were started with, like the 3D submaps of Cartographer. A correction
+ * of past poses, e.g. by loop closure or GPS fusion, updates the global poses
+ * of the submaps instead of re-inserting their points.
+ */
+class Submaps {
+ public:
+  explicit Submaps(const SubmapsOptions &options);
+
+  // A single submap in the map frame which is only matched against, e.g. the
+  // grids of a saved map.
+  Submaps(std::unique_ptr<HybridGrid> corner_grid,
+          std::unique_ptr<HybridGrid> surf_grid);
+
+  // The oldest active submap, null before the first scan.
+  Submap *matching_submap();
+
+  // Adds the features given in the scan frame to the active submaps and
+  // starts and finishes submaps as needed, see Submap::InsertScan().
+  void InsertScan(const Time &time, const Rigid3d &pose,
+                  const PointCloudConstPtr &corner_cloud,
+                  const PointCloudConstPtr &surf_cloud,
+                  ThreadPool *thread_pool = nullptr);
+
+  int num_submaps() const { return submaps_.size(); }
+  Submap *submap(int index) { return submaps_.at(index).get(); }
+
+ private:
+  const SubmapsOptions options_;
+  const bool frozen_;
+  std::vector<std::unique_ptr<Submap>> submaps_;
+  // Indices of the submaps still inserted into, oldest first.
+  std::vector<int> active_submaps_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_SUBMAPS_H
@@ -0,0 +1,133 @@
+#include "slam/loop_closure/ring_key_index.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+RingKeyIndex::RingKeyIndex(const int dimension) : dimension_(dimension) {
+  CHECK_GT(dimension_, 0);
+}
+
+int RingKeyIndex::Add(const Eigen::VectorXf &key) {
+  CHECK_EQ(key.size(), dimension_);
+  const int id = size_++;
+  std::vector<int> ids = {id};
+  std::vector<float> keys(key.data(), key.data() + dimension_);
+  // 与已占用的同级树合并，直到遇到空的一级
+  size_t level = 0;
+  for (; level < trees_.size() && !trees_[level].ids.empty(); ++level) {
+    Tree &tree = trees_[level];
+    ids.insert(ids.end(), tree.ids.begin(), tree.ids.end());
+    keys.insert(keys.end(), tree.keys.begin(), tree.keys.end());
+    tree = Tree();
+  }
+  if (level == trees_.size()) trees_.emplace_back();
+  Build(std::move(ids), std::move(keys), &trees_[level]);
+  return id;
+}
+
+void RingKeyIndex::Build(std::vector<int> ids, std::vector<float> keys,
+                         Tree *const tree) const {
+  const int num_keys = ids.size();
+  std::vector<int> order(num_keys);
+  std::iota(order.begin(), order.end(), 0);
+  std::vector<int> split_dims(num_keys, 0);
+  BuildRange(keys, 0, num_keys, &order, &split_dims);
+
+  tree->ids.resize(num_keys);
+  tree->keys.resize(keys.size());
+  tree->split_dims = std::move(split_dims);
+  for (int i = 0; i < num_keys; ++i) {
+    tree->ids[i] = ids[order[i]];
+    std::copy_n(keys.begin() + order[i] * dimension_, dimension_,
+                tree->keys.begin() + i * dimension_);
+  }
+  tree->min_id = *std::min_element(ids.begin(), ids.end());
+}
+
+void RingKeyIndex::BuildRange(const std::vector<float> &keys, const int begin,
+                              const int end, std::vector<int> *const order,
+                              std::vector<int> *const split_dims) const {
+  if (end - begin <= 1) return;
+  // 沿跨度最大的维度划分
+  int split_dim = 0;
+  float max_spread = -1.f;
+  for (int d = 0; d < dimension_; ++d) {
+    float min_value = std::numeric_limits<float>::max();
+    float max_value = std::numeric_limits<float>::lowest();
+    for (int i = begin; i < end; ++i) {
+      const float value = keys[(*order)[i] * dimension_ + d];
+      min_value = std::min(min_value, value);
+      max_value = std::max(max_value, value);
+    }
+    if (max_value - min_value > max_spread) {
+      max_spread = max_value - min_value;
+      split_dim = d;
+    }
+  }
+  const int median = begin + (end - begin) / 2;
+  std::nth_element(order->begin() + begin, order->begin() + median,
+                   order->begin() + end, [&](const int a, const int b) {
+                     return keys[a * dimension_ + split_dim] <
+                            keys[b * dimension_ + split_dim];
+                   });
+  (*split_dims)[median] = split_dim;
+  BuildRange(keys, begin, median, order, split_dims);
+  BuildRange(keys, median + 1, end, order, split_dims);
+}
+
+void RingKeyIndex::Search(const Eigen::VectorXf &query, const int k,
+                          const int max_id, std::vector<int> *const ids,
+                          std::vector<float> *const squared_distances) const {
+  CHECK_EQ(query.size(), dimension_);
+  ids->clear();
+  squared_distances->clear();
+  if (k <= 0) return;
+  Neighbors neighbors;
+  for (const Tree &tree : trees_) {
+    if (tree.ids.empty() || tree.min_id >= max_id) continue;
+    SearchRange(tree, 0, tree.ids.size(), query.data(), k, max_id,
+                &neighbors);
+  }
+  ids->resize(neighbors.size());
+  squared_distances->resize(neighbors.size());
+  for (int i = neighbors.size() - 1; i >= 0; --i) {
+    (*squared_distances)[i] = neighbors.top().first;
+    (*ids)[i] = neighbors.top().second;
+    neighbors.pop();
+  }
+}
+
+void RingKeyIndex::SearchRange(const Tree &tree, const int begin,
+                               const int end, const float *const query,
+                               const int k, const int max_id,
+                               Neighbors *const neighbors) const {
+  if (begin >= end) return;
+  const int median = begin + (end - begin) / 2;
+  const float *const key = tree.keys.data() + median * dimension_;
+  if (tree.ids[median] < max_id) {
+    float squared_distance = 0.f;
+    for (int d = 0; d < dimension_; ++d) {
+      squared_distance += (query[d] - key[d]) * (query[d] - key[d]);
+    }
+    if (static_cast<int>(neighbors->size()) < k) {
+      neighbors->emplace(squared_distance, tree.ids[median]);
+    } else if (squared_distance < neighbors->top().first) {
+      neighbors->pop();
+      neighbors->emplace(squared_distance, tree.ids[median]);
+    }
+  }
+  if (end - begin == 1) return;
+  const int split_dim = tree.split_dims[median];
+  const float diff = query[split_dim] - key[split_dim];
+  const bool left_first = diff < 0.f;
+  SearchRange(tree, left_first ? begin : median + 1,
+              left_first ? median : end, query, k, max_id, neighbors);
+  // 另一侧只在可能有更近的键时搜索
+  if (static_cast<int>(neighbors->size()) < k ||
+      diff * diff < neighbors->top().first) {
+    SearchRange(tree, left_first ? median + 1 : begin,
+                left_first ? end : median, query, k, max_id, neighbors);
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef MSF_LOAM_VELODYNE_RING_KEY_INDEX_H
+#define MSF_LOAM_VELODYNE_RING_KEY_INDEX_H
+
+#include <Eigen/Core>
+#include <queue>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 环键的增量 kd 树索引
+ *
+ * Nearest neighbour search over fixed size keys which are only ever added.
+ * The keys are kept in kd-trees of 2^0, 2^1, 2^2, ... keys, at most one per
+ * size. Adding a key merges the trees of the sizes already taken with it into
+ * one of the next free size, like a binary counter increments. So a key is
+ * rebuilt into a tree O(log n) times, whatever the total number of keys, and
+ * a search visits O(log n) trees of O(log n) depth instead of all keys.
+ * Not thread safe.
+ */
+class RingKeyIndex {
+ public:
+  explicit RingKeyIndex(int dimension);
+
+  // Adds 'key' with the next id, the first key gets 0.
+  int Add(const Eigen::VectorXf &key);
+
+  // Finds the up to 'k' keys with an id less than 'max_id' closest to
+  // 'query', sorted by distance.
+  void Search(const Eigen::VectorXf &query, int k, int max_id,
+              std::vector<int> *ids,
+              std::vector<float> *squared_distances) const;
+
+  int size() const { return size_; }
+
+ private:
+  // Keys in kd order: the median of [begin, end) splits the range along
+  // 'split_dims[median]' into the subtrees [begin, median) and
+  // [median + 1, end).
+  struct Tree {
+    std::vector<int> ids;
+    std::vector<float> keys;  // ids.size() x dimension
+    std::vector<int> split_dims;
+    int min_id = 0;
+  };
+
+  // Max heap of (squared distance, id).
+  using Neighbors = std::priority_queue<std::pair<float, int>>;
+
+  void Build(std::vector<int> ids, std::vector<float> keys, Tree *tree) const;
+
+  void BuildRange(const std::vector<float> &keys, int begin, int end,
+                  std::vector<int> *order, std::vector<int> *split_dims) const;
+
+  void SearchRange(const Tree &tree, int begin, int end, const float *query,
+                   int k, int max_id, Neighbors *neighbors) const;
+
+  const int dimension_;
+  // trees_[i] holds 2^i keys or none.
+  std::vector<Tree> trees_;
+  int size_ = 0;
+};
+
+#endif  // MSF_LOAM_VELODYNE_RING_KEY_INDEX_H
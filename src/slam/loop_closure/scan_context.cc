@@ -0,0 +1,96 @@
+#include "slam/loop_closure/scan_context.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+float ColumnDistance(const Eigen::MatrixXf &query,
+                     const Eigen::MatrixXf &candidate, const int shift) {
+  const int num_sectors = query.cols();
+  float sum = 0.f;
+  int num_columns = 0;
+  for (int j = 0; j < num_sectors; ++j) {
+    const auto column_query = query.col(j);
+    const auto column_candidate = candidate.col((j + shift) % num_sectors);
+    const float norm = column_query.norm() * column_candidate.norm();
+    // 任一帧为空的扇区不参与比较
+    if (norm == 0.f) continue;
+    sum += column_query.dot(column_candidate) / norm;
+    ++num_columns;
+  }
+  return num_columns == 0 ? 1.f : 1.f - sum / num_columns;
+}
+
+}  // namespace
+
+ScanContext ComputeScanContext(const PointCloud &cloud,
+                               const ScanContextOptions &options) {
+  CHECK_GT(options.num_rings, 0);
+  CHECK_GT(options.num_sectors, 0);
+  ScanContext scan_context;
+  Eigen::MatrixXf &descriptor = scan_context.descriptor;
+  descriptor.setZero(options.num_rings, options.num_sectors);
+  const double ring_scale = options.num_rings / options.max_range;
+  const double sector_scale = options.num_sectors / (2 * M_PI);
+  for (const PointType &point : cloud.points) {
+    const double range = std::sqrt(point.x * point.x + point.y * point.y);
+    if (range >= options.max_range) continue;
+    const int ring = std::min(static_cast<int>(range * ring_scale),
+                              options.num_rings - 1);
+    const int sector =
+        std::min(static_cast<int>((std::atan2(point.y, point.x) + M_PI) *
+                                  sector_scale),
+                 options.num_sectors - 1);
+    const float height = point.z + options.lidar_height;
+    float &bin = descriptor(ring, sector);
+    bin = std::max(bin, height);
+  }
+  scan_context.ring_key =
+      (descriptor.array() > 0.f).cast<float>().rowwise().mean();
+  scan_context.sector_key = descriptor.colwise().mean().transpose();
+  return scan_context;
+}
+
+float ScanContextDistance(const ScanContext &query,
+                          const ScanContext &candidate,
+                          const ScanContextOptions &options,
+                          int *const best_shift) {
+  const int num_sectors = query.descriptor.cols();
+  CHECK_EQ(num_sectors, candidate.descriptor.cols());
+  // 先用扇区键对齐，只在其附近比较完整的描述子
+  int key_shift = 0;
+  float min_key_distance = std::numeric_limits<float>::max();
+  for (int shift = 0; shift < num_sectors; ++shift) {
+    float key_distance = 0.f;
+    for (int j = 0; j < num_sectors; ++j) {
+      const float d = query.sector_key[j] -
+                      candidate.sector_key[(j + shift) % num_sectors];
+      key_distance += d * d;
+    }
+    if (key_distance < min_key_distance) {
+      min_key_distance = key_distance;
+      key_shift = shift;
+    }
+  }
+
+  float min_distance = std::numeric_limits<float>::max();
+  for (int offset = -options.search_radius; offset <= options.search_radius;
+       ++offset) {
+    const int shift =
+        ((key_shift + offset) % num_sectors + num_sectors) % num_sectors;
+    const float distance =
+        ColumnDistance(query.descriptor, candidate.descriptor, shift);
+    if (distance < min_distance) {
+      min_distance = distance;
+      *best_shift = shift;
+    }
+  }
+  return min_distance;
+}
+
+double ShiftToYaw(const int shift, const ScanContextOptions &options) {
+  return 2 * M_PI * shift / options.num_sectors;
+}
@@ -0,0 +1,51 @@
+#ifndef MSF_LOAM_VELODYNE_SCAN_CONTEXT_H
+#define MSF_LOAM_VELODYNE_SCAN_CONTEXT_H
+
+#include <Eigen/Core>
+
+#include "common/common.h"
+
+struct ScanContextOptions {
+  int num_rings = 20;
+  int num_sectors = 60;
+  double max_range = 80.;  // m
+  // Added to the point heights so that the ground is above 0.
+  double lidar_height = 2.;  // m
+  // Columns searched on both sides of the shift aligning the sector keys.
+  int search_radius = 3;
+};
+
+/**
+ * @brief Scan Context 描述子
+ *
+ * Polar grid of the scan around the lidar with the maximum point height of
+ * every bin, see Kim and Kim, "Scan Context: Egocentric Spatial Descriptor
+ * for Place Recognition within 3D Point Cloud Map", IROS 2018. A row is a
+ * ring of equal range, a column is a sector of equal azimuth, so a yaw of
+ * the lidar shifts the columns.
+ */
+struct ScanContext {
+  // num_rings x num_sectors
+  Eigen::MatrixXf descriptor;
+  // Occupancy of every ring, invariant to the yaw and used for the retrieval.
+  Eigen::VectorXf ring_key;
+  // Mean of every sector, used to estimate the column shift.
+  Eigen::VectorXf sector_key;
+};
+
+// 'cloud' is in the lidar frame with z up.
+ScanContext ComputeScanContext(const PointCloud &cloud,
+                               const ScanContextOptions &options);
+
+// Mean cosine distance in [0, 1] between the columns of 'query' and those of
+// 'candidate' shifted by 'shift', i.e. query column j is compared against
+// candidate column (j + shift) % num_sectors. The shift is searched around
+// the one aligning the sector keys and returned in 'best_shift'.
+float ScanContextDistance(const ScanContext &query,
+                          const ScanContext &candidate,
+                          const ScanContextOptions &options, int *best_shift);
+
+// Yaw of the query lidar in the frame of the candidate lidar for a shift.
+double ShiftToYaw(int shift, const ScanContextOptions &options);
+
+#endif  // MSF_LOAM_VELODYNE_SCAN_CONTEXT_H
@@ -3,8 +3,301 @@
 //
 
 #include "slam/loop_closure/sparse_pose_graph.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "common/metrics.h"
+#include "common/tic_toc.h"
+#include "slam/hybrid_grid.h"
 #include "slam/loop_closure/pose_graph_factor.h"
 
-SparsePoseGraph::SparsePoseGraph() {}
+SparsePoseGraph::SparsePoseGraph(const SparsePoseGraphOptions &options,
+                                 const bool is_offline_mode)
+    : options_(options),
+      ring_key_index_(options.scan_context_options.num_rings),
+      scan_matcher_(options.scan_matcher_options, nullptr) {
+  LOG(INFO) << "SparsePoseGraph started!";
+  PipelineStageOptions stage_options;
+  stage_options.name = "LOOP";
+  stage_options.queue_size = options_.queue_size;
+  stage_options.drop_when_full = !is_offline_mode;
+  stage_options.blocking = true;
+  detection_stage_.reset(new PipelineStage<DetectionInput>(
+      stage_options,
+      [this](DetectionInput input) { this->DetectLoop(input); }));
+}
+
+SparsePoseGraph::~SparsePoseGraph() {
+  detection_stage_.reset();
+  LOG(INFO) << "SparsePoseGraph finished with " << num_loop_closures()
+            << " loop closures.";
+}
+
+void SparsePoseGraph::AddScan(const Time &time, const Rigid3d &pose,
+                              const PointCloudConstPtr &corner_cloud,
+                              const PointCloudConstPtr &surf_cloud,
+                              const PointCloudConstPtr &full_res_cloud) {
+  int keyframe_id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Rigid3d local_to_optimized;
+    if (!keyframes_.empty()) {
+      const Keyframe &last = keyframes_.back();
+      const Rigid3d motion = last.local_pose.inverse() * pose;
+      if (motion.translation().norm() < options_.keyframe_distance &&
+          motion.rotation().angularDistance(Quaternion<double>::Identity()) <
+              options_.keyframe_angle) {
+        return;
+      }
+      local_to_optimized = last.optimized_pose * last.local_pose.inverse();
+    }
+    keyframe_id = keyframes_.size();
+    // 关键帧的点云保留整个运行期间，复制为恰好的大小，而不是占用对象池中
+    // 按降采样前点数分配的缓冲区
+    keyframes_.push_back({time, pose, local_to_optimized * pose,
+                          PointCloudConstPtr(new PointCloud(*corner_cloud)),
+                          PointCloudConstPtr(new PointCloud(*surf_cloud))});
+  }
+  detection_stage_->Push({keyframe_id, full_res_cloud});
+}
+
+int SparsePoseGraph::num_loop_closures() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return loop_edges_.size();
+}
+
+Rigid3d SparsePoseGraph::local_to_optimized() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (keyframes_.empty()) return Rigid3d();
+  const Keyframe &last = keyframes_.back();
+  return last.optimized_pose * last.local_pose.inverse();
+}
+
+Rigid3d SparsePoseGraph::LocalToOptimized(const Time &time) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (keyframes_.empty()) return Rigid3d();
+  auto it = std::upper_bound(
+      keyframes_.begin(), keyframes_.end(), time,
+      [](const Time &t, const Keyframe &keyframe) {
+        return t < keyframe.timestamp;
+      });
+  if (it != keyframes_.begin()) --it;
+  return it->optimized_pose * it->local_pose.inverse();
+}
+
+int SparsePoseGraph::num_optimizations() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_optimizations_;
+}
+
+void SparsePoseGraph::DetectLoop(const DetectionInput &input) {
+  TicToc t_detect;
+  const ScanContextOptions &sc_options = options_.scan_context_options;
+  ScanContext scan_context =
+      ComputeScanContext(*input.full_res_cloud, sc_options);
+
+  // 只在足够早的关键帧中检索，索引编号随关键帧编号递增
+  const int max_index_id =
+      std::lower_bound(
+          index_keyframe_ids_.begin(), index_keyframe_ids_.end(),
+          input.keyframe_id - options_.num_recent_keyframes_excluded) -
+      index_keyframe_ids_.begin();
+  std::vector<int> index_ids;
+  std::vector<float> squared_distances;
+  ring_key_index_.Search(scan_context.ring_key, options_.num_candidates,
+                         max_index_id, &index_ids, &squared_distances);
+  int best_index_id = -1;
+  int best_shift = 0;
+  float min_distance = std::numeric_limits<float>::max();
+  for (const int index_id : index_ids) {
+    int shift;
+    const float distance = ScanContextDistance(
+        scan_context, scan_contexts_[index_id], sc_options, &shift);
+    if (distance < min_distance) {
+      min_distance = distance;
+      best_index_id = index_id;
+      best_shift = shift;
+    }
+  }
+  ring_key_index_.Add(scan_context.ring_key);
+  scan_contexts_.push_back(std::move(scan_context));
+  index_keyframe_ids_.push_back(input.keyframe_id);
+  LOG_STEP_TIME("LOOP", "Detect loop", t_detect.toc());
+
+  if (best_index_id < 0 || min_distance > options_.max_descriptor_distance) {
+    return;
+  }
+  METRICS_COUNT("LOOP/candidates", 1);
+  const int candidate = index_keyframe_ids_[best_index_id];
+  TicToc t_verify;
+  Rigid3d pose_candidate_query;
+  const bool accepted = VerifyCandidate(candidate, input.keyframe_id,
+                                        ShiftToYaw(best_shift, sc_options),
+                                        &pose_candidate_query);
+  LOG_STEP_TIME("LOOP", "Verify candidate", t_verify.toc());
+  if (!accepted) return;
+
+  METRICS_COUNT("LOOP/loop closures", 1);
+  LOG(INFO) << "[LOOP] keyframe " << input.keyframe_id
+            << " closes a loop with keyframe " << candidate
+            << ", descriptor distance " << min_distance;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loop_edges_.push_back({candidate, input.keyframe_id, pose_candidate_query});
+  }
+  OptimizeGraph(candidate);
+}
+
+bool SparsePoseGraph::VerifyCandidate(const int candidate, const int query,
+                                      const double yaw,
+                                      Rigid3d *const pose_candidate_query) {
+  // 候选关键帧前后的局部地图，其位姿在地图坐标系中局部一致
+  const int begin = std::max(0, candidate - options_.num_submap_keyframes);
+  const int end =
+      std::min(query, candidate + options_.num_submap_keyframes + 1);
+  std::vector<Keyframe> submap_keyframes;
+  Keyframe query_keyframe;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    submap_keyframes.assign(keyframes_.begin() + begin,
+                            keyframes_.begin() + end);
+    query_keyframe = keyframes_[query];
+  }
+  const Rigid3d candidate_pose = submap_keyframes[candidate - begin].local_pose;
+
+  HybridGridOptions grid_options;
+  grid_options.leaf_size = options_.submap_line_resolution;
+  HybridGrid corner_map(grid_options);
+  grid_options.leaf_size = options_.submap_plane_resolution;
+  HybridGrid surf_map(grid_options);
+  for (const Keyframe &keyframe : submap_keyframes) {
+    corner_map.InsertScan(
+        TransformPointCloud(keyframe.corner_cloud, keyframe.local_pose));
+    surf_map.InsertScan(
+        TransformPointCloud(keyframe.surf_cloud, keyframe.local_pose));
+  }
+  TimestampedPointCloud scan;
+  scan.cloud_corner_less_sharp.reset(
+      new PointCloud(*query_keyframe.corner_cloud));
+  scan.cloud_surf_less_flat.reset(new PointCloud(*query_keyframe.surf_cloud));
+
+  // 初值：候选关键帧的位姿加上描述子对齐得到的航向角
+  Rigid3d pose = candidate_pose *
+                 Rigid3d::Rotation(Quaternion<double>(
+                     Eigen::AngleAxisd(yaw, Vector<double>::UnitZ())));
+  corner_map.UpdatePose(pose);
+  surf_map.UpdatePose(pose);
+  scan_matcher_.Match(corner_map, surf_map, scan, &pose);
+
+  const PointCloudPtr surf_points =
+      TransformPointCloud(scan.cloud_surf_less_flat, pose);
+  if (surf_points->empty()) return false;
+  const float max_squared_distance =
+      options_.max_inlier_distance * options_.max_inlier_distance;
+  std::vector<PointType> neighbors;
+  std::vector<float> squared_distances;
+  int num_inliers = 0;
+  for (const PointType &point : surf_points->points) {
+    num_inliers += surf_map.NearestKSearch(point, 1, max_squared_distance,
+                                           &neighbors, &squared_distances);
+  }
+  const double inlier_ratio =
+      static_cast<double>(num_inliers) / surf_points->size();
+  VLOG(1) << "[LOOP] keyframe " << query << " against " << candidate
+          << ": inlier ratio " << inlier_ratio;
+  if (inlier_ratio < options_.min_inlier_ratio) return false;
+  *pose_candidate_query = candidate_pose.inverse() * pose;
+  return true;
+}
+
+void SparsePoseGraph::OptimizeGraph(const int first_keyframe) {
+  TicToc t_optimize;
+  // 只优化闭环所在的一段，更早的关键帧保持不变。跨过这段起点的旧闭环边
+  // 以其更早的一端为常量
+  std::vector<LoopEdge> loop_edges;
+  int begin = first_keyframe;
+  std::vector<Rigid3d> local_poses;
+  std::vector<Rigid3d> poses;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const LoopEdge &edge : loop_edges_) {
+      if (edge.query < first_keyframe) continue;
+      loop_edges.push_back(edge);
+      begin = std::min(begin, edge.candidate);
+    }
+    for (size_t i = begin; i < keyframes_.size(); ++i) {
+      local_poses.push_back(keyframes_[i].local_pose);
+      poses.push_back(keyframes_[i].optimized_pose);
+    }
+  }
+  const int end = begin + poses.size();
+  const auto pose = [&poses, begin](const int keyframe) -> Rigid3d & {
+    return poses[keyframe - begin];
+  };
+
+  ceres::Problem problem;
+  ceres::Solver::Options options;
+  options.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
+  options.minimizer_progress_to_stdout = false;
+  options.max_num_iterations = options_.max_num_iterations;
+  ceres::Solver::Summary summary;
+  ceres::LossFunction *loss_function = new ceres::HuberLoss(1.0);
+  ceres::LocalParameterization *local_parameterization =
+      new ceres::EigenQuaternionParameterization();
+
+  const auto add_pose = [&](const int keyframe, const bool constant) {
+    Rigid3d &p = pose(keyframe);
+    if (problem.HasParameterBlock(p.translation().data())) return;
+    problem.AddParameterBlock(p.rotation().coeffs().data(), 4,
+                              local_parameterization);
+    problem.AddParameterBlock(p.translation().data(), 3);
+    if (constant) {
+      problem.SetParameterBlockConstant(p.rotation().coeffs().data());
+      problem.SetParameterBlockConstant(p.translation().data());
+    }
+  };
+  add_pose(first_keyframe, true);
+  for (int i = first_keyframe + 1; i < end; ++i) add_pose(i, false);
+  for (const LoopEdge &edge : loop_edges) {
+    if (edge.candidate < first_keyframe) add_pose(edge.candidate, true);
+  }
+
+  for (int i = first_keyframe; i + 1 < end; ++i) {
+    auto cost_function = PoseGraphEdgeFactor::Create(
+        local_poses[i - begin].inverse() * local_poses[i + 1 - begin],
+        options_.odometry_rotation_sigma, options_.odometry_translation_sigma);
+    problem.AddResidualBlock(cost_function, nullptr,
+                             pose(i).rotation().coeffs().data(),
+                             pose(i).translation().data(),
+                             pose(i + 1).rotation().coeffs().data(),
+                             pose(i + 1).translation().data());
+  }
+  for (const LoopEdge &edge : loop_edges) {
+    auto cost_function = PoseGraphEdgeFactor::Create(
+        edge.pose_candidate_query, options_.loop_rotation_sigma,
+        options_.loop_translation_sigma);
+    problem.AddResidualBlock(cost_function, loss_function,
+                             pose(edge.candidate).rotation().coeffs().data(),
+                             pose(edge.candidate).translation().data(),
+                             pose(edge.query).rotation().coeffs().data(),
+                             pose(edge.query).translation().data());
+  }
+
+  ceres::Solve(options, &problem, &summary);
+  LOG_STEP_TIME("LOOP", "Optimize pose graph", t_optimize.toc());
+  VLOG(1) << "[LOOP] keyframes " << first_keyframe << " to " << end - 1
+          << ", " << loop_edges.size() << " loops: " << summary.BriefReport();
 
-SparsePoseGraph::~SparsePoseGraph() {}
+  // Keyframes added meanwhile follow the correction of the last solved one.
+  std::lock_guard<std::mutex> lock(mutex_);
+  const Rigid3d local_to_optimized =
+      poses.back() * local_poses.back().inverse();
+  for (size_t i = first_keyframe; i < keyframes_.size(); ++i) {
+    keyframes_[i].optimized_pose =
+        static_cast<int>(i) < end
+            ? pose(i)
+            : local_to_optimized * keyframes_[i].local_pose;
+  }
+  ++num_optimizations_;
+}
@@ -5,11 +5,145 @@
 #ifndef MSF_LOAM_VELODYNE_SPARSE_POSE_GRAPH_H
 #define MSF_LOAM_VELODYNE_SPARSE_POSE_GRAPH_H
 
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/pipeline_stage.h"
+#include "common/rigid_transform.h"
+#include "common/time_def.h"
+#include "common/timestamped_pointcloud.h"
+#include "slam/local/scan_matching/mapping_scan_matcher.h"
+#include "slam/loop_closure/ring_key_index.h"
+#include "slam/loop_closure/scan_context.h"
+
+struct SparsePoseGraphOptions {
+  // A mapped scan becomes a keyframe after this motion since the last one.
+  double keyframe_distance = 1.;  // m
+  double keyframe_angle = 0.2;    // rad
+  ScanContextOptions scan_context_options;
+  // The newest keyframes are not loop candidates of a keyframe.
+  int num_recent_keyframes_excluded = 100;
+  // Keyframes retrieved by the ring key and compared by the descriptor.
+  int num_candidates = 10;
+  float max_descriptor_distance = 0.3f;
+  // The best candidate is verified by matching the keyframe against the
+  // features of the candidate and of this many keyframes on each side.
+  int num_submap_keyframes = 10;
+  float submap_line_resolution = 0.2f;
+  float submap_plane_resolution = 0.4f;
+  MappingScanMatcherOptions scan_matcher_options;
+  // A match is accepted if this fraction of the surf points is closer than
+  // 'max_inlier_distance' to the submap.
+  double min_inlier_ratio = 0.7;
+  double max_inlier_distance = 0.3;  // m
+  // 边的标准差
+  double odometry_rotation_sigma = 0.01;
+  double odometry_translation_sigma = 0.1;
+  double loop_rotation_sigma = 0.02;
+  double loop_translation_sigma = 0.2;
+  int max_num_iterations = 10;
+  // Keyframes waiting for the detection, in online mode the newest are not
+  // searched for loops when exceeded.
+  int queue_size = 64;
+};
+
+/**
+ * @brief 基于 Scan Context 的闭环检测和位姿图优化
+ *
+ * Mapped scans are thinned out to keyframes on the mapping thread. A
+ * background thread computes the Scan Context of every keyframe and retrieves
+ * the keyframes with the closest ring keys from a RingKeyIndex, so the search
+ * grows with the logarithm of the number of keyframes. The candidate with the
+ * smallest descriptor distance is verified by matching the keyframe with
+ * MappingScanMatcher against a submap around the candidate, starting from
+ * the yaw of the descriptor alignment. Accepted loops are added as
+ * PoseGraphEdgeFactor edges to the graph of the relative poses between
+ * consecutive keyframes. The keyframes from the candidate of the new loop on
+ * are then optimized on the same thread.
+ */
 class SparsePoseGraph {
  public:
-  SparsePoseGraph();
+  SparsePoseGraph(const SparsePoseGraphOptions &options, bool is_offline_mode);
 
+  // Searches the queued keyframes for loops before returning.
   ~SparsePoseGraph();
+
+  SparsePoseGraph(const SparsePoseGraph &) = delete;
+  SparsePoseGraph &operator=(const SparsePoseGraph &) = delete;
+
+  // Called on the mapping thread with the mapped pose and the downsampled
+  // features in the scan frame. The features of a keyframe are copied,
+  // 'full_res_cloud' must not be modified afterwards.
+  void AddScan(const Time &time, const Rigid3d &pose,
+               const PointCloudConstPtr &corner_cloud,
+               const PointCloudConstPtr &surf_cloud,
+               const PointCloudConstPtr &full_res_cloud);
+
+  int num_loop_closures() const;
+
+  // Correction of the newest keyframe from the map frame to the optimized
+  // frame, identity until the first loop closure. LaserMapping applies it to
+  // the published poses.
+  Rigid3d local_to_optimized() const;
+
+  // Correction of the last keyframe not newer than 'time', or of the first
+  // keyframe. Submaps are re-anchored with the correction at their anchor.
+  Rigid3d LocalToOptimized(const Time &time) const;
+
+  // Incremented after every optimization which changed the corrections.
+  int num_optimizations() const;
+
+ private:
+  struct Keyframe {
+    Time timestamp;
+    Rigid3d local_pose;
+    Rigid3d optimized_pose;
+    PointCloudConstPtr corner_cloud;
+    PointCloudConstPtr surf_cloud;
+  };
+
+  struct LoopEdge {
+    // 'query' is the newer keyframe.
+    int candidate;
+    int query;
+    Rigid3d pose_candidate_query;
+  };
+
+  struct DetectionInput {
+    int keyframe_id;
+    PointCloudConstPtr full_res_cloud;
+  };
+
+  // On the loop closure thread.
+  void DetectLoop(const DetectionInput &input);
+
+  bool VerifyCandidate(int candidate, int query, double yaw,
+                       Rigid3d *pose_candidate_query);
+
+  // Optimizes the keyframes from 'first_keyframe' on, which is held
+  // constant, against the odometry edges between them and the loop edges
+  // ending in them. Older keyframes are not changed, so the cost grows with
+  // the length of the loop instead of the trajectory.
+  void OptimizeGraph(int first_keyframe);
+
+  const SparsePoseGraphOptions options_;
+
+  mutable std::mutex mutex_;
+  std::deque<Keyframe> keyframes_;
+  std::vector<LoopEdge> loop_edges_;
+  int num_optimizations_ = 0;
+
+  // Only used by the loop closure thread. The index ids are increasing with
+  // the keyframe ids but skip those dropped from the queue.
+  RingKeyIndex ring_key_index_;
+  std::vector<ScanContext> scan_contexts_;
+  std::vector<int> index_keyframe_ids_;
+  MappingScanMatcher scan_matcher_;
+
+  // Destroyed first, processes the queued keyframes.
+  std::unique_ptr<PipelineStage<DetectionInput>> detection_stage_;
 };
 
 #endif  // MSF_LOAM_VELODYNE_SPARSE_POSE_GRAPH_H
@@ -0,0 +1,109 @@
+#include "slam/metrics_reporter.h"
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <glog/logging.h>
+#include <chrono>
+#include <iomanip>
+#include <ios>
+#include <sstream>
+
+namespace {
+
+std::string ToString(const double value) {
+  std::ostringstream stream;
+  stream << std::setprecision(4) << value;
+  return stream.str();
+}
+
+}  // namespace
+
+MetricsReporter::MetricsReporter(const MetricsReporterOptions& options)
+    : options_(options), running_(true) {
+  CHECK_GT(options_.period, 0.);
+  if (!options_.csv_filename.empty()) {
+    csv_file_.open(options_.csv_filename);
+    CHECK(csv_file_) << "Cannot open " << options_.csv_filename;
+    csv_file_ << "time,name,count,mean,p50,p95,p99\n";
+  }
+  if (options_.publish_diagnostics) {
+    ros::NodeHandle nh;
+    diagnostics_publisher_ =
+        nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+  }
+  thread_ = std::thread([this] { this->Run(); });
+}
+
+MetricsReporter::~MetricsReporter() {
+  {
+    std::lock_guard<std::mutex> lg(mutex_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  thread_.join();
+  Report();
+}
+
+void MetricsReporter::Run() {
+  const auto period = std::chrono::duration<double>(options_.period);
+  std::unique_lock<std::mutex> ul(mutex_);
+  while (!cv_.wait_for(ul, period, [this] { return !running_; })) {
+    ul.unlock();
+    Report();
+    ul.lock();
+  }
+}
+
+void MetricsReporter::Report() {
+  const std::vector<MetricSummary> summaries =
+      MetricsRegistry::Get().Collect();
+  const double time = ros::WallTime::now().toSec();
+
+  // 每个周期只写一条日志
+  std::ostringstream log;
+  log << "Metrics of the last " << options_.period << " s:";
+  diagnostic_msgs::DiagnosticStatus status;
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.name = "msf_loam: metrics";
+  status.hardware_id = "msf_loam";
+  for (const MetricSummary& summary : summaries) {
+    if (summary.count == 0) continue;
+    std::string value;
+    if (summary.is_counter) {
+      value = std::to_string(summary.count);
+    } else {
+      value = "n=" + std::to_string(summary.count) +
+              " mean=" + ToString(summary.mean) +
+              " p50=" + ToString(summary.p50) +
+              " p95=" + ToString(summary.p95) +
+              " p99=" + ToString(summary.p99);
+    }
+    log << "\n  " << summary.name << ": " << value;
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = summary.name;
+    key_value.value = value;
+    status.values.push_back(key_value);
+
+    if (csv_file_.is_open()) {
+      csv_file_ << std::fixed << std::setprecision(3) << time << ","
+                << summary.name << "," << summary.count << ",";
+      csv_file_.unsetf(std::ios_base::floatfield);
+      if (!summary.is_counter) {
+        csv_file_ << summary.mean << "," << summary.p50 << "," << summary.p95
+                  << "," << summary.p99;
+      } else {
+        csv_file_ << ",,,";
+      }
+      csv_file_ << "\n";
+    }
+  }
+  LOG(INFO) << log.str();
+  if (csv_file_.is_open()) csv_file_.flush();
+
+  if (options_.publish_diagnostics &&
+      diagnostics_publisher_.getNumSubscribers() > 0) {
+    diagnostic_msgs::DiagnosticArray diagnostics;
+    diagnostics.header.stamp = ros::Time::now();
+    diagnostics.status.push_back(status);
+    diagnostics_publisher_.publish(diagnostics);
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef MSF_LOAM_VELODYNE_METRICS_REPORTER_H
+#define MSF_LOAM_VELODYNE_METRICS_REPORTER_H
+
+#include <ros/node_handle.h>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/metrics.h"
+
+struct MetricsReporterOptions {
+  // Seconds between two summaries.
+  double period = 10.;
+  // If not empty, the summaries are appended to this CSV file.
+  std::string csv_filename;
+  // Publishes the summaries as diagnostic_msgs/DiagnosticArray on
+  // /diagnostics if anyone subscribes.
+  bool publish_diagnostics = true;
+};
+
+/**
+ * @brief 定期汇总 MetricsRegistry 中的统计
+ *
+ * Every 'period' seconds a thread collects the summaries of all metrics over
+ * the last period, logs them in a single message and writes them to the CSV
+ * file and the diagnostics topic. A last summary is written on destruction.
+ */
+class MetricsReporter {
+ public:
+  explicit MetricsReporter(const MetricsReporterOptions& options);
+  ~MetricsReporter();
+
+  MetricsReporter(const MetricsReporter&) = delete;
+  MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+ private:
+  void Run();
+  void Report();
+
+  const MetricsReporterOptions options_;
+  std::ofstream csv_file_;
+  ros::Publisher diagnostics_publisher_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_;
+  std::thread thread_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_METRICS_REPORTER_H
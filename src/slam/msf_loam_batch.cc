@@ -0,0 +1,178 @@
+// Runs independent SLAM instances over many bags or KITTI sequences in one
+// process and writes the mapped trajectory of each in the TUM format
+// 'time tx ty tz qx qy qz qw', e.g.
+//
+//   ./msf_loam_batch -kitti_dataset_folder /data/kitti
+//       -kitti_sequences 00,01,02,03 -output_directory /tmp/trajectories
+//   ./msf_loam_batch -bag_filenames a.bag,b.bag -scan_line 16
+//       -output_directory /tmp/trajectories
+//
+// No ROS master is needed, the options come from the flags.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/thread_pool.h"
+#include "slam/front_end.h"
+#include "slam/scan_source.h"
+#include "slam/slam_pipeline.h"
+
+DEFINE_string(bag_filenames, "", "Comma separated bag files to process.");
+
+DEFINE_string(kitti_dataset_folder, "", "KITTI odometry dataset.");
+
+DEFINE_string(kitti_sequences, "",
+              "Comma separated KITTI sequences to process.");
+
+DEFINE_string(output_directory, "",
+              "Directory the trajectories '<name>.txt' are written to.");
+
+DEFINE_int32(num_parallel_runs, 2,
+             "Number of sequences processed concurrently.");
+
+DEFINE_int32(threads_per_run, 1,
+             "Threads of the feature extraction and the data association of "
+             "each sequence.");
+
+DEFINE_bool(pipeline_mode, false,
+            "Run scan registration, odometry and mapping of each sequence as "
+            "pipelined stages on separate threads.");
+
+DEFINE_int32(scan_line, 64, "Number of scan lines of the lidar.");
+
+DEFINE_double(minimum_range, 0.3, "Points closer than this are dropped.");
+
+namespace {
+
+std::vector<std::string> SplitByComma(const std::string &text) {
+  std::vector<std::string> parts;
+  std::istringstream stream(text);
+  std::string part;
+  while (std::getline(stream, part, ',')) {
+    if (!part.empty()) parts.push_back(part);
+  }
+  return parts;
+}
+
+// Name of the trajectory file of a bag, its file name without extension.
+std::string BagName(const std::string &bag_filename) {
+  const size_t begin = bag_filename.find_last_of('/') + 1;
+  const size_t end = bag_filename.rfind(".bag");
+  return bag_filename.substr(
+      begin, end == std::string::npos || end < begin ? std::string::npos
+                                                     : end - begin);
+}
+
+// Writes the mapped poses as they arrive on the mapping thread.
+class TrajectoryWriter : public SlamOutput {
+ public:
+  explicit TrajectoryWriter(const std::string &filename) : file_(filename) {
+    CHECK(file_) << "Cannot open " << filename;
+    file_ << std::fixed << std::setprecision(9);
+  }
+
+  void AddMappedScan(const TimestampedPointCloud &scan,
+                     const Rigid3d &pose) override {
+    const Eigen::Vector3d &t = pose.translation();
+    const Eigen::Quaterniond &q = pose.rotation();
+    file_ << ToSeconds(scan.timestamp - FromUniversal(0)) << " " << t.x()
+          << " " << t.y() << " " << t.z() << " " << q.x() << " " << q.y()
+          << " " << q.z() << " " << q.w() << "\n";
+    ++num_poses_;
+  }
+
+  int num_poses() const { return num_poses_; }
+
+ private:
+  std::ofstream file_;
+  int num_poses_ = 0;
+};
+
+struct Run {
+  std::string name;
+  std::string bag_filename;  // empty for a KITTI sequence
+  std::string kitti_sequence;
+};
+
+SlamPipelineOptions CreatePipelineOptions() {
+  SlamPipelineOptions options;
+  options.is_offline_mode = true;
+  options.pipeline_mode = FLAGS_pipeline_mode;
+  options.ingest_options.scan_num = FLAGS_scan_line;
+  options.ingest_options.min_range = FLAGS_minimum_range;
+  options.num_feature_extraction_threads = FLAGS_threads_per_run;
+  options.mapping_options.num_association_threads = FLAGS_threads_per_run;
+  // The simulated GPS comes from the ground truth, the trajectories are not
+  // corrected by it.
+  options.mapping_options.gps_fusion_options.optimization_period = 0.;
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  // The per frame log messages of all runs would be interleaved.
+  FLAGS_minloglevel = google::WARNING;
+  FLAGS_alsologtostderr = true;
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK(!FLAGS_output_directory.empty()) << "-output_directory is required.";
+  CHECK_GT(FLAGS_num_parallel_runs, 0);
+
+  std::vector<Run> runs;
+  for (const std::string &bag_filename : SplitByComma(FLAGS_bag_filenames)) {
+    runs.push_back({BagName(bag_filename), bag_filename, ""});
+  }
+  for (const std::string &sequence : SplitByComma(FLAGS_kitti_sequences)) {
+    CHECK(!FLAGS_kitti_dataset_folder.empty())
+        << "-kitti_sequences requires -kitti_dataset_folder.";
+    runs.push_back({sequence, "", sequence});
+  }
+  CHECK(!runs.empty()) << "-bag_filenames or -kitti_sequences is required.";
+
+  const SlamPipelineOptions options = CreatePipelineOptions();
+  std::mutex mutex;
+  int num_failed = 0;
+  {
+    ThreadPool thread_pool(FLAGS_num_parallel_runs);
+    for (const Run &run : runs) {
+      thread_pool.Schedule([&options, &mutex, &num_failed, run] {
+        const auto start_time = std::chrono::steady_clock::now();
+        TrajectoryWriter writer(FLAGS_output_directory + "/" + run.name +
+                                ".txt");
+        int num_scans = 0;
+        {
+          SlamPipeline pipeline(options, &writer);
+          if (run.bag_filename.empty()) {
+            KittiScanSourceOptions kitti_options;
+            kitti_options.dataset_folder = FLAGS_kitti_dataset_folder;
+            kitti_options.sequence = run.kitti_sequence;
+            KittiScanSource scan_source(kitti_options);
+            num_scans = pipeline.ReplayScanSource(&scan_source);
+          } else {
+            num_scans = ReplayBag(run.bag_filename, &pipeline);
+          }
+        }
+        const double wall_time = std::chrono::duration<double>(
+                                     std::chrono::steady_clock::now() -
+                                     start_time)
+                                     .count();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (writer.num_poses() == 0) ++num_failed;
+        std::cout << std::left << std::setw(24) << run.name << " scans "
+                  << num_scans << ", mapped " << writer.num_poses() << ", "
+                  << wall_time << " s" << std::endl;
+      });
+    }
+  }
+  LOG_IF(WARNING, num_failed > 0) << num_failed << " runs mapped no frame.";
+  return num_failed == 0 ? 0 : 1;
+}
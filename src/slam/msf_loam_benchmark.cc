@@ -0,0 +1,255 @@
+// Replays a bag or a KITTI sequence as fast as possible and reports the
+// throughput, the latency of the stages, the peak memory and the absolute
+// trajectory error against the ground truth, e.g.
+//
+//   ./msf_loam_benchmark -bag_filename kitti_00.bag -report_filename r.csv
+//   ./msf_loam_benchmark -kitti_dataset_folder /data/kitti -kitti_sequence 00
+
+#include <gflags/gflags.h>
+#include <nav_msgs/Odometry.h>
+#include <ros/ros.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sys/resource.h>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/metrics.h"
+#include "slam/front_end.h"
+#include "slam/msg_conversion.h"
+#include "slam/scan_source.h"
+
+DEFINE_string(bag_filename, "", "Bag file to replay.");
+
+DEFINE_string(kitti_dataset_folder, "",
+              "KITTI odometry dataset to replay instead of a bag.");
+
+DEFINE_string(kitti_sequence, "00", "KITTI sequence to replay.");
+
+DEFINE_bool(pipeline_mode, true,
+            "Run scan registration, odometry and mapping as pipelined stages "
+            "on separate threads.");
+
+DEFINE_string(ground_truth_topic, "/odometry_gt",
+              "nav_msgs/Odometry topic of the ground truth, the ATE is not "
+              "computed if the bag does not contain it.");
+
+DEFINE_double(max_time_difference, 0.05,
+              "Maximum time difference in seconds of a pose and the ground "
+              "truth associated with it.");
+
+DEFINE_string(report_filename, "",
+              "If not empty, the results are also written to this CSV file.");
+
+namespace {
+
+struct StampedPosition {
+  Time time;
+  Eigen::Vector3d position;
+};
+
+std::vector<StampedPosition> ReadGroundTruth(const std::string &bag_filename,
+                                             const std::string &topic) {
+  rosbag::Bag bag;
+  bag.open(bag_filename);
+  std::vector<StampedPosition> ground_truth;
+  for (auto &m : rosbag::View(bag, rosbag::TopicQuery({topic}))) {
+    const nav_msgs::OdometryConstPtr odom_msg =
+        m.instantiate<nav_msgs::Odometry>();
+    if (odom_msg == nullptr) continue;
+    ground_truth.push_back({FromRos(odom_msg->header.stamp),
+                            FromRos(odom_msg->pose).translation()});
+  }
+  bag.close();
+  std::sort(ground_truth.begin(), ground_truth.end(),
+            [](const StampedPosition &lhs, const StampedPosition &rhs) {
+              return lhs.time < rhs.time;
+            });
+  return ground_truth;
+}
+
+std::vector<StampedPosition> ReadGroundTruth(
+    const KittiScanSourceOptions &options) {
+  const std::vector<Rigid3d> poses =
+      ReadKittiGroundTruth(options.dataset_folder, options.sequence);
+  const std::vector<Time> times =
+      ReadKittiTimes(options.dataset_folder, options.sequence);
+  std::vector<StampedPosition> ground_truth;
+  for (size_t i = 0; i < poses.size() && i < times.size(); ++i) {
+    ground_truth.push_back({times[i], poses[i].translation()});
+  }
+  return ground_truth;
+}
+
+// Records the mapped positions and when the last one was reported. The
+// mapping thread is the only writer, read after the pipeline is destroyed.
+class TrajectoryOutput : public SlamOutput {
+ public:
+  void AddMappedScan(const TimestampedPointCloud &scan,
+                     const Rigid3d &pose) override {
+    positions_.push_back({scan.timestamp, pose.translation()});
+    last_pose_time_ = std::chrono::steady_clock::now();
+  }
+
+  const std::vector<StampedPosition> &positions() const { return positions_; }
+  std::chrono::steady_clock::time_point last_pose_time() const {
+    return last_pose_time_;
+  }
+
+ private:
+  std::vector<StampedPosition> positions_;
+  std::chrono::steady_clock::time_point last_pose_time_;
+};
+
+struct TrajectoryError {
+  int num_associated = 0;
+  double rmse = 0.;
+  double max = 0.;
+};
+
+// 按时间戳关联后用 Umeyama 方法（不含尺度）对齐，再计算位置误差
+TrajectoryError ComputeAbsoluteTrajectoryError(
+    const std::vector<StampedPosition> &estimated,
+    const std::vector<StampedPosition> &ground_truth) {
+  std::vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> pairs;
+  for (const StampedPosition &pose : estimated) {
+    auto it = std::lower_bound(
+        ground_truth.begin(), ground_truth.end(), pose.time,
+        [](const StampedPosition &lhs, const Time &time) {
+          return lhs.time < time;
+        });
+    double best_difference = FLAGS_max_time_difference;
+    const StampedPosition *best = nullptr;
+    for (auto candidate : {it, it - 1}) {
+      if (candidate < ground_truth.begin() || candidate >= ground_truth.end()) {
+        continue;
+      }
+      const double difference =
+          std::abs(ToSeconds(candidate->time - pose.time));
+      if (difference <= best_difference) {
+        best_difference = difference;
+        best = &*candidate;
+      }
+    }
+    if (best != nullptr) pairs.emplace_back(pose.position, best->position);
+  }
+
+  TrajectoryError error;
+  error.num_associated = pairs.size();
+  if (pairs.size() < 3) return error;
+  Eigen::Matrix3Xd source(3, pairs.size());
+  Eigen::Matrix3Xd target(3, pairs.size());
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    source.col(i) = pairs[i].first;
+    target.col(i) = pairs[i].second;
+  }
+  const Eigen::Matrix4d alignment = Eigen::umeyama(source, target, false);
+  const Eigen::Matrix3Xd aligned =
+      (alignment.topLeftCorner<3, 3>() * source).colwise() +
+      alignment.topRightCorner<3, 1>();
+  const Eigen::VectorXd errors = (aligned - target).colwise().norm();
+  error.rmse = std::sqrt(errors.squaredNorm() / errors.size());
+  error.max = errors.maxCoeff();
+  return error;
+}
+
+// 进程的峰值常驻内存
+double PeakRssMegabytes() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.;  // ru_maxrss is in kilobytes on Linux
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  // The per frame log messages would distort the timings.
+  FLAGS_minloglevel = google::WARNING;
+  FLAGS_alsologtostderr = true;
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  const bool use_kitti = !FLAGS_kitti_dataset_folder.empty();
+  CHECK(use_kitti || !FLAGS_bag_filename.empty())
+      << "-bag_filename or -kitti_dataset_folder is required.";
+
+  ros::init(argc, argv, "msf_loam_benchmark");
+  ros::NodeHandle nh;
+
+  KittiScanSourceOptions kitti_options;
+  kitti_options.dataset_folder = FLAGS_kitti_dataset_folder;
+  kitti_options.sequence = FLAGS_kitti_sequence;
+  const std::vector<StampedPosition> ground_truth =
+      use_kitti ? ReadGroundTruth(kitti_options)
+                : ReadGroundTruth(FLAGS_bag_filename, FLAGS_ground_truth_topic);
+
+  TrajectoryOutput output;
+  const auto start_time = std::chrono::steady_clock::now();
+  int num_laser_clouds = 0;
+  {
+    // Offline mode processes every frame.
+    SlamPipelineOptions options =
+        ReadSlamPipelineOptions(&nh, true, FLAGS_pipeline_mode);
+    // The simulated GPS comes from the ground truth, its correction would
+    // hide the error of the odometry and the mapping.
+    options.mapping_options.gps_fusion_options.optimization_period = 0.;
+    SlamPipeline pipeline(options, &output);
+    if (use_kitti) {
+      KittiScanSource scan_source(kitti_options);
+      num_laser_clouds = pipeline.ReplayScanSource(&scan_source);
+    } else {
+      num_laser_clouds = ReplayBag(FLAGS_bag_filename, &pipeline);
+    }
+  }
+  const std::vector<StampedPosition> &estimated = output.positions();
+  CHECK(!estimated.empty()) << "No frame was mapped.";
+
+  const double wall_time =
+      std::chrono::duration<double>(output.last_pose_time() - start_time)
+          .count();
+  const double bag_time =
+      ToSeconds(estimated.back().time - estimated.front().time);
+  const TrajectoryError ate =
+      ComputeAbsoluteTrajectoryError(estimated, ground_truth);
+
+  std::vector<std::pair<std::string, double>> results = {
+      {"laser_clouds", num_laser_clouds},
+      {"mapped_frames", estimated.size()},
+      {"wall_time_s", wall_time},
+      {"frames_per_second", estimated.size() / wall_time},
+      {"real_time_factor", bag_time / wall_time},
+      {"peak_rss_mb", PeakRssMegabytes()},
+      {"ate_associated_frames", ate.num_associated},
+      {"ate_rmse_m", ate.rmse},
+      {"ate_max_m", ate.max}};
+  for (const MetricSummary &summary : MetricsRegistry::Get().Collect()) {
+    if (summary.is_counter) {
+      results.emplace_back(summary.name, summary.count);
+      continue;
+    }
+    results.emplace_back(summary.name + " mean", summary.mean);
+    results.emplace_back(summary.name + " p50", summary.p50);
+    results.emplace_back(summary.name + " p95", summary.p95);
+    results.emplace_back(summary.name + " p99", summary.p99);
+  }
+
+  for (const auto &result : results) {
+    std::cout << std::left << std::setw(48) << result.first << result.second
+              << "\n";
+  }
+  if (!FLAGS_report_filename.empty()) {
+    std::ofstream report(FLAGS_report_filename);
+    CHECK(report) << "Cannot open " << FLAGS_report_filename;
+    report << "metric,value\n";
+    for (const auto &result : results) {
+      report << result.first << "," << result.second << "\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include "slam/ros_output.h"
+
+#include <nav_msgs/Odometry.h>
+#include <nav_msgs/Path.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include "slam/msg_conversion.h"
+
+RosOutput::RosOutput(ros::NodeHandle *const node_handle) {
+  ros::NodeHandle &nh = *node_handle;
+  laser_odom_publisher_ =
+      nh.advertise<nav_msgs::Odometry>("/laser_odom_to_init", 100);
+  laser_path_publisher_.reset(new PathPublisher(
+      nh.advertise<nav_msgs::Path>("/laser_odom_path", 100), "camera_init",
+      &async_publisher_));
+  aftmapped_odom_highfrec_publisher_ =
+      nh.advertise<nav_msgs::Odometry>("/aft_mapped_to_init_high_frec", 100);
+
+  cloud_scan_publisher_ =
+      nh.advertise<sensor_msgs::PointCloud2>("/velodyne_cloud_2", 100);
+  cloud_corner_publisher_ =
+      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_sharp", 100);
+  cloud_corner_less_publisher_ =
+      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_less_sharp", 100);
+  cloud_surf_publisher_ =
+      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_flat", 100);
+  cloud_surf_less_publisher_ =
+      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_less_flat", 100);
+
+  cloud_surround_publisher_ =
+      nh.advertise<sensor_msgs::PointCloud2>("/laser_cloud_surround", 100);
+  aftmapped_odom_publisher_ =
+      nh.advertise<nav_msgs::Odometry>("/aft_mapped_to_init", 100);
+  aftmapped_path_publisher_.reset(new PathPublisher(
+      nh.advertise<nav_msgs::Path>("/aft_mapped_path", 100), "camera_init",
+      &async_publisher_));
+}
+
+void RosOutput::AddOdometryPose(const Time &time, const Rigid3d &pose) {
+  boost::shared_ptr<nav_msgs::Odometry> laserOdometry(new nav_msgs::Odometry);
+  laserOdometry->header.frame_id = "camera_init";
+  laserOdometry->child_frame_id = "laser_odom";
+  laserOdometry->header.stamp = ToRos(time);
+  laserOdometry->pose = ToRos(pose);
+  laser_path_publisher_->AddPose(laserOdometry->header.stamp,
+                                 laserOdometry->pose.pose);
+  async_publisher_.Publish<nav_msgs::Odometry>(laser_odom_publisher_,
+                                               laserOdometry);
+}
+
+void RosOutput::AddHighFrequencyPose(const Time &time, const Rigid3d &pose) {
+  if (!AsyncPublisher::HasSubscribers(aftmapped_odom_highfrec_publisher_)) {
+    return;
+  }
+  boost::shared_ptr<nav_msgs::Odometry> aftmapped_odom(new nav_msgs::Odometry);
+  aftmapped_odom->child_frame_id = "aft_mapped";
+  aftmapped_odom->header.frame_id = "camera_init";
+  aftmapped_odom->header.stamp = ToRos(time);
+  aftmapped_odom->pose = ToRos(pose);
+  async_publisher_.Publish<nav_msgs::Odometry>(
+      aftmapped_odom_highfrec_publisher_, aftmapped_odom);
+}
+
+void RosOutput::AddMappedScan(const TimestampedPointCloud &scan,
+                              const Rigid3d &pose) {
+  const ros::Time stamp = ToRos(scan.timestamp);
+  boost::shared_ptr<nav_msgs::Odometry> aftmapped_odom(new nav_msgs::Odometry);
+  aftmapped_odom->header.frame_id = "camera_init";
+  aftmapped_odom->header.stamp = stamp;
+  aftmapped_odom->child_frame_id = "aft_mapped";
+  aftmapped_odom->pose = ToRos(pose);
+  aftmapped_path_publisher_->AddPose(stamp, aftmapped_odom->pose.pose);
+  async_publisher_.Publish<nav_msgs::Odometry>(aftmapped_odom_publisher_,
+                                               aftmapped_odom);
+
+  async_publisher_.PublishCloud(cloud_scan_publisher_, scan.cloud_full_res,
+                                stamp, "aft_mapped");
+  async_publisher_.PublishCloud(cloud_corner_publisher_,
+                                scan.cloud_corner_sharp, stamp, "aft_mapped");
+  async_publisher_.PublishCloud(cloud_corner_less_publisher_,
+                                scan.cloud_corner_less_sharp, stamp,
+                                "aft_mapped");
+  async_publisher_.PublishCloud(cloud_surf_publisher_, scan.cloud_surf_flat,
+                                stamp, "aft_mapped");
+  async_publisher_.PublishCloud(cloud_surf_less_publisher_,
+                                scan.cloud_surf_less_flat, stamp, "aft_mapped");
+
+  tf::Transform transform;
+  transform.setOrigin({pose.translation().x(), pose.translation().y(),
+                       pose.translation().z()});
+  transform.setRotation({pose.rotation().x(), pose.rotation().y(),
+                         pose.rotation().z(), pose.rotation().w()});
+  transform_broadcaster_.sendTransform(tf::StampedTransform(
+      transform, stamp, "/camera_init", "/aft_mapped"));
+}
+
+bool RosOutput::WantsSurroundCloud() const {
+  return AsyncPublisher::HasSubscribers(cloud_surround_publisher_);
+}
+
+void RosOutput::AddSurroundCloud(const Time &time,
+                                 const PointCloudConstPtr &cloud) {
+  async_publisher_.PublishCloud(cloud_surround_publisher_, cloud, ToRos(time),
+                                "camera_init");
+}
@@ -0,0 +1,56 @@
+#ifndef MSF_LOAM_VELODYNE_ROS_OUTPUT_H
+#define MSF_LOAM_VELODYNE_ROS_OUTPUT_H
+
+#include <ros/node_handle.h>
+#include <tf/transform_broadcaster.h>
+#include <memory>
+
+#include "slam/async_publisher.h"
+#include "slam/slam_output.h"
+
+/**
+ * @brief 将 SLAM 结果发布为 ROS 话题和 tf
+ *
+ * Publishes the odometry on '/laser_odom_to_init' and '/laser_odom_path',
+ * the mapping results on '/aft_mapped_to_init', '/aft_mapped_path',
+ * '/aft_mapped_to_init_high_frec', the registered clouds and
+ * '/laser_cloud_surround' in the 'camera_init' frame, and the tf from
+ * 'camera_init' to 'aft_mapped'. The messages are built and published on the
+ * output thread of an AsyncPublisher.
+ */
+class RosOutput : public SlamOutput {
+ public:
+  explicit RosOutput(ros::NodeHandle *node_handle);
+
+  void AddOdometryPose(const Time &time, const Rigid3d &pose) override;
+  void AddHighFrequencyPose(const Time &time, const Rigid3d &pose) override;
+  void AddMappedScan(const TimestampedPointCloud &scan,
+                     const Rigid3d &pose) override;
+  bool WantsSurroundCloud() const override;
+  void AddSurroundCloud(const Time &time,
+                        const PointCloudConstPtr &cloud) override;
+
+ private:
+  // Used by the odometry and the mapping thread.
+  AsyncPublisher async_publisher_;
+
+  // 里程计，在里程计线程上调用
+  ros::Publisher laser_odom_publisher_;
+  std::unique_ptr<PathPublisher> laser_path_publisher_;
+  ros::Publisher aftmapped_odom_highfrec_publisher_;
+
+  // 建图，在建图线程上调用
+  ros::Publisher cloud_scan_publisher_;
+  ros::Publisher cloud_corner_publisher_;
+  ros::Publisher cloud_corner_less_publisher_;
+  ros::Publisher cloud_surf_publisher_;
+  ros::Publisher cloud_surf_less_publisher_;
+
+  ros::Publisher cloud_surround_publisher_;
+  ros::Publisher aftmapped_odom_publisher_;
+  std::unique_ptr<PathPublisher> aftmapped_path_publisher_;
+
+  tf::TransformBroadcaster transform_broadcaster_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_ROS_OUTPUT_H
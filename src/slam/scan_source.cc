@@ -0,0 +1,140 @@
+#include "slam/scan_source.h"
+
+#include <glog/logging.h>
+#include <unistd.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+constexpr size_t kFloatsPerPoint = 4;
+
+// Parses a row major 3x4 matrix, the format of the KITTI poses and calib.
+bool ParsePose(const std::string& line, Rigid3d* const pose) {
+  std::istringstream stream(line);
+  Eigen::Matrix<double, 3, 4> matrix;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      if (!(stream >> matrix(i, j))) return false;
+    }
+  }
+  Eigen::Quaterniond rotation(matrix.leftCols<3>());
+  rotation.normalize();
+  *pose = Rigid3d(matrix.rightCols<1>(), rotation);
+  return true;
+}
+
+// Velodyne to left camera transform of the sequence.
+Rigid3d ReadKittiCalibration(const std::string& filename) {
+  std::ifstream file(filename);
+  CHECK(file) << "Cannot open " << filename;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.compare(0, 3, "Tr:") != 0) continue;
+    Rigid3d calibration;
+    CHECK(ParsePose(line.substr(3), &calibration))
+        << "Cannot parse Tr in " << filename;
+    return calibration;
+  }
+  LOG(FATAL) << "No Tr in " << filename;
+  return Rigid3d();
+}
+
+// Faults in the pages of 'file', the first touch of a mapped page reads it
+// from the disk.
+void PageIn(const MappedFile& file) {
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  const volatile char* const data = file.data();
+  char sum = 0;
+  for (size_t i = 0; i < file.size(); i += page_size) sum += data[i];
+  (void)sum;
+}
+
+}  // namespace
+
+std::vector<Time> ReadKittiTimes(const std::string& dataset_folder,
+                                 const std::string& sequence) {
+  const std::string filename =
+      dataset_folder + "/sequences/" + sequence + "/times.txt";
+  std::ifstream file(filename);
+  CHECK(file) << "Cannot open " << filename;
+  std::vector<Time> times;
+  double seconds;
+  while (file >> seconds) {
+    times.push_back(FromUniversal(0) + FromSeconds(seconds));
+  }
+  return times;
+}
+
+std::vector<Rigid3d> ReadKittiGroundTruth(const std::string& dataset_folder,
+                                          const std::string& sequence) {
+  std::vector<Rigid3d> ground_truth;
+  std::ifstream poses_file(dataset_folder + "/poses/" + sequence + ".txt");
+  if (!poses_file) return ground_truth;
+  const Rigid3d calibration = ReadKittiCalibration(
+      dataset_folder + "/sequences/" + sequence + "/calib.txt");
+  const Rigid3d calibration_inverse = calibration.inverse();
+  std::string line;
+  while (std::getline(poses_file, line)) {
+    Rigid3d camera_pose;
+    CHECK(ParsePose(line, &camera_pose))
+        << "Cannot parse pose " << ground_truth.size() << " of sequence "
+        << sequence;
+    ground_truth.push_back(calibration_inverse * camera_pose * calibration);
+  }
+  return ground_truth;
+}
+
+KittiScanSource::KittiScanSource(const KittiScanSourceOptions& options)
+    : options_(options),
+      velodyne_folder_(options.dataset_folder + "/sequences/" +
+                       options.sequence + "/velodyne/"),
+      prefetched_(options.num_prefetch) {
+  CHECK_GT(options_.num_prefetch, 0);
+  times_ = ReadKittiTimes(options_.dataset_folder, options_.sequence);
+  ground_truth_ = ReadKittiGroundTruth(options_.dataset_folder,
+                                       options_.sequence);
+  if (ground_truth_.empty()) {
+    LOG(INFO) << "No ground truth for sequence " << options_.sequence;
+  } else {
+    CHECK_EQ(ground_truth_.size(), times_.size())
+        << "Number of poses and timestamps of sequence " << options_.sequence
+        << " differ.";
+  }
+  LOG(INFO) << "Reading " << times_.size() << " scans of sequence "
+            << options_.sequence << " from " << options_.dataset_folder;
+
+  prefetch_thread_ = std::thread([this] { Prefetch(); });
+}
+
+KittiScanSource::~KittiScanSource() {
+  prefetched_.Close();
+  prefetch_thread_.join();
+}
+
+void KittiScanSource::Prefetch() {
+  for (size_t index = 0; index < times_.size(); ++index) {
+    std::ostringstream filename;
+    filename << velodyne_folder_ << std::setfill('0') << std::setw(6) << index
+             << ".bin";
+    RawScan scan;
+    scan.timestamp = times_[index];
+    scan.file = std::make_shared<const MappedFile>(filename.str());
+    PageIn(*scan.file);
+    scan.points = reinterpret_cast<const float*>(scan.file->data());
+    scan.num_points = scan.file->size() / (kFloatsPerPoint * sizeof(float));
+    if (!ground_truth_.empty()) {
+      scan.has_ground_truth = true;
+      scan.ground_truth = ground_truth_[index];
+    }
+
+    // Blocks while 'num_prefetch' scans are waiting.
+    if (!prefetched_.Push(std::move(scan))) return;
+  }
+  prefetched_.Close();
+}
+
+bool KittiScanSource::Next(RawScan* const scan) {
+  return prefetched_.Pop(scan);
+}
@@ -0,0 +1,89 @@
+#ifndef MSF_LOAM_VELODYNE_SCAN_SOURCE_H
+#define MSF_LOAM_VELODYNE_SCAN_SOURCE_H
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/blocking_queue.h"
+#include "common/mapped_file.h"
+#include "common/rigid_transform.h"
+#include "common/time_def.h"
+
+// A scan as packed x, y, z, intensity floats, e.g. a KITTI .bin file.
+struct RawScan {
+  Time timestamp;
+  // Owns the memory 'points' points into.
+  std::shared_ptr<const MappedFile> file;
+  const float* points = nullptr;
+  size_t num_points = 0;
+  // Pose of the lidar in the world frame, if known.
+  bool has_ground_truth = false;
+  Rigid3d ground_truth;
+};
+
+// Offline input of raw scans in time order, read without ROS.
+class ScanSource {
+ public:
+  virtual ~ScanSource() = default;
+
+  // Returns false after the last scan.
+  virtual bool Next(RawScan* scan) = 0;
+};
+
+struct KittiScanSourceOptions {
+  // Contains 'sequences/<sequence>/' and optionally 'poses/<sequence>.txt'.
+  std::string dataset_folder;
+  std::string sequence = "00";
+  // Number of scans mapped and paged in ahead of the consumer.
+  int num_prefetch = 8;
+};
+
+/**
+ * @brief KITTI odometry 数据集的点云读取
+ *
+ * Memory maps 'velodyne/%06d.bin' of the sequence and reads the timestamps
+ * from 'times.txt'. The ground truth in 'poses/<sequence>.txt' is given in
+ * the left camera frame and converted to the lidar frame using 'Tr' of
+ * 'calib.txt'. A prefetch thread keeps 'num_prefetch' scans mapped with
+ * their pages faulted in, so that Next() does not wait for the disk.
+ */
+class KittiScanSource : public ScanSource {
+ public:
+  explicit KittiScanSource(const KittiScanSourceOptions& options);
+
+  // Stops the prefetch thread.
+  ~KittiScanSource() override;
+
+  KittiScanSource(const KittiScanSource&) = delete;
+  KittiScanSource& operator=(const KittiScanSource&) = delete;
+
+  bool Next(RawScan* scan) override;
+
+  size_t num_scans() const { return times_.size(); }
+
+ private:
+  void Prefetch();
+
+  const KittiScanSourceOptions options_;
+  const std::string velodyne_folder_;
+  std::vector<Time> times_;
+  // Empty if the sequence has no ground truth.
+  std::vector<Rigid3d> ground_truth_;
+
+  // Closed after the last scan or on destruction.
+  BlockingQueue<RawScan> prefetched_;
+  std::thread prefetch_thread_;
+};
+
+// Reads the timestamps of the KITTI 'sequence'.
+std::vector<Time> ReadKittiTimes(const std::string& dataset_folder,
+                                 const std::string& sequence);
+
+// Reads the KITTI ground truth of 'sequence' in the lidar frame. Returns an
+// empty vector if there is none.
+std::vector<Rigid3d> ReadKittiGroundTruth(const std::string& dataset_folder,
+                                          const std::string& sequence);
+
+#endif  // MSF_LOAM_VELODYNE_SCAN_SOURCE_H
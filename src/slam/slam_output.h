@@ -0,0 +1,41 @@
+#ifndef MSF_LOAM_VELODYNE_SLAM_OUTPUT_H
+#define MSF_LOAM_VELODYNE_SLAM_OUTPUT_H
+
+#include "common/common.h"
+#include "common/rigid_transform.h"
+#include "common/time_def.h"
+#include "common/timestamped_pointcloud.h"
+
+/**
+ * @brief SLAM 结果的输出接口
+ *
+ * Receives the results of one SlamPipeline, e.g. to publish them to ROS or to
+ * record the trajectory. The odometry results are reported on the odometry
+ * thread and the mapping results on the mapping thread, which run
+ * concurrently in pipeline mode. Implementations must not block for long,
+ * every method delays the following frames. All methods do nothing by
+ * default.
+ */
+class SlamOutput {
+ public:
+  virtual ~SlamOutput() = default;
+
+  // Pose of the laser odometry in its world frame.
+  virtual void AddOdometryPose(const Time& time, const Rigid3d& pose) {}
+
+  // Odometry pose corrected by the latest mapping result, available at the
+  // rate of the odometry.
+  virtual void AddHighFrequencyPose(const Time& time, const Rigid3d& pose) {}
+
+  // Pose of a mapped scan in the map frame. The clouds of 'scan' are in the
+  // scan frame and must not be modified.
+  virtual void AddMappedScan(const TimestampedPointCloud& scan,
+                             const Rigid3d& pose) {}
+
+  // The map around the current pose is only collected if this is true.
+  virtual bool WantsSurroundCloud() const { return false; }
+  virtual void AddSurroundCloud(const Time& time,
+                                const PointCloudConstPtr& cloud) {}
+};
+
+#endif  // MSF_LOAM_VELODYNE_SLAM_OUTPUT_H
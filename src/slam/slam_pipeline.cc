@@ -0,0 +1,131 @@
+#include "slam/slam_pipeline.h"
+
+#include "common/tic_toc.h"
+#include "slam/msg_conversion.h"
+
+SlamPipeline::SlamPipeline(const SlamPipelineOptions &options,
+                           SlamOutput *const output) {
+  const PointCloudIngestOptions &ingest_options = options.ingest_options;
+  LOG_IF(WARNING, ingest_options.beam_altitudes.empty() &&
+                      ingest_options.scan_num != 16 &&
+                      ingest_options.scan_num != 32 &&
+                      ingest_options.scan_num != 64)
+      << "Without beam_altitudes, the scan lines of a "
+      << ingest_options.scan_num
+      << " line lidar come only from a ring field or an organized cloud,"
+      << " other points are dropped.";
+  point_cloud_ingest_.reset(new PointCloudIngest(ingest_options));
+  if (options.num_feature_extraction_threads > 1) {
+    feature_extraction_thread_pool_.reset(
+        new ThreadPool(options.num_feature_extraction_threads - 1));
+  }
+  feature_extractor_.reset(
+      new FeatureExtractor(options.feature_extractor_options,
+                           feature_extraction_thread_pool_.get()));
+
+  // 特征提取的线程池也用于后台构建搜索索引
+  laser_odometry_.reset(new LaserOdometry(
+      options.odometry_options, options.mapping_options,
+      options.is_offline_mode, output, feature_extraction_thread_pool_.get()));
+
+  if (!options.pipeline_mode) return;
+  LOG(INFO) << "Using pipeline mode ...";
+  PipelineStageOptions odometry_options;
+  odometry_options.name = "ODO";
+  odometry_options.queue_size = 4;
+  odometry_options.drop_when_full = !options.is_offline_mode;
+  odometry_options.blocking = options.is_offline_mode;
+  odometry_options.cpu = options.odometry_cpu;
+  odometry_stage_.reset(new PipelineStage<TimestampedPointCloud>(
+      odometry_options, [this](TimestampedPointCloud scan) {
+        laser_odometry_->AddLaserScan(std::move(scan));
+      }));
+
+  PipelineStageOptions registration_options;
+  registration_options.name = "REG";
+  registration_options.queue_size = 4;
+  registration_options.drop_when_full = !options.is_offline_mode;
+  registration_options.blocking = options.is_offline_mode;
+  registration_options.cpu = options.registration_cpu;
+  registration_stage_.reset(new PipelineStage<RegistrationInput>(
+      registration_options, [this](RegistrationInput input) {
+        odometry_stage_->Push(RegisterScan(input));
+      }));
+}
+
+SlamPipeline::~SlamPipeline() {
+  registration_stage_.reset();
+  odometry_stage_.reset();
+  laser_odometry_.reset();
+}
+
+TimestampedPointCloud SlamPipeline::RegisterScan(
+    const RegistrationInput &input) {
+  TicToc t_whole;
+  TicToc t_prepare;
+
+  const std::vector<PointCloud> &laser_cloud_scans =
+      input.laser_cloud_msg != nullptr
+          ? point_cloud_ingest_->Ingest(*input.laser_cloud_msg)
+          : point_cloud_ingest_->IngestXYZI(input.raw_scan.points,
+                                            input.raw_scan.num_points);
+
+  LOG_STEP_TIME("REG", "Re-index scans", t_prepare.toc());
+
+  TimestampedPointCloud scan;
+  scan.timestamp = input.laser_cloud_msg != nullptr
+                       ? FromRos(input.laser_cloud_msg->header.stamp)
+                       : input.raw_scan.timestamp;
+  feature_extractor_->Extract(laser_cloud_scans, &scan);
+
+  LOG_STEP_TIME("REG", "Scan registration", t_whole.toc());
+  LOG_IF(WARNING, t_whole.toc() > 100)
+      << "Scan registration process over 100ms";
+  return scan;
+}
+
+void SlamPipeline::AddRegistrationInput(RegistrationInput input) {
+  if (registration_stage_ != nullptr) {
+    registration_stage_->Push(std::move(input));
+  } else {
+    laser_odometry_->AddLaserScan(RegisterScan(input));
+  }
+}
+
+void SlamPipeline::AddPointCloud(
+    const sensor_msgs::PointCloud2ConstPtr &laser_cloud_msg) {
+  RegistrationInput input;
+  input.laser_cloud_msg = laser_cloud_msg;
+  AddRegistrationInput(std::move(input));
+}
+
+void SlamPipeline::AddRawScan(const RawScan &raw_scan) {
+  if (raw_scan.has_ground_truth) {
+    OdometryData odom_data;
+    odom_data.timestamp = raw_scan.timestamp;
+    odom_data.odom = raw_scan.ground_truth;
+    odom_data.error = 0;
+    AddOdom(odom_data);
+  }
+  RegistrationInput input;
+  input.raw_scan = raw_scan;
+  AddRegistrationInput(std::move(input));
+}
+
+void SlamPipeline::AddImu(const ImuData &imu_data) {
+  laser_odometry_->AddImu(imu_data);
+}
+
+void SlamPipeline::AddOdom(const OdometryData &odom_data) {
+  laser_odometry_->AddOdom(odom_data);
+}
+
+int SlamPipeline::ReplayScanSource(ScanSource *const scan_source) {
+  int num_scans = 0;
+  RawScan raw_scan;
+  while (scan_source->Next(&raw_scan)) {
+    AddRawScan(raw_scan);
+    ++num_scans;
+  }
+  return num_scans;
+}
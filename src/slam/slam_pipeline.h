@@ -0,0 +1,93 @@
+#ifndef MSF_LOAM_VELODYNE_SLAM_PIPELINE_H
+#define MSF_LOAM_VELODYNE_SLAM_PIPELINE_H
+
+#include <sensor_msgs/PointCloud2.h>
+#include <memory>
+
+#include "common/pipeline_stage.h"
+#include "common/thread_pool.h"
+#include "slam/feature_extraction/feature_extractor.h"
+#include "slam/feature_extraction/point_cloud_ingest.h"
+#include "slam/local/laser_mapping.h"
+#include "slam/local/laser_odometry.h"
+#include "slam/scan_source.h"
+#include "slam/slam_output.h"
+
+struct SlamPipelineOptions {
+  // Offline mode processes every frame, online mode drops frames under load.
+  bool is_offline_mode = false;
+  // Run scan registration, odometry and mapping on separate threads.
+  bool pipeline_mode = false;
+  PointCloudIngestOptions ingest_options;
+  FeatureExtractorOptions feature_extractor_options;
+  // Threads of the feature extraction, including the registration thread.
+  int num_feature_extraction_threads = 4;
+  // CPUs the registration and odometry threads are pinned to, -1 for none.
+  int registration_cpu = -1;
+  int odometry_cpu = -1;
+  LaserOdometryOptions odometry_options;
+  LaserMappingOptions mapping_options;
+};
+
+/**
+ * @brief 点云配准、里程计和建图的完整流程，不依赖 ROS
+ *
+ * Registers the point clouds, feeds them to the laser odometry and forwards
+ * the imu and odometry data. In pipeline mode, scan registration and laser
+ * odometry run on their own threads, connected by bounded lock-free queues,
+ * so that registration of frame N+1 overlaps odometry of frame N. Mapping is
+ * the last stage and owned by LaserMapping. The results go to the
+ * SlamOutput.
+ *
+ * An instance holds no process-wide state, so several instances may run
+ * concurrently, e.g. to process many sequences in one process. Data must be
+ * added to an instance from a single thread.
+ */
+class SlamPipeline {
+ public:
+  // 'output' is not owned and must outlive the pipeline.
+  SlamPipeline(const SlamPipelineOptions &options, SlamOutput *output);
+
+  // Processes all frames added so far before returning.
+  ~SlamPipeline();
+
+  SlamPipeline(const SlamPipeline &) = delete;
+  SlamPipeline &operator=(const SlamPipeline &) = delete;
+
+  // The timestamp of the scan is the header stamp of 'laser_cloud_msg'.
+  void AddPointCloud(const sensor_msgs::PointCloud2ConstPtr &laser_cloud_msg);
+
+  // Adds a scan without a ROS message, its ground truth is forwarded like the
+  // odometry data.
+  void AddRawScan(const RawScan &raw_scan);
+
+  void AddImu(const ImuData &imu_data);
+
+  void AddOdom(const OdometryData &odom_data);
+
+  // Adds all scans of 'scan_source'. Returns the number of scans read.
+  int ReplayScanSource(ScanSource *scan_source);
+
+ private:
+  // Input of the scan registration, a message or, if it is null, a raw scan.
+  struct RegistrationInput {
+    sensor_msgs::PointCloud2ConstPtr laser_cloud_msg;
+    RawScan raw_scan;
+  };
+
+  TimestampedPointCloud RegisterScan(const RegistrationInput &input);
+
+  void AddRegistrationInput(RegistrationInput input);
+
+  std::unique_ptr<PointCloudIngest> point_cloud_ingest_;
+  std::unique_ptr<ThreadPool> feature_extraction_thread_pool_;
+  std::unique_ptr<FeatureExtractor> feature_extractor_;
+  std::unique_ptr<LaserOdometry> laser_odometry_;
+
+  // Destroyed in reverse order, so that every stage is drained before the
+  // stage it feeds.
+  std::unique_ptr<PipelineStage<TimestampedPointCloud>> odometry_stage_;
+  std::unique_ptr<PipelineStage<RegistrationInput>> registration_stage_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_SLAM_PIPELINE_H
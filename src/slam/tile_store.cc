@@ -0,0 +1,49 @@
+#include "slam/tile_store.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <unistd.h>
+#include <cerrno>
+
+TileStore::TileStore(const std::string& directory) {
+  std::string name = directory + "/msf_loam_tiles_XXXXXX";
+  fd_ = mkstemp(&name[0]);
+  PCHECK(fd_ >= 0) << "Cannot create tile file in " << directory;
+  filename_ = name;
+  LOG(INFO) << "Spilling map tiles to " << filename_;
+}
+
+TileStore::~TileStore() {
+  close(fd_);
+  unlink(filename_.c_str());
+}
+
+void TileStore::Write(const std::vector<char>& data, Slot* const slot) {
+  if (data.size() > slot->capacity) {
+    slot->offset = file_size_;
+    slot->capacity = data.size();
+    file_size_ += data.size();
+  }
+  slot->size = data.size();
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t n = pwrite(fd_, data.data() + written, data.size() - written,
+                             slot->offset + written);
+    if (n < 0 && errno == EINTR) continue;
+    PCHECK(n > 0) << "Cannot write " << filename_;
+    written += n;
+  }
+}
+
+std::vector<char> TileStore::Read(const Slot& slot) const {
+  std::vector<char> data(slot.size);
+  size_t read = 0;
+  while (read < data.size()) {
+    const ssize_t n =
+        pread(fd_, data.data() + read, data.size() - read, slot.offset + read);
+    if (n < 0 && errno == EINTR) continue;
+    PCHECK(n > 0) << "Cannot read " << filename_;
+    read += n;
+  }
+  return data;
+}
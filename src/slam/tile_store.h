@@ -0,0 +1,62 @@
+#ifndef MSF_LOAM_VELODYNE_TILE_STORE_H
+#define MSF_LOAM_VELODYNE_TILE_STORE_H
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Appends the bytes of 'value' to 'buffer'.
+template <typename T>
+void AppendToBuffer(const T& value, std::vector<char>* const buffer) {
+  const char* const bytes = reinterpret_cast<const char*>(&value);
+  buffer->insert(buffer->end(), bytes, bytes + sizeof(T));
+}
+
+// Reads a 'T' at '*data' and advances '*data' past it.
+template <typename T>
+T ReadFromBuffer(const char** const data) {
+  T value;
+  std::memcpy(&value, *data, sizeof(T));
+  *data += sizeof(T);
+  return value;
+}
+
+/**
+ * @brief 地图块的磁盘缓存
+ *
+ * A scratch file holding serialized map tiles, removed on destruction. A
+ * tile rewritten with at most its previous size reuses its slot, otherwise
+ * it is appended. Read() may be called from any thread, also concurrently
+ * with Write() as long as it does not read the slot being written.
+ */
+class TileStore {
+ public:
+  struct Slot {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint64_t capacity = 0;
+  };
+
+  // Creates a new file in 'directory'.
+  explicit TileStore(const std::string& directory);
+  ~TileStore();
+
+  TileStore(const TileStore&) = delete;
+  TileStore& operator=(const TileStore&) = delete;
+
+  // Writes 'data' to 'slot', which is reused if possible.
+  void Write(const std::vector<char>& data, Slot* slot);
+
+  std::vector<char> Read(const Slot& slot) const;
+
+  uint64_t file_size() const { return file_size_; }
+
+ private:
+  std::string filename_;
+  int fd_;
+  uint64_t file_size_ = 0;
+};
+
+#endif  // MSF_LOAM_VELODYNE_TILE_STORE_H
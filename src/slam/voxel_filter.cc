@@ -0,0 +1,79 @@
+#include "slam/voxel_filter.h"
+
+#include <glog/logging.h>
+#include <cmath>
+
+namespace {
+
+constexpr uint64_t kEmptyKey = ~uint64_t{0};
+constexpr int kIndexBits = 21;
+constexpr int64_t kIndexOffset = int64_t{1} << (kIndexBits - 1);
+
+// Fibonacci hashing, 'num_bits' is log2 of the table size.
+inline size_t HashKey(const uint64_t key, const int num_bits) {
+  return (key * 0x9E3779B97F4A7C15ull) >> (64 - num_bits);
+}
+
+}  // namespace
+
+VoxelFilter::VoxelFilter(const float leaf_size)
+    : inverse_leaf_size_(1.f / leaf_size) {
+  CHECK_GT(leaf_size, 0.f);
+}
+
+uint64_t VoxelFilter::VoxelKey(const PointType& point) const {
+  const int64_t i = std::floor(point.x * inverse_leaf_size_) + kIndexOffset;
+  const int64_t j = std::floor(point.y * inverse_leaf_size_) + kIndexOffset;
+  const int64_t k = std::floor(point.z * inverse_leaf_size_) + kIndexOffset;
+  return (static_cast<uint64_t>(i) << (2 * kIndexBits)) |
+         (static_cast<uint64_t>(j) << kIndexBits) | static_cast<uint64_t>(k);
+}
+
+void VoxelFilter::Filter(const PointCloud& cloud_in,
+                         PointCloud* const cloud_out) {
+  CHECK_NE(&cloud_in, cloud_out);
+  cloud_out->clear();
+  if (cloud_in.empty()) return;
+
+  // The table is at most half full and never shrinks.
+  while ((size_t{1} << num_bits_) < 2 * cloud_in.size()) ++num_bits_;
+  const int num_bits = num_bits_;
+  const size_t mask = (size_t{1} << num_bits) - 1;
+  if (keys_.size() != mask + 1) {
+    keys_.assign(mask + 1, kEmptyKey);
+    voxel_indices_.resize(mask + 1);
+  }
+
+  voxels_.clear();
+  for (const PointType& point : cloud_in) {
+    const uint64_t key = VoxelKey(point);
+    size_t slot = HashKey(key, num_bits);
+    while (keys_[slot] != kEmptyKey && keys_[slot] != key) {
+      slot = (slot + 1) & mask;
+    }
+    if (keys_[slot] == kEmptyKey) {
+      keys_[slot] = key;
+      voxel_indices_[slot] = voxels_.size();
+      voxels_.push_back(Voxel{0.f, 0.f, 0.f, 0.f, 0, static_cast<int>(slot)});
+    }
+    Voxel& voxel = voxels_[voxel_indices_[slot]];
+    voxel.x += point.x;
+    voxel.y += point.y;
+    voxel.z += point.z;
+    voxel.intensity += point.intensity;
+    ++voxel.num_points;
+  }
+
+  cloud_out->resize(voxels_.size());
+  for (size_t i = 0; i < voxels_.size(); ++i) {
+    const Voxel& voxel = voxels_[i];
+    const float inverse_num_points = 1.f / voxel.num_points;
+    PointType& point = (*cloud_out)[i];
+    point.x = voxel.x * inverse_num_points;
+    point.y = voxel.y * inverse_num_points;
+    point.z = voxel.z * inverse_num_points;
+    point.intensity = voxel.intensity * inverse_num_points;
+    // Only the used slots are reset, the table stays empty between calls.
+    keys_[voxel.slot] = kEmptyKey;
+  }
+}
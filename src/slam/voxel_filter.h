@@ -0,0 +1,45 @@
+#ifndef MSF_LOAM_VELODYNE_VOXEL_FILTER_H
+#define MSF_LOAM_VELODYNE_VOXEL_FILTER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "common/common.h"
+
+/**
+ * @brief 体素降采样
+ *
+ * Replaces the points of every voxel by their centroid, like
+ * pcl::VoxelGrid<PointType> with x, y, z and intensity averaged. The voxels
+ * are found in an open addressing hash table whose memory is reused between
+ * calls, so a long lived instance does not allocate once warmed up. Voxels
+ * are output in the order of their first point, not sorted by voxel index.
+ *
+ * Voxel indices are limited to +/- 2^20, i.e. +/- 200 km for a leaf size of
+ * 0.2 m. A single instance must not be used concurrently.
+ */
+class VoxelFilter {
+ public:
+  explicit VoxelFilter(float leaf_size);
+
+  // 'cloud_out' must not be 'cloud_in'.
+  void Filter(const PointCloud& cloud_in, PointCloud* cloud_out);
+
+ private:
+  struct Voxel {
+    float x, y, z, intensity;
+    int num_points;
+    int slot;
+  };
+
+  uint64_t VoxelKey(const PointType& point) const;
+
+  const float inverse_leaf_size_;
+  // Hash table of voxel keys and the indices of the voxels in 'voxels_'.
+  int num_bits_ = 4;
+  std::vector<uint64_t> keys_;
+  std::vector<int> voxel_indices_;
+  std::vector<Voxel> voxels_;
+};
+
+#endif  // MSF_LOAM_VELODYNE_VOXEL_FILTER_H